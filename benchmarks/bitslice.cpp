@@ -0,0 +1,92 @@
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+
+#include "cpplink_lib/modules.h"
+#include "cpplink_lib/lanes.h"
+
+using namespace cpplink;
+
+/*
+ * Per-instance cost of a tick of a chain of ModuleLogicXor modules fed by
+ * random bits. N instances are simulated one after another with Maybe<bool>
+ * pins, then at once with bit-sliced lanes as with --instances=N.
+ */
+
+const size_t N = 256;
+
+double nsScalar(size_t size, long ticks, long& ones) {
+    ModuleRand<bool> rand;
+    std::vector<ModuleLogicXor> gates(size);
+    std::vector<Net<bool>> nets(size);
+    nets[0].setOutputPin(rand.out);
+    for (size_t i = 0; i < size; i++) {
+        nets[i].addInputPin(gates[i].in1);
+        gates[i].in2 = true;
+        if (i + 1 < size)
+            nets[i + 1].setOutputPin(gates[i].out);
+    }
+
+    ones = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (size_t instance = 0; instance < N; instance++) {
+        rand.seed(instance, 0);
+        for (long t = 0; t < ticks; t++) {
+            rand.step();
+            for (size_t i = 0; i < size; i++) {
+                nets[i].step();
+                gates[i].step();
+            }
+            ones += gates.back().out.getValue();
+        }
+    }
+    auto end = std::chrono::steady_clock::now();
+
+    return std::chrono::duration<double, std::nano>(end - start).count() / ticks / N;
+}
+
+double nsSliced(size_t size, long ticks, long& ones) {
+    batch::ModuleRand<bool, N> rand;
+    std::vector<batch::ModuleLogicXor<N>> gates(size);
+    std::vector<batch::Net<bool, N>> nets(size);
+    nets[0].setOutputPin(rand.out);
+    for (size_t i = 0; i < size; i++) {
+        nets[i].addInputPin(gates[i].in1);
+        gates[i].in2 = true;
+        if (i + 1 < size)
+            nets[i + 1].setOutputPin(gates[i].out);
+    }
+
+    ones = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (long t = 0; t < ticks; t++) {
+        rand.step();
+        for (size_t i = 0; i < size; i++) {
+            nets[i].step();
+            gates[i].step();
+        }
+        for (uint64_t w : gates.back().out.value.value)
+            ones += __builtin_popcountll(w);
+    }
+    auto end = std::chrono::steady_clock::now();
+
+    return std::chrono::duration<double, std::nano>(end - start).count() / ticks / N;
+}
+
+int main(int argc, char* argv[]) {
+    size_t size = argc > 1 ? std::atol(argv[1]) : 1000;
+    long ticks = argc > 2 ? std::atol(argv[2]) : 1000;
+
+    long scalarOnes, slicedOnes;
+    double scalar = nsScalar(size, ticks, scalarOnes);
+    double sliced = nsSliced(size, ticks, slicedOnes);
+
+    std::cout << size << " gates, " << N << " instances, " << ticks << " ticks\n";
+    std::cout << "  Maybe<bool> pins: " << scalar << " ns/tick/instance\n";
+    std::cout << "  bit-sliced:       " << sliced << " ns/tick/instance\n";
+    // Both count the ones of independent random streams
+    std::cout << "  share of ones: " << double(scalarOnes) / ticks / N << " / "
+              << double(slicedOnes) / ticks / N << "\n";
+    return 0;
+}
@@ -0,0 +1,94 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+
+#include "cpplink_lib/modules.h"
+#include "cpplink_lib/block.h"
+
+using namespace cpplink;
+
+/*
+ * Per-tick cost of a chain of ModuleSum modules fed by a linear signal. The
+ * chain is stepped tick by tick with aliased nets as with --schedule=topo
+ * --wiring=alias, then in blocks of K ticks as with --block=K.
+ */
+
+const size_t K = 64;
+
+double nsPerTickScalar(size_t size, long ticks, double& last) {
+    OutputPin<double> source;
+    std::vector<ModuleSum<double>> sums(size);
+    std::vector<Net<double>> nets(size);
+    nets[0].setOutputPin(source);
+    for (size_t i = 0; i < size; i++) {
+        nets[i].addInputPin(sums[i].in1);
+        sums[i].in2 = 1.0;
+        if (i + 1 < size)
+            nets[i + 1].setOutputPin(sums[i].out);
+        nets[i].alias();
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    for (long i = 0; i < ticks; i++) {
+        source = double(i);
+        for (auto& s : sums)
+            s.step();
+    }
+    auto end = std::chrono::steady_clock::now();
+
+    last = sums.back().out.getValue();
+    return std::chrono::duration<double, std::nano>(end - start).count() / ticks;
+}
+
+double nsPerTickBlock(size_t size, long ticks, double& last) {
+    block::ModuleLinear<K> source;
+    block::ModuleConvert<int64_t, double, K> convert;
+    std::vector<block::ModuleSum<double, K>> sums(size);
+    std::vector<block::Net<double, K>> nets(size);
+    block::Net<int64_t, K> counter;
+    counter.setOutputPin(source.out);
+    counter.addInputPin(convert.in);
+    counter.alias();
+    nets[0].setOutputPin(convert.out);
+    for (size_t i = 0; i < size; i++) {
+        nets[i].addInputPin(sums[i].in1);
+        sums[i].in2 = 1.0;
+        if (i + 1 < size)
+            nets[i + 1].setOutputPin(sums[i].out);
+        nets[i].alias();
+    }
+
+    size_t k = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (long i = 0; i < ticks; i += K) {
+        k = std::min<long>(K, ticks - i);
+        source.stepBlock(k);
+        convert.stepBlock(k);
+        for (auto& s : sums)
+            s.stepBlock(k);
+    }
+    auto end = std::chrono::steady_clock::now();
+
+    last = sums.back().out.get(k - 1).value;
+    return std::chrono::duration<double, std::nano>(end - start).count() / ticks;
+}
+
+int main(int argc, char* argv[]) {
+    size_t size = argc > 1 ? std::atol(argv[1]) : 1000;
+    long ticks = argc > 2 ? std::atol(argv[2]) : 20000;
+
+    double scalarLast, blockLast;
+    double scalar = nsPerTickScalar(size, ticks, scalarLast);
+    double blocked = nsPerTickBlock(size, ticks, blockLast);
+
+    std::cout << size << " modules, " << ticks << " ticks\n";
+    std::cout << "  tick by tick: " << scalar << " ns/tick\n";
+    std::cout << "  blocks of " << K << ": " << blocked << " ns/tick\n";
+    if (scalarLast != blockLast) {
+        std::cout << "  results differ!\n";
+        return 1;
+    }
+    return 0;
+}
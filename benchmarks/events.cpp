@@ -0,0 +1,79 @@
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+
+#include "cpplink_lib/modules.h"
+
+using namespace cpplink;
+
+/*
+ * Per-tick cost of a chain of ModuleSum modules fed by a signal changing once
+ * in 100 ticks. Every module is stepped in every tick, then as with --events
+ * only nets whose driver stepped are compared and only modules whose input
+ * nets changed are stepped.
+ */
+
+struct Chain {
+    explicit Chain(size_t size) : sums(size), nets(size) {
+        nets[0].setOutputPin(source);
+        for (size_t i = 0; i < size; i++) {
+            nets[i].addInputPin(sums[i].in1);
+            sums[i].in2 = 1.0;
+            if (i + 1 < size)
+                nets[i + 1].setOutputPin(sums[i].out);
+        }
+    }
+
+    OutputPin<double> source;
+    std::vector<ModuleSum<double>> sums;
+    std::vector<Net<double>> nets;
+};
+
+double nsPerTick(size_t size, bool events, long ticks, double& last) {
+    Chain chain(size);
+    std::vector<char> dirty(size, true);
+    std::vector<char> pending(size, true); // driver of the net stepped
+
+    auto start = std::chrono::steady_clock::now();
+    for (long i = 0; i < ticks; i++) {
+        chain.source = double(i / 100);
+        for (size_t n = 0; n < size; n++) {
+            if (!events)
+                chain.nets[n].step();
+            else if ((n == 0 || pending[n]) && chain.nets[n].stepChanged())
+                dirty[n] = true;
+            pending[n] = false;
+        }
+        for (size_t m = 0; m < size; m++) {
+            if (!events || dirty[m]) {
+                dirty[m] = false;
+                chain.sums[m].step();
+                if (m + 1 < size)
+                    pending[m + 1] = true;
+            }
+        }
+    }
+    auto end = std::chrono::steady_clock::now();
+
+    last = chain.sums.back().out.getValue();
+    return std::chrono::duration<double, std::nano>(end - start).count() / ticks;
+}
+
+int main(int argc, char* argv[]) {
+    size_t size = argc > 1 ? std::atol(argv[1]) : 1000;
+    long ticks = argc > 2 ? std::atol(argv[2]) : 20000;
+
+    double allLast, eventsLast;
+    double all = nsPerTick(size, false, ticks, allLast);
+    double events = nsPerTick(size, true, ticks, eventsLast);
+
+    std::cout << size << " modules, " << ticks << " ticks\n";
+    std::cout << "  every module: " << all << " ns/tick\n";
+    std::cout << "  changed only: " << events << " ns/tick\n";
+    if (allLast != eventsLast) {
+        std::cout << "  results differ!\n";
+        return 1;
+    }
+    return 0;
+}
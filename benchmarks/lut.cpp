@@ -0,0 +1,55 @@
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+
+#include "cpplink_lib/modules.h"
+
+using namespace cpplink;
+
+/*
+ * Per-step cost of ModuleLog and ModuleSqrt compared to lookup tables of the
+ * same functions over [1, 101] with 1024 intervals.
+ */
+
+template <typename M>
+double nsPerStep(M& m, long steps) {
+    double checksum = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (long i = 0; i < steps; i++) {
+        m.in = 1 + (i % 10000) * 0.01;
+        m.step();
+        checksum += m.out.getValue();
+    }
+    auto end = std::chrono::steady_clock::now();
+
+    // Keep the result alive
+    if (checksum == 42.4242)
+        std::cout << "";
+    return std::chrono::duration<double, std::nano>(end - start).count() / steps;
+}
+
+template <typename F, Interpolation I>
+void report(const char* name, double libm, long steps) {
+    ModuleLUT<F, 1024, I> lut(1, 101);
+    LookupTable<F, I> table(1, 101, 1024);
+    std::cout << "  " << name << ": " << nsPerStep(lut, steps) << " ns/step, max error "
+              << table.maxError() << " (libm " << libm << " ns/step)\n";
+}
+
+int main(int argc, char* argv[]) {
+    long steps = argc > 1 ? std::atol(argv[1]) : 10000000;
+
+    ModuleLog log;
+    log.base = M_E;
+    ModuleSqrt sqrt;
+    double logLibm = nsPerStep(log, steps);
+    double sqrtLibm = nsPerStep(sqrt, steps);
+
+    std::cout << "Lookup tables, " << steps << " steps\n";
+    report<FuncLog, Interpolation::Linear>("LOG linear", logLibm, steps);
+    report<FuncLog, Interpolation::Cubic>("LOG cubic ", logLibm, steps);
+    report<FuncSqrt, Interpolation::Linear>("SQRT linear", sqrtLibm, steps);
+    report<FuncSqrt, Interpolation::Cubic>("SQRT cubic ", sqrtLibm, steps);
+    return 0;
+}
@@ -0,0 +1,70 @@
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include "cpplink_lib/maybe.h"
+
+using namespace cpplink;
+
+/*
+ * Cost of apply() on arrays of Maybe<double> with randomly invalid elements -
+ * branching on validity for a lambda, selecting the result of a total function
+ * without branches, and the same with the NaN-boxed representation.
+ */
+
+template <typename M, typename F>
+double nsPerElement(const std::vector<M>& a, const std::vector<M>& b, F f, int rounds) {
+    std::vector<M> out(a.size());
+    double checksum = 0;
+
+    auto start = std::chrono::steady_clock::now();
+    for (int r = 0; r < rounds; r++) {
+        for (size_t i = 0; i < a.size(); i++)
+            out[i] = apply(a[i], b[i], f);
+        checksum += out[r % out.size()].isValid();
+    }
+    auto end = std::chrono::steady_clock::now();
+
+    // Keep the result alive
+    if (checksum == 42.4242)
+        std::cout << "";
+    return std::chrono::duration<double, std::nano>(end - start).count() / (a.size() * rounds);
+}
+
+template <typename M>
+std::vector<M> randomValues(size_t size, double invalid, std::mt19937& gen) {
+    std::uniform_real_distribution<double> distr(0, 1);
+    std::vector<M> res;
+    for (size_t i = 0; i < size; i++)
+        res.push_back(distr(gen) < invalid ? M() : M(distr(gen)));
+    return res;
+}
+
+int main(int argc, char* argv[]) {
+    int rounds = argc > 1 ? std::atoi(argv[1]) : 1000;
+    const size_t size = 10000;
+    const double invalid = 0.3;
+
+    using Flag = Maybe<double, FlagRepr>;
+    using NanBox = Maybe<double, NanBoxRepr>;
+
+    std::mt19937 gen(42);
+    auto fa = randomValues<Flag>(size, invalid, gen);
+    auto fb = randomValues<Flag>(size, invalid, gen);
+    auto na = randomValues<NanBox>(size, invalid, gen);
+    auto nb = randomValues<NanBox>(size, invalid, gen);
+
+    auto lambda = [](double x, double y) { return x + y; };
+    double branchy = nsPerElement(fa, fb, lambda, rounds);
+    double select = nsPerElement(fa, fb, std::plus<double>(), rounds);
+    double nanbox = nsPerElement(na, nb, std::plus<double>(), rounds);
+
+    std::cout << "apply on Maybe<double>, " << size << " elements, "
+              << invalid * 100 << " % invalid\n";
+    std::cout << "  flag, branching:  " << branchy << " ns/element\n";
+    std::cout << "  flag, select:     " << select << " ns/element\n";
+    std::cout << "  NaN-boxed select: " << nanbox << " ns/element\n";
+    return 0;
+}
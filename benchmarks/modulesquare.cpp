@@ -0,0 +1,93 @@
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+
+#include "cpplink_lib/modulesquare.h"
+
+using namespace cpplink;
+
+/*
+ * Per-tick cost of ModuleSquare compared to the same system composed at
+ * runtime from Module* and BaseNet* vectors, where every net is stepped after
+ * every module.
+ */
+
+struct DynamicSquare : Module {
+
+    DynamicSquare() {
+        n1.addInputPin(sig.in);
+        n1.setOutputPin(sin.out);
+        n2.addInputPin(mu.in1);
+        n2.setOutputPin(conv.out);
+        n3.addInputPin(su.in1);
+        n3.setOutputPin(mu.out);
+        n4.addInputPin(conv.in);
+        n4.setOutputPin(sig.out);
+        sin.amplitude = 1;
+        mid = 0;
+    }
+
+    void step() {
+        for (unsigned i = 0; i < modules.size(); i++) {
+            modules[i]->step();
+            for (auto n : nets)
+                n->step();
+        }
+    }
+
+    InputPin<double>& period = sin.period;
+    InputPin<double>& ampl = mu.in2;
+    InputPin<double>& mid = su.in2;
+    OutputPin<double>& out = su.out;
+
+private:
+    ModuleSignum sig;
+    ModuleSin sin;
+    ModuleSum<double> su;
+    ModuleMult<double> mu;
+    ModuleConvert<int64_t, double> conv;
+    Net<double> n1;
+    Net<double> n2;
+    Net<double> n3;
+    Net<int64_t> n4;
+
+public:
+    std::vector<Module*> modules{&sin, &sig, &conv, &mu, &su};
+    std::vector<BaseNet*> nets{&n1, &n2, &n3, &n4};
+};
+
+template <typename Square>
+double nsPerTick(Module& m, Square& s, long ticks) {
+    s.period = 100;
+    s.ampl = 2;
+    s.mid = 1;
+
+    double checksum = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (long i = 0; i < ticks; i++) {
+        m.step();
+        checksum += s.out.getValue();
+    }
+    auto end = std::chrono::steady_clock::now();
+
+    // Keep the result alive
+    if (checksum == 42.4242)
+        std::cout << "";
+    return std::chrono::duration<double, std::nano>(end - start).count() / ticks;
+}
+
+int main(int argc, char* argv[]) {
+    long ticks = argc > 1 ? std::atol(argv[1]) : 10000000;
+
+    DynamicSquare dynamic;
+    ModuleSquare composite;
+
+    double before = nsPerTick(dynamic, dynamic, ticks);
+    double after = nsPerTick(composite, composite, ticks);
+
+    std::cout << "ModuleSquare, " << ticks << " ticks\n";
+    std::cout << "  Module*/BaseNet* vectors: " << before << " ns/tick\n";
+    std::cout << "  Composite:                " << after << " ns/tick\n";
+    return 0;
+}
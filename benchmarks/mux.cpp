@@ -0,0 +1,65 @@
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+
+#include "cpplink_lib/modules.h"
+
+using namespace cpplink;
+
+/*
+ * Per-tick cost of a 200-way ModuleMux with all values wired through nets,
+ * once propagated by copying into every input pin and once through demand
+ * pins, which the nets never copy into.
+ */
+
+const size_t width = 200;
+
+double nsPerTick(bool demand, long ticks) {
+    std::vector<OutputPin<double>> sources(width);
+    std::vector<Net<double>> nets(width);
+    ModuleMux<double, width> mux;
+
+    for (size_t i = 0; i < width; i++) {
+        sources[i] = double(i);
+        nets[i].setOutputPin(sources[i]);
+        if (demand)
+            nets[i].addDemandPin(mux.vals[i]);
+        else
+            nets[i].addInputPin(mux.vals[i]);
+    }
+    if (demand) {
+        for (auto& n : nets)
+            n.aliasDemand();
+    }
+
+    double checksum = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (long i = 0; i < ticks; i++) {
+        mux.state = i % 4;
+        if (!demand) {
+            for (auto& n : nets)
+                n.step();
+        }
+        mux.step();
+        checksum += mux.out.getValue();
+    }
+    auto end = std::chrono::steady_clock::now();
+
+    // Keep the result alive
+    if (checksum == 42.4242)
+        std::cout << "";
+    return std::chrono::duration<double, std::nano>(end - start).count() / ticks;
+}
+
+int main(int argc, char* argv[]) {
+    long ticks = argc > 1 ? std::atol(argv[1]) : 1000000;
+
+    double copy = nsPerTick(false, ticks);
+    double demand = nsPerTick(true, ticks);
+
+    std::cout << width << "-way mux, " << ticks << " ticks\n";
+    std::cout << "  copying nets: " << copy << " ns/tick\n";
+    std::cout << "  demand pins:  " << demand << " ns/tick\n";
+    return 0;
+}
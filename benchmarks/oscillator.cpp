@@ -0,0 +1,77 @@
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+
+#include "cpplink_lib/modules.h"
+
+using namespace cpplink;
+
+/*
+ * Throughput and accuracy of the sin oscillator compared to ModuleSin, which
+ * calls libm in every step. The error is measured against sinl of the exact
+ * phase after a long run, where the unbounded step counter of ModuleSin
+ * loses precision.
+ */
+
+template <typename Sin>
+double nsPerStep(std::vector<Sin>& oscillators, long steps) {
+    for (size_t i = 0; i < oscillators.size(); i++) {
+        oscillators[i].amplitude = 1.0;
+        oscillators[i].period = 10.0 + i;
+    }
+
+    double checksum = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (long i = 0; i < steps; i++) {
+        for (auto& o : oscillators) {
+            o.step();
+            checksum += o.out.getValue();
+        }
+    }
+    auto end = std::chrono::steady_clock::now();
+
+    // Keep the result alive
+    if (checksum == 42.4242)
+        std::cout << "";
+    return std::chrono::duration<double, std::nano>(end - start).count() / (steps * oscillators.size());
+}
+
+template <typename Sin>
+double maxError(long long steps, double period) {
+    Sin o;
+    o.amplitude = 1.0;
+    o.period = period;
+    double err = 0;
+    for (long long i = 0; i < steps; i++) {
+        o.step();
+        if (i % 1000 == 0 || i + 1 == steps) {
+            long double phase = std::fmod((long double)i, (long double)period) / period;
+            err = std::max(err, double(std::fabs(o.out.getValue() - sinl(2 * M_PI * phase))));
+        }
+    }
+    return err;
+}
+
+int main(int argc, char* argv[]) {
+    long steps = argc > 1 ? std::atol(argv[1]) : 100000;
+    const size_t count = 300;
+
+    std::vector<ModuleSin> libm(count);
+    std::vector<ModuleSinOsc> osc(count);
+    double before = nsPerStep(libm, steps);
+    double after = nsPerStep(osc, steps);
+
+    const long long long_run = 100000000;
+    double errBefore = maxError<ModuleSin>(long_run, 7.0);
+    double errAfter = maxError<ModuleSinOsc>(long_run, 7.0);
+
+    std::cout << count << " sin oscillators, " << steps << " steps\n";
+    std::cout << "  libm:       " << before << " ns/step\n";
+    std::cout << "  oscillator: " << after << " ns/step\n";
+    std::cout << "Max error in " << long_run << " steps, period 7\n";
+    std::cout << "  libm:       " << errBefore << "\n";
+    std::cout << "  oscillator: " << errAfter << "\n";
+    return 0;
+}
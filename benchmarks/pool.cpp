@@ -0,0 +1,73 @@
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <vector>
+
+#include "cpplink_lib/modules.h"
+#include "cpplink_lib/pool.h"
+
+using namespace cpplink;
+
+/*
+ * Per-tick cost of stepping many sums and moving averages, once as separate
+ * objects through Module* as composites do and once in a ModulePool per
+ * type - functions with their pins in parallel arrays, averages contiguously.
+ */
+
+const size_t count = 4096;
+
+template <typename Step>
+double nsPerTick(long ticks, Step step, const OutputPin<double>& probe) {
+    double checksum = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (long i = 0; i < ticks; i++) {
+        step();
+        checksum += probe.value.value;
+    }
+    auto end = std::chrono::steady_clock::now();
+
+    // Keep the result alive
+    if (checksum == 42.4242)
+        std::cout << "";
+    return std::chrono::duration<double, std::nano>(end - start).count() / ticks;
+}
+
+int main(int argc, char* argv[]) {
+    long ticks = argc > 1 ? std::atol(argv[1]) : 10000;
+
+    std::vector<std::unique_ptr<ModuleSum<double>>> sums;
+    std::vector<std::unique_ptr<ModuleMovingAvg<8>>> avgs;
+    std::vector<Module*> modules;
+    for (size_t i = 0; i < count; i++) {
+        sums.emplace_back(new ModuleSum<double>());
+        sums.back()->in1 = double(i);
+        sums.back()->in2 = 1.0;
+        avgs.emplace_back(new ModuleMovingAvg<8>());
+        avgs.back()->in = double(i);
+        modules.push_back(sums.back().get());
+        modules.push_back(avgs.back().get());
+    }
+    double scattered = nsPerTick(ticks, [&]() {
+        for (auto m : modules)
+            m->step();
+    }, sums.back()->out);
+
+    std::unique_ptr<ModulePool<ModuleSum<double>, count>> sumPool(new ModulePool<ModuleSum<double>, count>());
+    std::unique_ptr<ModulePool<ModuleMovingAvg<8>, count>> avgPool(new ModulePool<ModuleMovingAvg<8>, count>());
+    for (size_t i = 0; i < count; i++) {
+        auto&& s = (*sumPool)[i];
+        s.in1 = double(i);
+        s.in2 = 1.0;
+        (*avgPool)[i].in = double(i);
+    }
+    double pooled = nsPerTick(ticks, [&]() {
+        sumPool->step();
+        avgPool->step();
+    }, sumPool->out[count - 1]);
+
+    std::cout << count << " sums and " << count << " moving averages, " << ticks << " ticks\n";
+    std::cout << "  Module* calls: " << scattered << " ns/tick\n";
+    std::cout << "  module pools:  " << pooled << " ns/tick\n";
+    return 0;
+}
@@ -0,0 +1,98 @@
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+#include "cpplink_lib/modules.h"
+#include "cpplink_lib/processes.h"
+
+using namespace cpplink;
+
+/*
+ * Per-tick cost of a ring of chains of ModuleSum modules with two-phase
+ * stepping. Every chain reads the end of the previous one through a Mailbox,
+ * the chains are shared by a ProcessGroup as with --processes. A single
+ * process steps all of them, then every process steps its own range.
+ */
+
+struct Chain {
+    explicit Chain(size_t size) : sums(size), nets(size) {
+        for (size_t i = 0; i < size; i++) {
+            nets[i].setOutputPin(sums[i].out);
+            if (i + 1 < size)
+                nets[i].addInputPin(sums[i + 1].in1);
+            nets[i].addInputPin(sums[i].in2);
+            sums[i].out = double(i % 13);
+        }
+        head.setOutputPin(previous);
+        head.addInputPin(sums[0].in1);
+    }
+
+    void step() {
+        head.step();
+        for (auto& n : nets)
+            n.step();
+        for (auto& s : sums)
+            s.step();
+    }
+
+    std::vector<ModuleSum<double>> sums;
+    std::vector<Net<double>> nets;
+    OutputPin<double> previous;     // end of the previous chain
+    Net<double> head;
+};
+
+double nsPerTick(size_t chains, size_t size, size_t processes, long ticks, double& checksum) {
+    std::vector<Chain> ring;
+    ring.reserve(chains);   // chains are wired to their own members
+    for (size_t c = 0; c < chains; c++)
+        ring.emplace_back(size);
+    ProcessGroup group(processes, chains);
+    std::vector<Mailbox<double>> ends;
+    for (size_t c = 0; c < chains; c++)
+        ends.emplace_back(group);
+
+    auto start = std::chrono::steady_clock::now();
+    size_t p = group.spawn();
+    size_t from = chains * p / processes, to = chains * (p + 1) / processes;
+    for (long i = 0; i <= ticks; i++) {
+        for (size_t c = from; c < to; c++)
+            ends[c].publish(ring[c].sums.back().out.value, i);
+        group.wait();
+        if (i == ticks)
+            break;
+        for (size_t c = from; c < to; c++) {
+            ring[c].previous = ends[(c + chains - 1) % chains].read(i);
+            ring[c].step();
+        }
+    }
+    auto end = std::chrono::steady_clock::now();
+
+    // Ends of all chains were published after the last tick
+    checksum = 0;
+    for (size_t c = 0; c < chains; c++)
+        checksum += ends[c].read(ticks).value;
+    group.finish(p);
+    return std::chrono::duration<double, std::nano>(end - start).count() / ticks;
+}
+
+int main(int argc, char* argv[]) {
+    size_t chains = argc > 1 ? std::atol(argv[1]) : 64;
+    size_t size = argc > 2 ? std::atol(argv[2]) : 2000;
+    long ticks = argc > 3 ? std::atol(argv[3]) : 200;
+    size_t processes = argc > 4 ? std::atol(argv[4]) : std::max(1u, std::thread::hardware_concurrency());
+
+    double serialSum, partitionedSum;
+    double serial = nsPerTick(chains, size, 1, ticks, serialSum);
+    double partitioned = nsPerTick(chains, size, processes, ticks, partitionedSum);
+
+    std::cout << chains << " chains of " << size << " modules, " << ticks << " ticks\n";
+    std::cout << "  1 process:   " << serial << " ns/tick\n";
+    std::cout << "  " << processes << " processes: " << partitioned << " ns/tick\n";
+    if (serialSum != partitionedSum) {
+        std::cout << "  results differ!\n";
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,66 @@
+#include <chrono>
+#include <cstdlib>
+#include <ctime>
+#include <iostream>
+#include <random>
+
+#include "cpplink_lib/modules.h"
+
+using namespace cpplink;
+
+/*
+ * Per-step cost of ModuleRand compared to the former implementation, which
+ * constructed a std distribution over std::default_random_engine every step.
+ */
+
+struct StdRand : Module {
+
+    void step() {
+        double min_ = min.isValid()? min.getValue() : INT_MIN;
+        double max_ = max.isValid()? max.getValue() : INT_MAX;
+        std::uniform_real_distribution<double> distr(min_, max_);
+
+        out = distr(gen);
+    }
+
+    InputPin<double> min;
+    InputPin<double> max;
+    OutputPin<double> out;
+
+private:
+    std::default_random_engine gen{static_cast<unsigned long>(time(NULL))};
+};
+
+template <typename Rand>
+double nsPerStep(Rand& r, long steps) {
+    r.min = -1.0;
+    r.max = 1.0;
+
+    double checksum = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (long i = 0; i < steps; i++) {
+        r.step();
+        checksum += r.out.getValue();
+    }
+    auto end = std::chrono::steady_clock::now();
+
+    // Keep the result alive
+    if (checksum == 42.4242)
+        std::cout << "";
+    return std::chrono::duration<double, std::nano>(end - start).count() / steps;
+}
+
+int main(int argc, char* argv[]) {
+    long steps = argc > 1 ? std::atol(argv[1]) : 10000000;
+
+    StdRand std_rand;
+    ModuleRand<double> philox;
+
+    double before = nsPerStep(std_rand, steps);
+    double after = nsPerStep(philox, steps);
+
+    std::cout << "ModuleRand<REAL>, " << steps << " steps\n";
+    std::cout << "  default_random_engine: " << before << " ns/step\n";
+    std::cout << "  Philox4x32 blocks:     " << after << " ns/step\n";
+    return 0;
+}
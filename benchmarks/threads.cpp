@@ -0,0 +1,86 @@
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+#include "cpplink_lib/modules.h"
+#include "cpplink_lib/threads.h"
+
+using namespace cpplink;
+
+/*
+ * Per-tick cost of a ring of ModuleSum modules with two-phase stepping, once
+ * in a single thread and once shared by a ThreadTeam in the same way as the
+ * code generated with --threads. Both runs have to produce the same values.
+ */
+
+struct Ring {
+    explicit Ring(size_t size) : sums(size), nets(size) {
+        for (size_t i = 0; i < size; i++) {
+            nets[i].setOutputPin(sums[i].out);
+            nets[i].addInputPin(sums[(i + 1) % size].in1);
+            nets[i].addInputPin(sums[(i + 7) % size].in2);
+            sums[i].out = double(i % 13);
+        }
+    }
+
+    // Steps items [from, to) of the given phase
+    void propagate(size_t from, size_t to) {
+        for (size_t i = from; i < to; i++)
+            nets[i].step();
+    }
+
+    void step(size_t from, size_t to) {
+        for (size_t i = from; i < to; i++)
+            sums[i].step();
+    }
+
+    double checksum() {
+        double res = 0;
+        for (auto& s : sums)
+            res += s.out.getValue();
+        return res;
+    }
+
+    std::vector<ModuleSum<double>> sums;
+    std::vector<Net<double>> nets;
+};
+
+double nsPerTick(size_t size, size_t threads, long ticks, double& checksum) {
+    Ring ring(size);
+    SpinBarrier barrier(threads);
+    auto work = [&](size_t t) {
+        ring.propagate(size * t / threads, size * (t + 1) / threads);
+        barrier.wait();
+        ring.step(size * t / threads, size * (t + 1) / threads);
+    };
+    ThreadTeam<decltype(work)> team(barrier, work);
+
+    auto start = std::chrono::steady_clock::now();
+    for (long i = 0; i < ticks; i++)
+        team.run();
+    auto end = std::chrono::steady_clock::now();
+
+    checksum = ring.checksum();
+    return std::chrono::duration<double, std::nano>(end - start).count() / ticks;
+}
+
+int main(int argc, char* argv[]) {
+    size_t size = argc > 1 ? std::atol(argv[1]) : 50000;
+    long ticks = argc > 2 ? std::atol(argv[2]) : 200;
+    size_t threads = argc > 3 ? std::atol(argv[3]) : std::max(1u, std::thread::hardware_concurrency());
+
+    double serialSum, parallelSum;
+    double serial = nsPerTick(size, 1, ticks, serialSum);
+    double parallel = nsPerTick(size, threads, ticks, parallelSum);
+
+    std::cout << size << " modules, " << ticks << " ticks\n";
+    std::cout << "  1 thread:   " << serial << " ns/tick\n";
+    std::cout << "  " << threads << " threads: " << parallel << " ns/tick\n";
+    if (serialSum != parallelSum) {
+        std::cout << "  results differ!\n";
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,901 @@
+#include "bytecode.h"
+#include "quoteunquotecompiler.h"
+#include "schedule.h"
+#include "typechecker.h"
+#include "cpplink_lib/modules.h"
+#include "cpplink_lib/table_writer.h"
+
+#include <cstring>
+#include <functional>
+#include <sstream>
+#include <stdexcept>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace cpplink { namespace translator {
+
+using std::string;
+
+// ## Operations
+
+// Division and remainder throw on a zero divisor as ModuleFuncThrows does
+template <typename F>
+struct Checked {
+    template <typename T>
+    T operator()(T a, T b) const {
+        if (doubleEqual(b, 0))
+            throw std::invalid_argument("Division by 0");
+        return F()(a, b);
+    }
+};
+
+template <typename T, typename U>
+struct Identity {
+    Maybe<U> operator()(const Maybe<T>& m) const { return m; }
+};
+
+template <typename T, typename U>
+struct Negate {
+    Maybe<U> operator()(const Maybe<T>& m) const { return apply(m, std::negate<T>()); }
+};
+
+template <typename T, typename U>
+struct Not {
+    Maybe<U> operator()(const Maybe<T>& m) const { return apply(m, std::logical_not<T>()); }
+};
+
+template <typename T, typename U>
+struct Convert {
+    Maybe<U> operator()(const Maybe<T>& m) const { return m | [](T i)-> Maybe<U>{ return static_cast<U>(i); }; }
+};
+
+/*
+ * Instructions: control instructions, binary and unary operations on the
+ * registers of a type and multiplexers.
+ *
+ *   End                                          end of a tick
+ *   Enable group net reset n (bank reg)*n        reads an enable net, resets outputs of a disabled group
+ *   Propagate                                    copies driven values to the values read by modules
+ *   Guard rate group skip                        skips instructions of an inactive rate or group
+ *   Step module                                  steps a module object, copies its outputs
+ *   <binary> n (in1 in2 out)*n
+ *   <unary> n (in out)*n
+ *   <mux> state out n vals*n
+ */
+#define CPPLINK_OPCODES(CONTROL, BINARY, UNARY, MUX) \
+    CONTROL(End) \
+    CONTROL(Enable) \
+    CONTROL(Propagate) \
+    CONTROL(Guard) \
+    CONTROL(Step) \
+    BINARY(SumInt, int64_t, std::plus<int64_t>) \
+    BINARY(DiffInt, int64_t, std::minus<int64_t>) \
+    BINARY(MultInt, int64_t, std::multiplies<int64_t>) \
+    BINARY(DivInt, int64_t, Checked<std::divides<int64_t>>) \
+    BINARY(ModInt, int64_t, Checked<std::modulus<int64_t>>) \
+    BINARY(SumReal, double, std::plus<double>) \
+    BINARY(DiffReal, double, std::minus<double>) \
+    BINARY(MultReal, double, std::multiplies<double>) \
+    BINARY(DivReal, double, Checked<std::divides<double>>) \
+    BINARY(LogicAnd, bool, std::logical_and<bool>) \
+    BINARY(LogicOr, bool, std::logical_or<bool>) \
+    BINARY(LogicXor, bool, std::bit_xor<bool>) \
+    BINARY(LogicImpl, bool, FuncImpl) \
+    BINARY(LogicXnor, bool, FuncXnor) \
+    BINARY(LogicNand, bool, FuncNand) \
+    BINARY(LogicNor, bool, FuncNor) \
+    UNARY(IdentityInt, int64_t, int64_t, Identity) \
+    UNARY(IdentityReal, double, double, Identity) \
+    UNARY(IdentityBool, bool, bool, Identity) \
+    UNARY(NegateInt, int64_t, int64_t, Negate) \
+    UNARY(NegateReal, double, double, Negate) \
+    UNARY(NegateBool, bool, bool, Not) \
+    UNARY(ConvertIntInt, int64_t, int64_t, Convert) \
+    UNARY(ConvertIntReal, int64_t, double, Convert) \
+    UNARY(ConvertRealInt, double, int64_t, Convert) \
+    UNARY(ConvertRealReal, double, double, Convert) \
+    MUX(MuxInt, int64_t) \
+    MUX(MuxReal, double) \
+    MUX(MuxBool, bool)
+
+#define CPPLINK_CONTROL_ENUM(name) name,
+#define CPPLINK_BINARY_ENUM(name, T, F) name,
+#define CPPLINK_UNARY_ENUM(name, T, U, F) name,
+#define CPPLINK_MUX_ENUM(name, T) name,
+
+enum class Opcode : uint32_t {
+    CPPLINK_OPCODES(CPPLINK_CONTROL_ENUM, CPPLINK_BINARY_ENUM, CPPLINK_UNARY_ENUM, CPPLINK_MUX_ENUM)
+    Count
+};
+
+template <typename T> DataType bankOf();
+template <> DataType bankOf<int64_t>() { return Int; }
+template <> DataType bankOf<double>() { return Real; }
+template <> DataType bankOf<bool>() { return Bool; }
+
+enum class Kind { Control, Binary, Unary, Mux };
+
+// Kind of an instruction and banks of its input and output registers
+struct OpcodeInfo {
+    Kind kind;
+    DataType in;
+    DataType out;
+};
+
+#define CPPLINK_CONTROL_INFO(name) { Kind::Control, Int, Int },
+#define CPPLINK_BINARY_INFO(name, T, F) { Kind::Binary, bankOf<T>(), bankOf<T>() },
+#define CPPLINK_UNARY_INFO(name, T, U, F) { Kind::Unary, bankOf<T>(), bankOf<U>() },
+#define CPPLINK_MUX_INFO(name, T) { Kind::Mux, bankOf<T>(), bankOf<T>() },
+
+static const OpcodeInfo opcodes[] = {
+    CPPLINK_OPCODES(CPPLINK_CONTROL_INFO, CPPLINK_BINARY_INFO, CPPLINK_UNARY_INFO, CPPLINK_MUX_INFO)
+};
+
+// Registers 0 of every bank are never written, unconnected inputs read
+// them. Registers 1 are written by unconnected outputs and never read.
+const uint32_t nothingRegister = 0;
+const uint32_t sinkRegister = 1;
+
+// Operands of the instruction starting at `code`, 0 if they do not fit into `words`
+static size_t operandWords(const uint32_t* code, size_t words) {
+    Opcode op = Opcode(code[0]);
+    const uint32_t* a = code + 1;
+    auto fits = [&](size_t n) { return n < words ? n : 0; };
+    switch (opcodes[code[0]].kind) {
+    case Kind::Binary:
+        return words > 1 ? fits(1 + 3 * size_t(a[0])) : 0;
+    case Kind::Unary:
+        return words > 1 ? fits(1 + 2 * size_t(a[0])) : 0;
+    case Kind::Mux:
+        return words > 3 ? fits(3 + size_t(a[2])) : 0;
+    case Kind::Control:
+        break;
+    }
+    if (op == Opcode::Enable)
+        return words > 4 ? fits(4 + 2 * size_t(a[3])) : 0;
+    if (op == Opcode::Guard)
+        return fits(3);
+    if (op == Opcode::Step)
+        return fits(1);
+    return 0;
+}
+
+// ## Lowering
+
+struct Register {
+    DataType bank;
+    uint32_t reg;
+};
+
+static const std::map<std::pair<string, string>, Opcode> binaryOpcodes{
+    {{"ModuleSum", "INT"}, Opcode::SumInt}, {{"ModuleSum", "REAL"}, Opcode::SumReal},
+    {{"ModuleDiff", "INT"}, Opcode::DiffInt}, {{"ModuleDiff", "REAL"}, Opcode::DiffReal},
+    {{"ModuleMult", "INT"}, Opcode::MultInt}, {{"ModuleMult", "REAL"}, Opcode::MultReal},
+    {{"ModuleDiv", "INT"}, Opcode::DivInt}, {{"ModuleDiv", "REAL"}, Opcode::DivReal},
+    {{"ModuleMod", "INT"}, Opcode::ModInt},
+    {{"ModuleLogicAnd", ""}, Opcode::LogicAnd}, {{"ModuleLogicOr", ""}, Opcode::LogicOr},
+    {{"ModuleLogicXor", ""}, Opcode::LogicXor}, {{"ModuleLogicImpl", ""}, Opcode::LogicImpl},
+    {{"ModuleLogicXnor", ""}, Opcode::LogicXnor}, {{"ModuleLogicNand", ""}, Opcode::LogicNand},
+    {{"ModuleLogicNor", ""}, Opcode::LogicNor}
+};
+
+static const std::map<std::pair<string, string>, Opcode> unaryOpcodes{
+    {{"ModuleIdentity", "INT"}, Opcode::IdentityInt}, {{"ModuleIdentity", "REAL"}, Opcode::IdentityReal},
+    {{"ModuleIdentity", "BOOL"}, Opcode::IdentityBool},
+    {{"ModuleNegate", "INT"}, Opcode::NegateInt}, {{"ModuleNegate", "REAL"}, Opcode::NegateReal},
+    {{"ModuleNegate", "BOOL"}, Opcode::NegateBool},
+    {{"ModuleConvert", "INT INT"}, Opcode::ConvertIntInt}, {{"ModuleConvert", "INT REAL"}, Opcode::ConvertIntReal},
+    {{"ModuleConvert", "REAL INT"}, Opcode::ConvertRealInt}, {{"ModuleConvert", "REAL REAL"}, Opcode::ConvertRealReal}
+};
+
+static const std::map<string, Opcode> muxOpcodes{
+    {"INT", Opcode::MuxInt}, {"REAL", Opcode::MuxReal}, {"BOOL", Opcode::MuxBool}
+};
+
+static string joined(const std::vector<string>& items) {
+    string res;
+    for (const auto& i : items)
+        res += (res.empty() ? "" : " ") + i;
+    return res;
+}
+
+// Constants are parsed from the literals written into the translated code,
+// so both use the same values
+static uint64_t constantBits(const std::pair<DataType, string>& c) {
+    uint64_t bits = 0;
+    if (c.first == Int) {
+        int64_t i = std::stoll(c.second);
+        std::memcpy(&bits, &i, sizeof(i));
+    } else if (c.first == Real) {
+        double d = std::stod(c.second);
+        std::memcpy(&bits, &d, sizeof(d));
+    } else {
+        bits = c.second == "true";
+    }
+    return bits;
+}
+
+/*
+ * Program under construction. Modules of a guard block are lowered one by
+ * one, operations of the same opcode are collected into a single run.
+ */
+struct BytecodeWriter {
+    BytecodeWriter(const ParsedFile& file, std::vector<ParseError>& errors);
+
+    uint32_t addString(const string& s) {
+        uint32_t offset = strings.size();
+        strings.insert(strings.end(), s.begin(), s.end());
+        strings.push_back('\0');
+        return offset;
+    }
+
+    Register allocate(DataType bank) {
+        return { bank, registers[bank]++ };
+    }
+
+    // Register of a pin, the shared ones if it is not connected
+    uint32_t pin(size_t m, const string& access, bool output) const {
+        auto p = pins[m].find(access);
+        return p == pins[m].end() ? (output ? sinkRegister : nothingRegister) : p->second.reg;
+    }
+
+    void emit(Opcode op, const std::vector<uint32_t>& operands) {
+        block.push_back(uint32_t(op));
+        block.insert(block.end(), operands.begin(), operands.end());
+        blockInstructions++;
+    }
+
+    void lowerModule(size_t m, std::map<Opcode, std::vector<uint32_t>>& runs);
+    void lowerBlock(const std::vector<size_t>& modules);
+    std::vector<char> image(uint64_t seed) const;
+
+    std::vector<ParseError>& errors;
+    Dataflow graph;
+    uint32_t registers[3] = { 2, 2, 2 };
+    std::vector<std::map<string, Register>> pins;   // module -> access path -> register
+    std::vector<BytecodeConstant> constants;
+    std::vector<BytecodeModule> modules;
+    std::vector<BytecodeBinding> bindings;
+    std::vector<BytecodeNet> nets;
+    std::vector<uint32_t> code;
+    std::vector<uint32_t> block;
+    size_t blockInstructions = 0;
+    std::vector<char> strings;
+};
+
+BytecodeWriter::BytecodeWriter(const ParsedFile& file, std::vector<ParseError>& errors)
+    : errors(errors), graph(file), pins(graph.modules.size())
+{
+    std::map<string, Register> regs;
+    for (const auto& n : file.net_const) {
+        if (regs.count(n.net))
+            continue;
+        const auto& c = constDeclarations.at(n.net);
+        Register r = allocate(c.first);
+        regs.insert({ n.net, r });
+        constants.push_back({ uint32_t(r.bank), r.reg, constantBits(c) });
+    }
+
+    // Type of a net is given by the first pin wired to it
+    for (const auto& n : file.net_pin) {
+        size_t m = graph.index.at(n.module);
+        DataType type;
+        inferPinType(graph.modules[m], n.pin, type);
+        auto r = regs.find(n.net);
+        if (r == regs.end())
+            r = regs.insert({ n.net, allocate(type) }).first;
+        if (r->second.bank != type)
+            errors.push_back(ParseError("Mismatch in pin types in net: " + n.net, n.line));
+        pins[m][pinAccess(graph.modules[m], n.pin)] = r->second;
+    }
+
+    for (const auto& r : regs)
+        nets.push_back({ addString(r.first), uint32_t(r.second.bank), r.second.reg, 0 });
+
+    // Enable nets are read once at the beginning of every tick, groups with
+    // the reset policy clear their outputs while disabled
+    for (size_t g = 0; g < file.enables.size(); g++) {
+        std::vector<uint32_t> resets;
+        bool reset = file.enables[g].policy == "reset";
+        for (size_t m = 0; reset && m < graph.modules.size(); m++) {
+            if (graph.group[m] != g + 1)
+                continue;
+            for (const auto& net : graph.outputs[m]) {
+                resets.push_back(regs.at(net).bank);
+                resets.push_back(regs.at(net).reg);
+            }
+        }
+        std::vector<uint32_t> operands{ uint32_t(g), regs.at(file.enables[g].net).reg, reset,
+            uint32_t(resets.size() / 2) };
+        operands.insert(operands.end(), resets.begin(), resets.end());
+        emit(Opcode::Enable, operands);
+    }
+    emit(Opcode::Propagate, {});
+    code.swap(block);
+    blockInstructions = 0;
+
+    // Modules of the same rate and enable group form a block under one guard
+    std::vector<size_t> order = stepOrder(graph, Schedule::TwoPhase);
+    for (size_t first = 0; first < order.size(); ) {
+        size_t last = first;
+        while (last < order.size() && graph.rate[order[last]] == graph.rate[order[first]]
+               && graph.group[order[last]] == graph.group[order[first]])
+            last++;
+        lowerBlock(std::vector<size_t>(order.begin() + first, order.begin() + last));
+        first = last;
+    }
+    code.push_back(uint32_t(Opcode::End));
+}
+
+void BytecodeWriter::lowerModule(size_t m, std::map<Opcode, std::vector<uint32_t>>& runs) {
+    const ModuleDeclaration& d = *graph.modules[m];
+    string args = joined(d.template_args);
+
+    auto binary = binaryOpcodes.find({ d.type, args });
+    if (binary != binaryOpcodes.end()) {
+        auto& run = runs[binary->second];
+        run.insert(run.end(), { pin(m, "in1", false), pin(m, "in2", false), pin(m, "out", true) });
+        return;
+    }
+
+    auto unary = unaryOpcodes.find({ d.type, args });
+    if (unary != unaryOpcodes.end()) {
+        auto& run = runs[unary->second];
+        run.insert(run.end(), { pin(m, "in", false), pin(m, "out", true) });
+        return;
+    }
+
+    if (d.type == "ModuleMux" || d.type == "ModuleMuxDemand") {
+        uint32_t width = std::stoul(d.template_args[1]);
+        std::vector<uint32_t> operands{ pin(m, "state", false), pin(m, "out", true), width };
+        for (uint32_t i = 0; i < width; i++)
+            operands.push_back(pin(m, "vals[" + std::to_string(i) + "]", false));
+        emit(muxOpcodes.at(d.template_args[0]), operands);
+        return;
+    }
+
+    // Streams of random modules are given by their positions as in the translated code
+    if (!createModule(d)) {
+        string list;
+        for (const auto& arg : d.template_args)
+            list += (list.empty() ? "<" : ", ") + arg;
+        errors.push_back(ParseError(d.type + (list.empty() ? list : list + ">")
+            + " is not available in the bytecode, translate the netlist instead", d.line));
+        return;
+    }
+
+    BytecodeModule module{ addString(d.type + (args.empty() ? "" : " " + args)), uint32_t(m),
+        uint32_t(bindings.size()), 0 };
+    for (const auto& bound : pins[m]) {
+        string array = bound.first.substr(0, bound.first.find('['));
+        bool output = getPins(&d).at(array).dir == Direction::Out;
+        bindings.push_back({ addString(bound.first), uint32_t(bound.second.bank), bound.second.reg, output });
+        module.bindingCount++;
+    }
+    emit(Opcode::Step, { uint32_t(modules.size()) });
+    modules.push_back(module);
+}
+
+void BytecodeWriter::lowerBlock(const std::vector<size_t>& modules) {
+    std::map<Opcode, std::vector<uint32_t>> runs;
+    for (size_t m : modules)
+        lowerModule(m, runs);
+
+    // A run of the same operation is a single superinstruction
+    for (const auto& run : runs) {
+        uint32_t tuple = opcodes[uint32_t(run.first)].kind == Kind::Binary ? 3 : 2;
+        std::vector<uint32_t> operands{ uint32_t(run.second.size() / tuple) };
+        operands.insert(operands.end(), run.second.begin(), run.second.end());
+        emit(run.first, operands);
+    }
+
+    size_t m = modules.front();
+    if (graph.rate[m] != 1 || graph.group[m]) {
+        code.push_back(uint32_t(Opcode::Guard));
+        code.insert(code.end(), { uint32_t(graph.rate[m]), uint32_t(graph.group[m]), uint32_t(blockInstructions) });
+    }
+    code.insert(code.end(), block.begin(), block.end());
+    block.clear();
+    blockInstructions = 0;
+}
+
+template <typename T>
+static void append(std::vector<char>& image, const std::vector<T>& items) {
+    const char* bytes = reinterpret_cast<const char*>(items.data());
+    image.insert(image.end(), bytes, bytes + items.size() * sizeof(T));
+}
+
+std::vector<char> BytecodeWriter::image(uint64_t seed) const {
+    BytecodeHeader header{};
+    header.magic = BytecodeHeader::magicValue;
+    header.version = BytecodeHeader::currentVersion;
+    for (size_t b = 0; b < 3; b++)
+        header.registers[b] = registers[b];
+    header.constants = constants.size();
+    header.modules = modules.size();
+    header.bindings = bindings.size();
+    header.nets = nets.size();
+    header.groups = graph.enableNets.size();
+    header.code = code.size();
+    header.strings = strings.size();
+    header.seed = seed;
+
+    std::vector<char> res(reinterpret_cast<const char*>(&header),
+        reinterpret_cast<const char*>(&header) + sizeof(header));
+    append(res, constants);
+    append(res, modules);
+    append(res, bindings);
+    append(res, nets);
+    append(res, code);
+    append(res, strings);
+    return res;
+}
+
+std::vector<char> lowerToBytecode(const ParsedFile& file, uint64_t seed, std::vector<ParseError>& errors) {
+    size_t before = errors.size();
+    BytecodeWriter writer(file, errors);
+    if (errors.size() != before)
+        return {};
+    return writer.image(seed);
+}
+
+// ## Program image
+
+Bytecode::Bytecode(std::vector<char> image)
+    : owned(std::move(image)), data(owned.data()), size(owned.size()), mapped(false)
+{
+    check();
+}
+
+Bytecode::Bytecode(const char* data, size_t size, bool mapped) : data(data), size(size), mapped(mapped) {}
+
+std::unique_ptr<Bytecode> Bytecode::map(const std::string& path) {
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        throw std::runtime_error("Cannot open program " + path);
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0) {
+        close(fd);
+        throw std::runtime_error("Cannot read program " + path);
+    }
+    void* p = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (p == MAP_FAILED)
+        throw std::runtime_error("Cannot map program " + path);
+
+    std::unique_ptr<Bytecode> program(new Bytecode(static_cast<const char*>(p), st.st_size, true));
+    program->check();
+    return program;
+}
+
+Bytecode::~Bytecode() {
+    if (mapped)
+        munmap(const_cast<char*>(data), size);
+}
+
+const BytecodeConstant* Bytecode::constants() const {
+    return reinterpret_cast<const BytecodeConstant*>(data + sizeof(BytecodeHeader));
+}
+
+const BytecodeModule* Bytecode::modules() const {
+    return reinterpret_cast<const BytecodeModule*>(constants() + header().constants);
+}
+
+const BytecodeBinding* Bytecode::bindings() const {
+    return reinterpret_cast<const BytecodeBinding*>(modules() + header().modules);
+}
+
+const BytecodeNet* Bytecode::nets() const {
+    return reinterpret_cast<const BytecodeNet*>(bindings() + header().bindings);
+}
+
+const uint32_t* Bytecode::code() const {
+    return reinterpret_cast<const uint32_t*>(nets() + header().nets);
+}
+
+const char* Bytecode::string(uint32_t offset) const {
+    return reinterpret_cast<const char*>(code() + header().code) + offset;
+}
+
+const BytecodeNet* Bytecode::findNet(const std::string& name) const {
+    for (uint32_t n = 0; n < header().nets; n++) {
+        if (name == string(nets()[n].name))
+            return &nets()[n];
+    }
+    return nullptr;
+}
+
+// Every offset, register and instruction is checked, so a machine never
+// reads outside of the image or its registers
+void Bytecode::check() const {
+    auto fail = [](const char* what) { throw std::runtime_error(std::string("Invalid program: ") + what); };
+    if (size < sizeof(BytecodeHeader))
+        fail("too short");
+    const BytecodeHeader& h = header();
+    if (h.magic != BytecodeHeader::magicValue)
+        fail("not a CppLink program");
+    if (h.version != BytecodeHeader::currentVersion)
+        fail("unsupported version");
+    uint64_t expected = sizeof(BytecodeHeader) + uint64_t(h.constants) * sizeof(BytecodeConstant)
+        + uint64_t(h.modules) * sizeof(BytecodeModule) + uint64_t(h.bindings) * sizeof(BytecodeBinding)
+        + uint64_t(h.nets) * sizeof(BytecodeNet) + uint64_t(h.code) * sizeof(uint32_t) + h.strings;
+    if (expected != size)
+        fail("sizes of sections do not match");
+    if (h.strings && string(h.strings - 1)[0] != '\0')
+        fail("unterminated name");
+    for (uint32_t b = 0; b < 3; b++) {
+        if (h.registers[b] < 2)
+            fail("missing reserved registers");
+    }
+
+    auto reg = [&](uint32_t bank, uint32_t r) {
+        if (bank > 2 || r >= h.registers[bank])
+            fail("register out of range");
+    };
+    auto name = [&](uint32_t offset) {
+        if (offset >= h.strings)
+            fail("name out of range");
+    };
+    for (uint32_t i = 0; i < h.constants; i++)
+        reg(constants()[i].bank, constants()[i].reg);
+    for (uint32_t i = 0; i < h.modules; i++) {
+        const BytecodeModule& m = modules()[i];
+        name(m.declaration);
+        if (m.firstBinding > h.bindings || m.bindingCount > h.bindings - m.firstBinding)
+            fail("bindings out of range");
+    }
+    for (uint32_t i = 0; i < h.bindings; i++) {
+        name(bindings()[i].access);
+        reg(bindings()[i].bank, bindings()[i].reg);
+    }
+    for (uint32_t i = 0; i < h.nets; i++) {
+        name(nets()[i].name);
+        reg(nets()[i].bank, nets()[i].reg);
+    }
+
+    // Guards skip instructions of their block, which has to end before the tick does
+    std::vector<size_t> guardEnds;
+    size_t instructions = 0;
+    bool ended = false;
+    for (size_t pc = 0; pc < h.code; instructions++) {
+        const uint32_t* ins = code() + pc;
+        if (ended)
+            fail("instructions after the end");
+        if (ins[0] >= uint32_t(Opcode::Count))
+            fail("unknown opcode");
+        size_t words = operandWords(ins, h.code - pc);
+        Opcode op = Opcode(ins[0]);
+        const OpcodeInfo& info = opcodes[ins[0]];
+        const uint32_t* a = ins + 1;
+        if (words == 0 && op != Opcode::End && op != Opcode::Propagate)
+            fail("truncated instruction");
+        if (info.kind == Kind::Binary) {
+            for (uint32_t i = 0; i < a[0]; i++) {
+                reg(info.in, a[1 + 3 * i]);
+                reg(info.in, a[2 + 3 * i]);
+                reg(info.out, a[3 + 3 * i]);
+            }
+        } else if (info.kind == Kind::Unary) {
+            for (uint32_t i = 0; i < a[0]; i++) {
+                reg(info.in, a[1 + 2 * i]);
+                reg(info.out, a[2 + 2 * i]);
+            }
+        } else if (info.kind == Kind::Mux) {
+            reg(Int, a[0]);
+            reg(info.out, a[1]);
+            for (uint32_t i = 0; i < a[2]; i++)
+                reg(info.in, a[3 + i]);
+        } else if (op == Opcode::Enable) {
+            if (a[0] >= h.groups)
+                fail("enable group out of range");
+            reg(Bool, a[1]);
+            for (uint32_t i = 0; i < a[3]; i++)
+                reg(a[4 + 2 * i], a[5 + 2 * i]);
+        } else if (op == Opcode::Guard) {
+            if (a[0] == 0 || a[1] > h.groups)
+                fail("invalid guard");
+            guardEnds.push_back(instructions + 1 + a[2]);
+        } else if (op == Opcode::Step) {
+            if (a[0] >= h.modules)
+                fail("module out of range");
+        } else if (op == Opcode::End) {
+            ended = true;
+        }
+        pc += 1 + words;
+    }
+    if (!ended)
+        fail("missing end");
+    for (size_t end : guardEnds) {
+        if (end >= instructions)
+            fail("guard skips the end");
+    }
+}
+
+// ## Machine
+
+template <> BytecodeMachine::Bank<int64_t>& BytecodeMachine::bank<int64_t>() { return ints; }
+template <> BytecodeMachine::Bank<double>& BytecodeMachine::bank<double>() { return reals; }
+template <> BytecodeMachine::Bank<bool>& BytecodeMachine::bank<bool>() { return bools; }
+template <> const BytecodeMachine::Bank<int64_t>& BytecodeMachine::bank<int64_t>() const { return ints; }
+template <> const BytecodeMachine::Bank<double>& BytecodeMachine::bank<double>() const { return reals; }
+template <> const BytecodeMachine::Bank<bool>& BytecodeMachine::bank<bool>() const { return bools; }
+
+template <typename T>
+static void initialize(std::vector<Maybe<T>>& bank, uint32_t registers) {
+    bank.assign(registers, Maybe<T>());
+}
+
+template <typename T>
+static Maybe<T> constantValue(uint64_t bits) {
+    T value;
+    std::memcpy(&value, &bits, sizeof(value));
+    return Maybe<T>(value);
+}
+
+// Inputs read the registers directly, outputs are copied after the step
+template <typename T>
+static bool bindPin(RuntimeModule& m, const string& access, bool output, std::vector<Maybe<T>>& in,
+    std::vector<Maybe<T>>& out, uint32_t reg, std::vector<std::pair<const Maybe<T>*, Maybe<T>*>>& copies)
+{
+    if (output) {
+        auto pin = m.pin<OutputPin<T>>(access);
+        if (pin)
+            copies.push_back({ &pin->value, &out[reg] });
+        return pin;
+    }
+    auto pin = m.pin<InputPin<T>>(access);
+    if (pin)
+        pin->alias(in[reg]);
+    return pin;
+}
+
+BytecodeMachine::BytecodeMachine(const Bytecode& program) : program(program) {
+    const BytecodeHeader& h = program.header();
+    initialize(ints.out, h.registers[Int]);
+    initialize(reals.out, h.registers[Real]);
+    initialize(bools.out, h.registers[Bool]);
+    for (uint32_t i = 0; i < h.constants; i++) {
+        const BytecodeConstant& c = program.constants()[i];
+        if (c.bank == Int)
+            ints.out[c.reg] = constantValue<int64_t>(c.bits);
+        else if (c.bank == Real)
+            reals.out[c.reg] = constantValue<double>(c.bits);
+        else
+            bools.out[c.reg] = Maybe<bool>(c.bits != 0);
+    }
+    ints.in = ints.out;
+    reals.in = reals.out;
+    bools.in = bools.out;
+
+    for (uint32_t i = 0; i < h.modules; i++) {
+        const BytecodeModule& m = program.modules()[i];
+        std::istringstream declaration{ string(program.string(m.declaration)) };
+        ModuleDeclaration d;
+        declaration >> d.type;
+        for (string arg; declaration >> arg; )
+            d.template_args.push_back(arg);
+
+        Stepped s;
+        s.module = createModule(d);
+        if (!s.module)
+            throw std::runtime_error("Module " + string(program.string(m.declaration)) + " cannot be created");
+        s.module->seed(h.seed, m.stream);
+
+        for (uint32_t b = m.firstBinding; b < m.firstBinding + m.bindingCount; b++) {
+            const BytecodeBinding& binding = program.bindings()[b];
+            string access = program.string(binding.access);
+            std::vector<std::pair<const Maybe<int64_t>*, Maybe<int64_t>*>> intCopies;
+            std::vector<std::pair<const Maybe<double>*, Maybe<double>*>> realCopies;
+            std::vector<std::pair<const Maybe<bool>*, Maybe<bool>*>> boolCopies;
+            bool bound;
+            if (binding.bank == Int)
+                bound = bindPin(*s.module, access, binding.output, ints.in, ints.out, binding.reg, intCopies);
+            else if (binding.bank == Real)
+                bound = bindPin(*s.module, access, binding.output, reals.in, reals.out, binding.reg, realCopies);
+            else
+                bound = bindPin(*s.module, access, binding.output, bools.in, bools.out, binding.reg, boolCopies);
+            if (!bound)
+                throw std::runtime_error("Module " + d.type + " has no pin " + access + " of the bound type");
+            for (const auto& c : intCopies)
+                s.ints.push_back({ c.first, c.second });
+            for (const auto& c : realCopies)
+                s.reals.push_back({ c.first, c.second });
+            for (const auto& c : boolCopies)
+                s.bools.push_back({ c.first, c.second });
+        }
+        stepped.push_back(std::move(s));
+    }
+    enabled.resize(h.groups);
+}
+
+BytecodeMachine::~BytecodeMachine() {}
+
+void BytecodeMachine::thread(const void* const* handlers) {
+    const uint32_t* code = program.code();
+    for (size_t pc = 0; pc < program.header().code; ) {
+        threaded.push_back({ handlers[code[pc]], code[pc], code + pc + 1 });
+        pc += 1 + operandWords(code + pc, program.header().code - pc);
+    }
+}
+
+template <typename T, typename F>
+void BytecodeMachine::binary(const uint32_t* a) {
+    const Maybe<T>* in = bank<T>().in.data();
+    Maybe<T>* out = bank<T>().out.data();
+    const uint32_t* t = a + 1;
+    for (uint32_t n = a[0]; n; n--, t += 3)
+        out[t[2]] = apply(in[t[0]], in[t[1]], F());
+}
+
+template <typename T, typename U, typename F>
+void BytecodeMachine::unary(const uint32_t* a) {
+    const Maybe<T>* in = bank<T>().in.data();
+    Maybe<U>* out = bank<U>().out.data();
+    const uint32_t* t = a + 1;
+    for (uint32_t n = a[0]; n; n--, t += 2)
+        out[t[1]] = F()(in[t[0]]);
+}
+
+template <typename T>
+void BytecodeMachine::mux(const uint32_t* a) {
+    const Maybe<int64_t>& state = ints.in[a[0]];
+    Maybe<T>& out = bank<T>().out[a[1]];
+    if (state.isValid() && uint64_t(state.value) < a[2])
+        out = bank<T>().in[a[3 + state.value]];
+    else
+        out = Maybe<T>();
+}
+
+void BytecodeMachine::step(const Stepped& s) {
+    s.module->step();
+    for (const auto& c : s.ints)
+        *c.reg = *c.pin;
+    for (const auto& c : s.reals)
+        *c.reg = *c.pin;
+    for (const auto& c : s.bools)
+        *c.reg = *c.pin;
+}
+
+void BytecodeMachine::enable(const uint32_t* a) {
+    const Maybe<bool>& net = bools.out[a[1]];
+    enabled[a[0]] = net.isValid() && net.value;
+    if (enabled[a[0]] || !a[2])
+        return;
+    for (uint32_t i = 0; i < a[3]; i++) {
+        uint32_t bank = a[4 + 2 * i], reg = a[5 + 2 * i];
+        if (bank == Int)
+            ints.out[reg] = Maybe<int64_t>();
+        else if (bank == Real)
+            reals.out[reg] = Maybe<double>();
+        else
+            bools.out[reg] = Maybe<bool>();
+    }
+}
+
+bool BytecodeMachine::active(const uint32_t* a, long t) const {
+    return (a[0] == 1 || t % long(a[0]) == 0) && (!a[1] || enabled[a[1] - 1]);
+}
+
+void BytecodeMachine::propagate() {
+    std::copy(ints.out.begin(), ints.out.end(), ints.in.begin());
+    std::copy(reals.out.begin(), reals.out.end(), reals.in.begin());
+    std::copy(bools.out.begin(), bools.out.end(), bools.in.begin());
+}
+
+/*
+ * Dispatch loop. With GCC and Clang every handler jumps directly to the
+ * handler of the next instruction through its threaded address, other
+ * compilers dispatch through a switch.
+ */
+#if defined(__GNUC__)
+    #define CPPLINK_CASE(name) op_##name:
+    #define CPPLINK_NEXT() goto *(++ip)->handler
+    #define CPPLINK_JUMP() goto *ip->handler
+#else
+    #define CPPLINK_CASE(name) case Opcode::name:
+    #define CPPLINK_NEXT() ++ip; goto dispatch
+    #define CPPLINK_JUMP() goto dispatch
+#endif
+
+#define CPPLINK_BINARY_CASE(name, T, F) CPPLINK_CASE(name) binary<T, F>(ip->operands); CPPLINK_NEXT();
+#define CPPLINK_UNARY_CASE(name, T, U, F) CPPLINK_CASE(name) unary<T, U, F<T, U>>(ip->operands); CPPLINK_NEXT();
+#define CPPLINK_MUX_CASE(name, T) CPPLINK_CASE(name) mux<T>(ip->operands); CPPLINK_NEXT();
+#define CPPLINK_NO_CASE(name)
+
+void BytecodeMachine::tick(long t) {
+#if defined(__GNUC__)
+    #define CPPLINK_CONTROL_ADDRESS(name) &&op_##name,
+    #define CPPLINK_BINARY_ADDRESS(name, T, F) &&op_##name,
+    #define CPPLINK_UNARY_ADDRESS(name, T, U, F) &&op_##name,
+    #define CPPLINK_MUX_ADDRESS(name, T) &&op_##name,
+    static const void* const handlers[] = {
+        CPPLINK_OPCODES(CPPLINK_CONTROL_ADDRESS, CPPLINK_BINARY_ADDRESS, CPPLINK_UNARY_ADDRESS,
+            CPPLINK_MUX_ADDRESS)
+    };
+#else
+    static const void* const handlers[size_t(Opcode::Count)] = {};
+#endif
+    if (threaded.empty())
+        thread(handlers);
+
+    const Instruction* ip = threaded.data();
+#if defined(__GNUC__)
+    CPPLINK_JUMP();
+#else
+dispatch:
+    switch (Opcode(ip->opcode)) {
+#endif
+
+    CPPLINK_CASE(End)
+        return;
+    CPPLINK_CASE(Enable)
+        enable(ip->operands);
+        CPPLINK_NEXT();
+    CPPLINK_CASE(Propagate)
+        propagate();
+        CPPLINK_NEXT();
+    CPPLINK_CASE(Guard)
+        ip += active(ip->operands, t) ? 1 : 1 + ip->operands[2];
+        CPPLINK_JUMP();
+    CPPLINK_CASE(Step)
+        step(stepped[ip->operands[0]]);
+        CPPLINK_NEXT();
+    CPPLINK_OPCODES(CPPLINK_NO_CASE, CPPLINK_BINARY_CASE, CPPLINK_UNARY_CASE, CPPLINK_MUX_CASE)
+
+#if !defined(__GNUC__)
+    case Opcode::Count:
+        return;
+    }
+#endif
+}
+
+template <typename Dialect, typename T>
+static std::function<void(RuntimeTableWriter<Dialect>&)> column(const Maybe<T>* reg) {
+    return [reg](RuntimeTableWriter<Dialect>& table) { table << *reg; };
+}
+
+template <typename Dialect>
+void BytecodeMachine::simulate(long steps, const std::vector<string>& watched, std::ostream& out) {
+    std::vector<std::function<void(RuntimeTableWriter<Dialect>&)>> columns;
+    for (const auto& name : watched) {
+        const BytecodeNet* net = program.findNet(name);
+        if (!net)
+            throw std::invalid_argument("\"" + name + "\" is not a net of the program");
+        if (net->bank == Int)
+            columns.push_back(column<Dialect>(&ints.out[net->reg]));
+        else if (net->bank == Real)
+            columns.push_back(column<Dialect>(&reals.out[net->reg]));
+        else
+            columns.push_back(column<Dialect>(&bools.out[net->reg]));
+    }
+
+    std::vector<string> names{ "step" };
+    names.insert(names.end(), watched.begin(), watched.end());
+    RuntimeTableWriter<Dialect> table(out, names);
+    for (long i = 0; steps == -1 || i != steps; i++) {
+        tick(i);
+        if (watched.empty())
+            continue;
+        table << int(i);
+        for (const auto& c : columns)
+            c(table);
+        table.end_line();
+    }
+}
+
+void BytecodeMachine::run(long steps, const string& interface, const std::vector<string>& watched,
+    std::ostream& out)
+{
+    if (interface == "csv")
+        return simulate<CsvDialect>(steps, watched, out);
+    if (interface == "excel")
+        return simulate<ExcelCsvDialect>(steps, watched, out);
+    if (interface == "plain")
+        return simulate<PlainTextDialect>(steps, watched, out);
+    for (long i = 0; steps == -1 || i != steps; i++)
+        tick(i);
+}
+
+}}
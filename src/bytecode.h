@@ -0,0 +1,194 @@
+#pragma once
+
+#include "translator.h"
+#include "interpreter.h"
+#include "cpplink_lib/maybe.h"
+#include <cstdint>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace cpplink { namespace translator {
+
+/*
+ * Netlist lowered to a program of a register machine, which runs it without
+ * a C++ compiler and without the object graph of the interpreter. Every net
+ * has a register in the bank of its type (INT, REAL, BOOL). A tick reads the
+ * enable nets, copies the bank of driven values into the bank read by the
+ * modules - the copy wiring of the phased schedule done for all nets at once
+ * - and executes the operations of the modules.
+ *
+ * Arithmetic, logic, identity, negation, conversion and multiplexers are
+ * opcodes working on the registers directly, a run of the same arithmetic
+ * or logic operation is a single superinstruction. Other modules keep their
+ * state in modules.h objects, whose input pins read the registers and whose
+ * outputs are copied into them after a step.
+ *
+ * The program is a single position independent image in native byte order,
+ * so it can be written to a file and mapped back into memory:
+ *
+ *   BytecodeHeader
+ *   BytecodeConstant[constants]   initial values of registers
+ *   BytecodeModule[modules]       modules stepped through objects
+ *   BytecodeBinding[bindings]     their pins wired to registers
+ *   BytecodeNet[nets]             named nets which can be watched
+ *   uint32_t[code]                instructions - opcode and operands
+ *   char[strings]                 zero terminated names
+ */
+
+struct BytecodeHeader {
+    static const uint32_t magicValue = 0x4342434c;   // "LCBC"
+    static const uint32_t currentVersion = 1;
+
+    uint32_t magic;
+    uint32_t version;
+    uint32_t registers[3];      // per bank, indexed by DataType
+    uint32_t constants;
+    uint32_t modules;
+    uint32_t bindings;
+    uint32_t nets;
+    uint32_t groups;            // enable groups
+    uint32_t code;              // words of code
+    uint32_t strings;           // bytes of names
+    uint32_t reserved;
+    uint64_t seed;
+};
+
+struct BytecodeConstant {
+    uint32_t bank;
+    uint32_t reg;
+    uint64_t bits;              // int64_t, double or bool value
+};
+
+struct BytecodeModule {
+    uint32_t declaration;       // "type arg1 arg2 ..." in strings
+    uint32_t stream;            // stream of a random module
+    uint32_t firstBinding;
+    uint32_t bindingCount;
+};
+
+struct BytecodeBinding {
+    uint32_t access;            // access path of the pin in strings
+    uint32_t bank;
+    uint32_t reg;
+    uint32_t output;
+};
+
+struct BytecodeNet {
+    uint32_t name;
+    uint32_t bank;
+    uint32_t reg;
+    uint32_t reserved;
+};
+
+/*
+ * Lowers a type checked netlist into a program image. Modules which cannot
+ * be created without compiling the netlist give errors.
+ */
+std::vector<char> lowerToBytecode(const ParsedFile& file, uint64_t seed, std::vector<ParseError>& errors);
+
+/*
+ * Program image held in memory or mapped from a file. The image is checked
+ * when it is opened, std::runtime_error is thrown for images which are not
+ * programs of this version.
+ */
+class Bytecode {
+public:
+    explicit Bytecode(std::vector<char> image);
+    static std::unique_ptr<Bytecode> map(const std::string& path);
+    ~Bytecode();
+
+    Bytecode(const Bytecode&) = delete;
+    Bytecode& operator=(const Bytecode&) = delete;
+
+    const BytecodeHeader& header() const { return *reinterpret_cast<const BytecodeHeader*>(data); }
+    const BytecodeConstant* constants() const;
+    const BytecodeModule* modules() const;
+    const BytecodeBinding* bindings() const;
+    const BytecodeNet* nets() const;
+    const uint32_t* code() const;
+    const char* string(uint32_t offset) const;
+
+    // Net of the given name, null if there is none
+    const BytecodeNet* findNet(const std::string& name) const;
+
+private:
+    Bytecode(const char* data, size_t size, bool mapped);
+    void check() const;
+
+    std::vector<char> owned;
+    const char* data;
+    size_t size;
+    bool mapped;
+};
+
+/*
+ * Executes a program with a direct-threaded dispatch loop. Every instruction
+ * is threaded to the address of its handler before the first tick, operands
+ * are read from the image in place.
+ */
+class BytecodeMachine {
+public:
+    explicit BytecodeMachine(const Bytecode& program);
+    ~BytecodeMachine();
+
+    // Does `steps` ticks, -1 for infinity, and writes the watched nets after
+    // every tick to `out` in the given interface: csv, excel, plain or silent
+    void run(long steps, const std::string& interface, const std::vector<std::string>& watched,
+        std::ostream& out);
+
+    void tick(long t);
+
+private:
+    template <typename T>
+    struct Bank {
+        std::vector<Maybe<T>> out;  // values driven by modules
+        std::vector<Maybe<T>> in;   // values read by modules, copied once per tick
+    };
+
+    template <typename T>
+    struct OutputCopy {
+        const Maybe<T>* pin;
+        Maybe<T>* reg;
+    };
+
+    // Module stepped through its object and its outputs
+    struct Stepped {
+        ModulePtr module;
+        std::vector<OutputCopy<int64_t>> ints;
+        std::vector<OutputCopy<double>> reals;
+        std::vector<OutputCopy<bool>> bools;
+    };
+
+    struct Instruction {
+        const void* handler;
+        uint32_t opcode;
+        const uint32_t* operands;
+    };
+
+    template <typename T> Bank<T>& bank();
+    template <typename T> const Bank<T>& bank() const;
+
+    template <typename Dialect>
+    void simulate(long steps, const std::vector<std::string>& watched, std::ostream& out);
+
+    template <typename T, typename F> void binary(const uint32_t* operands);
+    template <typename T, typename U, typename F> void unary(const uint32_t* operands);
+    template <typename T> void mux(const uint32_t* operands);
+    void thread(const void* const* handlers);
+    void step(const Stepped& s);
+    void enable(const uint32_t* operands);
+    bool active(const uint32_t* operands, long t) const;
+    void propagate();
+
+    const Bytecode& program;
+    Bank<int64_t> ints;
+    Bank<double> reals;
+    Bank<bool> bools;
+    std::vector<Stepped> stepped;
+    std::vector<char> enabled;
+    std::vector<Instruction> threaded;
+};
+
+}}
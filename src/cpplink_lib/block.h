@@ -0,0 +1,341 @@
+#pragma once
+
+#ifndef _CPPLINK_EMBEDDED_CODE_
+    #include "maybe.h"
+    #include "doubleequal.h"
+    #include "modules.h"
+#endif // !_CPPLINK_EMBEDDED_CODE_
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+/*
+ * Block processing of up to K consecutive ticks of a single system. Every pin
+ * holds the values of the whole block in a struct-of-arrays layout, modules
+ * step a block by a loop over their per-tick kernels, which the compiler
+ * inlines and vectorizes. Input pins read the buffers of output pins
+ * directly. Slot 0 of a buffer keeps the last value of the previous block, so
+ * readers of a net closing a feedback loop can read one tick back.
+ */
+
+namespace cpplink { namespace block {
+
+template <typename T, size_t K>
+struct Samples {
+    using value_type = T;
+
+    std::array<T, K + 1> value;
+    std::array<bool, K + 1> valid;
+
+    Samples() : value(), valid() {} // nothing in all ticks
+
+    Samples(const T& t) { // the same value in all ticks
+        value.fill(t);
+        valid.fill(true);
+    }
+
+    Maybe<T> slot(size_t s) const {
+        if (valid[s])
+            return Maybe<T>(T(value[s]));
+        return Maybe<T>();
+    }
+};
+
+template <typename T, size_t K>
+struct InputPin {
+    InputPin() : values(&own.value[1]), valids(&own.valid[1]) {}
+
+    InputPin(const InputPin&) = delete;
+    InputPin& operator=(const InputPin&) = delete;
+
+    InputPin& operator=(const T& t) {
+        own = Samples<T, K>(t);
+        return *this;
+    }
+
+    // Reads the buffer of an output pin, one tick back when delayed
+    void alias(const Samples<T, K>& samples, bool delayed) {
+        values = &samples.value[delayed ? 0 : 1];
+        valids = &samples.valid[delayed ? 0 : 1];
+    }
+
+    // Value and validity in the i-th tick of the block
+    const T& operator[](size_t i) const { return values[i]; }
+    bool isValid(size_t i) const { return valids[i]; }
+
+private:
+    Samples<T, K> own;
+    const T* values;
+    const bool* valids;
+};
+
+template <typename T, size_t K>
+struct OutputPin {
+    Samples<T, K> samples;
+
+    void set(size_t i, bool valid, const T& t) {
+        samples.value[i + 1] = t;
+        samples.valid[i + 1] = valid;
+    }
+
+    Maybe<T> get(size_t i) const {
+        return samples.slot(i + 1);
+    }
+
+    // Keeps the last value of a block of k ticks for delayed readers
+    void carry(size_t k) {
+        samples.value[0] = samples.value[k];
+        samples.valid[0] = samples.valid[k];
+    }
+};
+
+template <typename T, size_t K>
+struct Net {
+
+    void addInputPin(InputPin<T, K>& in) {
+        inputs.push_back(&in);
+    }
+
+    void setOutputPin(OutputPin<T, K>& out) {
+        output = &out;
+    }
+
+    // Input pins read the buffer of the output pin
+    void alias() {
+        for (auto in : inputs)
+            in->alias(output->samples, false);
+    }
+
+    // Input pins read values of the previous tick, carry() has to be called
+    // after every block
+    void aliasLatched() {
+        for (auto in : inputs)
+            in->alias(output->samples, true);
+    }
+
+    void carry(size_t k) {
+        output->carry(k);
+    }
+
+    Maybe<T> getValue(size_t i) const {
+        return output->get(i);
+    }
+
+private:
+    std::vector<InputPin<T, K>*> inputs;
+    OutputPin<T, K>* output;
+};
+
+/*
+ * Modules define step(i) computing the i-th tick of the block, stepBlock(k)
+ * steps the first k ticks. Modules in a feedback loop are stepped tick by
+ * tick instead.
+ */
+template <typename M>
+struct BlockModule {
+    void stepBlock(size_t k) {
+        M& m = static_cast<M&>(*this);
+        for (size_t i = 0; i < k; i++)
+            m.step(i);
+    }
+};
+
+// ## Generators
+
+template <double (*F)(double), size_t K>
+struct ModuleTrigo : BlockModule<ModuleTrigo<F, K>> {
+
+    void step(size_t i) {
+        if (!amplitude.isValid(i) || !period.isValid(i) || doubleEqual(period[i], 0)) {
+            x = 0;
+            out.set(i, false, 0);
+            return;
+        }
+        double val = in.isValid(i) ? in[i] : x;
+        out.set(i, true, amplitude[i] * F((2 * M_PI * val) / period[i]));
+        x++;
+    }
+
+    InputPin<double, K> amplitude;
+    InputPin<double, K> period;
+    InputPin<double, K> in;
+    OutputPin<double, K> out;
+
+private:
+    double x = 0;
+};
+
+template <size_t K>
+using ModuleSin = ModuleTrigo<sin, K>;
+template <size_t K>
+using ModuleCos = ModuleTrigo<cos, K>;
+
+
+template <size_t K>
+struct ModuleSaw : BlockModule<ModuleSaw<K>> {
+
+    void step(size_t i) {
+        if (!period.isValid(i) || doubleEqual(period[i], 0) || !amplitude.isValid(i)) {
+            phase = 0;
+            out.set(i, false, 0);
+            return;
+        }
+        double per = period[i];
+        double amp = amplitude[i];
+        phase += 1;
+        while (phase > per)
+            phase -= per;
+
+        double q_period = per / 4.0;
+        if (phase < q_period)
+            out.set(i, true, phase / q_period * amp);
+        else if (phase < 3 * q_period)
+            out.set(i, true, amp - (phase - q_period) / q_period * amp);
+        else
+            out.set(i, true, -amp + (phase - 3 * q_period) / q_period * amp);
+    }
+
+    InputPin<double, K> amplitude;
+    InputPin<double, K> period;
+    OutputPin<double, K> out;
+
+private:
+    double phase = 0;
+};
+
+
+template <size_t K>
+struct ModuleLinear : BlockModule<ModuleLinear<K>> {
+
+    void step(size_t i) {
+        out.set(i, true, x++);
+    }
+
+    OutputPin<int64_t, K> out;
+
+private:
+    int64_t x = 0;
+};
+
+
+// ## Helpers
+
+template <typename T, typename U, size_t K>
+struct ModuleConvert : BlockModule<ModuleConvert<T, U, K>> {
+
+    void step(size_t i) {
+        bool valid = in.isValid(i);
+        out.set(i, valid, valid ? static_cast<U>(in[i]) : U());
+    }
+
+    InputPin<T, K> in;
+    OutputPin<U, K> out;
+};
+
+
+template <typename T, size_t K>
+struct ModuleIdentity : BlockModule<ModuleIdentity<T, K>> {
+
+    void step(size_t i) {
+        out.set(i, in.isValid(i), in[i]);
+    }
+
+    InputPin<T, K> in;
+    OutputPin<T, K> out;
+};
+
+
+template <typename T, size_t K>
+struct ModuleClamp : BlockModule<ModuleClamp<T, K>> {
+
+    void step(size_t i) {
+        bool valid = min.isValid(i) && max.isValid(i);
+        T x = in.isValid(i) ? in[i] : T();
+        T v = x < min[i] ? min[i] : x;
+        out.set(i, valid, v > max[i] ? max[i] : v);
+    }
+
+    InputPin<T, K> min;
+    InputPin<T, K> max;
+    InputPin<T, K> in;
+    OutputPin<T, K> out;
+};
+
+
+// ## Functions
+
+template <typename T, typename F, size_t K>
+struct ModuleFunc : BlockModule<ModuleFunc<T, F, K>> {
+    using R = typename std::result_of<F(T, T)>::type;
+
+    void step(size_t i) {
+        bool valid = in1.isValid(i) & in2.isValid(i);
+        out.set(i, valid, F()(sanitize(valid, in1[i]), sanitize(valid, in2[i])));
+    }
+
+    InputPin<T, K> in1;
+    InputPin<T, K> in2;
+    OutputPin<R, K> out;
+};
+
+template <typename T, size_t K>
+using ModuleSum = ModuleFunc<T, std::plus<T>, K>;
+template <typename T, size_t K>
+using ModuleDiff = ModuleFunc<T, std::minus<T>, K>;
+template <typename T, size_t K>
+using ModuleMult = ModuleFunc<T, std::multiplies<T>, K>;
+
+template <size_t K>
+using ModuleLogicAnd = ModuleFunc<bool, std::logical_and<bool>, K>;
+template <size_t K>
+using ModuleLogicOr = ModuleFunc<bool, std::logical_or<bool>, K>;
+template <size_t K>
+using ModuleLogicXor = ModuleFunc<bool, std::bit_xor<bool>, K>;
+template <size_t K>
+using ModuleLogicImpl = ModuleFunc<bool, FuncImpl, K>;
+template <size_t K>
+using ModuleLogicXnor = ModuleFunc<bool, FuncXnor, K>;
+template <size_t K>
+using ModuleLogicNand = ModuleFunc<bool, FuncNand, K>;
+template <size_t K>
+using ModuleLogicNor = ModuleFunc<bool, FuncNor, K>;
+
+template <typename T, size_t K>
+using ModuleLess = ModuleFunc<T, std::less<T>, K>;
+template <typename T, size_t K>
+using ModuleLessEqual = ModuleFunc<T, std::less_equal<T>, K>;
+template <typename T, size_t K>
+using ModuleGreater = ModuleFunc<T, std::greater<T>, K>;
+template <typename T, size_t K>
+using ModuleGreaterEqual = ModuleFunc<T, std::greater_equal<T>, K>;
+template <typename T, size_t K>
+using ModuleEqual = ModuleFunc<T, std::equal_to<T>, K>;
+template <typename T, size_t K>
+using ModuleNotEqual = ModuleFunc<T, std::not_equal_to<T>, K>;
+
+
+template <typename T, size_t K>
+struct ModuleNegate : BlockModule<ModuleNegate<T, K>> {
+
+    void step(size_t i) {
+        bool valid = in.isValid(i);
+        out.set(i, valid, -sanitize(valid, in[i]));
+    }
+
+    InputPin<T, K> in;
+    OutputPin<T, K> out;
+};
+
+template <size_t K>
+struct ModuleNegate<bool, K> : BlockModule<ModuleNegate<bool, K>> {
+
+    void step(size_t i) {
+        out.set(i, in.isValid(i), !in[i]);
+    }
+
+    InputPin<bool, K> in;
+    OutputPin<bool, K> out;
+};
+
+}} //namespace cpplink::block
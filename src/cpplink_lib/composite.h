@@ -0,0 +1,105 @@
+#pragma once
+
+#ifndef _CPPLINK_EMBEDDED_CODE_
+    #include "modules.h"
+#endif // !_CPPLINK_EMBEDDED_CODE_
+
+#include <tuple>
+#include <type_traits>
+
+namespace cpplink {
+
+/*
+ * Pin member pointer as a pair of its type and value, C++11 cannot deduce the
+ * type of a non-type template argument.
+ */
+#define CPPLINK_PIN(pin) decltype(pin), pin
+
+// Module and value type of a pin member pointer, only pins of the given
+// direction are accepted
+template <typename P>
+struct OutputPinOf;
+
+template <typename M, typename T>
+struct OutputPinOf<OutputPin<T> M::*> {
+    using Module = M;
+    using Value = T;
+};
+
+template <typename P>
+struct InputPinOf;
+
+template <typename M, typename T>
+struct InputPinOf<InputPin<T> M::*> {
+    using Module = M;
+    using Value = T;
+};
+
+/*
+ * Type-level net of a Composite. Value of the output pin Out of the Src-th
+ * submodule is delivered into the input pin In of the Dst-th submodule, e.g.
+ * Wire<0, CPPLINK_PIN(&Sin::out), 1, CPPLINK_PIN(&Sgn::in)>.
+ */
+template <size_t Src, typename OutPin, OutPin Out, size_t Dst, typename InPin, InPin In>
+struct Wire {
+    using Output = OutputPinOf<OutPin>;
+    using Input = InputPinOf<InPin>;
+    static_assert(std::is_same<typename Output::Value, typename Input::Value>::value,
+                  "Wired pins hold values of different types");
+
+    static const size_t source = Src;
+
+    template <typename Modules>
+    static void propagate(Modules& modules) {
+        static_assert(std::is_base_of<typename Output::Module,
+                                      typename std::tuple_element<Src, Modules>::type>::value,
+                      "Output pin does not belong to the source submodule");
+        static_assert(std::is_base_of<typename Input::Module,
+                                      typename std::tuple_element<Dst, Modules>::type>::value,
+                      "Input pin does not belong to the destination submodule");
+        (std::get<Dst>(modules).*In).value = (std::get<Src>(modules).*Out).value;
+    }
+};
+
+/*
+ * Module composed of submodules known at compile time. Submodules are stepped
+ * in the order of the tuple, outputs of each submodule are propagated by its
+ * wires right after its step. The whole step is unrolled at compile time and
+ * the submodules are called without virtual dispatch.
+ */
+template <typename Modules, typename... Wires>
+struct Composite : Module {
+
+    void step() {
+        stepFrom<0>();
+    }
+
+protected:
+    Modules modules;
+
+private:
+    static const size_t count = std::tuple_size<Modules>::value;
+
+    template <size_t I>
+    typename std::enable_if<I == count>::type stepFrom() {}
+
+    template <size_t I>
+    typename std::enable_if<(I < count)>::type stepFrom() {
+        using Submodule = typename std::tuple_element<I, Modules>::type;
+        std::get<I>(modules).Submodule::step();
+        propagate<I, Wires...>();
+        stepFrom<I + 1>();
+    }
+
+    template <size_t I>
+    void propagate() {}
+
+    template <size_t I, typename W, typename... Rest>
+    void propagate() {
+        if (W::source == I)
+            W::propagate(modules);
+        propagate<I, Rest...>();
+    }
+};
+
+} //namespace cpplink
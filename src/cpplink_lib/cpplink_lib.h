@@ -2,6 +2,15 @@
 
 #include "doubleequal.h"
 #include "maybe.h"
+#include "philox.h"
+#include "lut.h"
 #include "modules.h"
+#include "composite.h"
+#include "lanes.h"
+#include "block.h"
+#include "threads.h"
+#include "processes.h"
+#include "periodic.h"
+#include "pool.h"
 #include "modulesquare.h"
 #include "table_writer.h"
\ No newline at end of file
@@ -0,0 +1,527 @@
+#pragma once
+
+#ifndef _CPPLINK_EMBEDDED_CODE_
+    #include "maybe.h"
+    #include "doubleequal.h"
+    #include "modules.h"
+    #include "philox.h"
+    #include "table_writer.h"
+#endif // !_CPPLINK_EMBEDDED_CODE_
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <initializer_list>
+#include <memory>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+/*
+ * Batched simulation of N instances of the same system. Every pin holds N
+ * lanes in a struct-of-arrays layout - an array of values and a validity
+ * bitmask. Modules process all lanes in tight loops over plain arrays, which
+ * the compiler can vectorize. BOOL lanes are bit-sliced - values are packed
+ * into 64-bit words as well, so logic modules process 64 instances with a
+ * single bitwise operation.
+ */
+
+namespace cpplink { namespace batch {
+
+/*
+ * N values on the heap, with the interface of std::array. A copy keeps its
+ * own buffer and copies the values, so propagating a net does not allocate.
+ */
+template <typename T, size_t N>
+class HeapArray {
+public:
+    HeapArray() : values(new T[N]()) {} // value-initialized
+
+    HeapArray(const HeapArray& a) : HeapArray() {
+        *this = a;
+    }
+
+    // The first values given, the rest value-initialized
+    HeapArray(std::initializer_list<T> l) : HeapArray() {
+        std::copy(l.begin(), l.begin() + std::min(l.size(), N), begin());
+    }
+
+    HeapArray& operator=(const HeapArray& a) {
+        std::copy(a.begin(), a.end(), begin());
+        return *this;
+    }
+
+    T& operator[](size_t i) { return values[i]; }
+    const T& operator[](size_t i) const { return values[i]; }
+
+    T* begin() { return values.get(); }
+    T* end() { return values.get() + N; }
+    const T* begin() const { return values.get(); }
+    const T* end() const { return values.get() + N; }
+
+    void fill(const T& t) {
+        std::fill(begin(), end(), t);
+    }
+
+    bool operator==(const HeapArray& a) const {
+        return std::equal(begin(), end(), a.begin());
+    }
+
+private:
+    std::unique_ptr<T[]> values;
+};
+
+/*
+ * Lanes up to 4 KiB stay inline in a std::array, which the compiler
+ * vectorizes best. Larger ones go to the heap, modules of many instances
+ * would not fit on the stack of the generated main().
+ */
+template <typename T, size_t N>
+using LaneArray = typename std::conditional<(sizeof(T) * N <= 4096),
+    std::array<T, N>, HeapArray<T, N>>::type;
+
+template <typename T, size_t N>
+struct Lanes {
+    static const size_t words = (N + 63) / 64;
+    using value_type = T;
+
+    LaneArray<T, N> value;
+    LaneArray<uint64_t, words> valid;
+
+    Lanes() : value(), valid() {} // nothing in all lanes
+
+    Lanes(const T& t) : valid() { // the same value in all lanes
+        value.fill(t);
+        for (size_t i = 0; i < N; i++)
+            setValid(i, true);
+    }
+
+    bool isValid(size_t lane) const {
+        return (valid[lane / 64] >> (lane % 64)) & 1;
+    }
+
+    void setValid(size_t lane, bool v) {
+        uint64_t bit = uint64_t(1) << (lane % 64);
+        valid[lane / 64] = v ? (valid[lane / 64] | bit) : (valid[lane / 64] & ~bit);
+    }
+
+    T get(size_t lane) const { return value[lane]; }
+    void set(size_t lane, const T& t) { value[lane] = t; }
+
+    Maybe<T> lane(size_t i) const {
+        if (isValid(i))
+            return Maybe<T>(T(value[i]));
+        return Maybe<T>();
+    }
+};
+
+template <size_t N>
+struct Lanes<bool, N> {
+    static const size_t words = (N + 63) / 64;
+    using value_type = bool;
+
+    LaneArray<uint64_t, words> value; // bit lane % 64 of word lane / 64
+    LaneArray<uint64_t, words> valid;
+
+    Lanes() : value(), valid() {}
+
+    Lanes(bool t) {
+        for (size_t w = 0; w < words; w++) {
+            valid[w] = mask(w);
+            value[w] = t ? mask(w) : 0;
+        }
+    }
+
+    // Bits of the lanes held in the w-th word
+    static uint64_t mask(size_t w) {
+        size_t bits = w + 1 < words || N % 64 == 0 ? 64 : N % 64;
+        return bits == 64 ? ~uint64_t(0) : (uint64_t(1) << bits) - 1;
+    }
+
+    bool isValid(size_t lane) const {
+        return (valid[lane / 64] >> (lane % 64)) & 1;
+    }
+
+    void setValid(size_t lane, bool v) {
+        uint64_t bit = uint64_t(1) << (lane % 64);
+        valid[lane / 64] = v ? (valid[lane / 64] | bit) : (valid[lane / 64] & ~bit);
+    }
+
+    bool get(size_t lane) const {
+        return (value[lane / 64] >> (lane % 64)) & 1;
+    }
+
+    void set(size_t lane, bool t) {
+        uint64_t bit = uint64_t(1) << (lane % 64);
+        value[lane / 64] = t ? (value[lane / 64] | bit) : (value[lane / 64] & ~bit);
+    }
+
+    Maybe<bool> lane(size_t i) const {
+        if (isValid(i))
+            return Maybe<bool>(get(i));
+        return Maybe<bool>();
+    }
+};
+
+template <typename T, size_t N>
+struct InputPin {
+    Lanes<T, N> value;
+
+    const Lanes<T, N>& get() const { return value; }
+
+    InputPin& operator=(const T& t) {
+        value = Lanes<T, N>(t);
+        return *this;
+    }
+};
+
+template <typename T, size_t N>
+struct OutputPin {
+    Lanes<T, N> value;
+};
+
+template <typename T, size_t N>
+struct Net : BaseNet {
+
+    void addInputPin(InputPin<T, N>& in) {
+        inputs.push_back(&in);
+    }
+
+    void setOutputPin(OutputPin<T, N>& out) {
+        output = &out;
+    }
+
+    void step() {
+        for (auto in : this->inputs)
+            in->value = output->value;
+    }
+
+    const Lanes<T, N>& getValue() {
+        return output->value;
+    }
+
+private:
+    std::vector<InputPin<T, N>*> inputs;
+    OutputPin<T, N>* output;
+};
+
+// Validity of lanes where all operands are valid
+template <typename T, size_t N>
+void allValid(LaneArray<uint64_t, Lanes<T, N>::words>& res, const Lanes<T, N>& l) {
+    res = l.valid;
+}
+
+template <typename T, size_t N, typename U, typename... Rest>
+void allValid(LaneArray<uint64_t, Lanes<T, N>::words>& res, const Lanes<T, N>& l,
+    const Lanes<U, N>& m, const Rest&... rest)
+{
+    allValid<U, N>(res, m, rest...);
+    for (size_t w = 0; w < Lanes<T, N>::words; w++)
+        res[w] &= l.valid[w];
+}
+
+// ## Generators
+
+template <double (*F)(double), size_t N>
+struct ModuleTrigo : Module {
+
+    void step() {
+        const auto& amp = amplitude.get();
+        const auto& per = period.get();
+        const auto& val = in.get();
+        for (size_t i = 0; i < N; i++) {
+            bool on = amp.isValid(i) && per.isValid(i) && !doubleEqual(per.value[i], 0);
+            double arg = val.isValid(i) ? val.value[i] : x[i];
+            out.value.value[i] = on ? amp.value[i] * F((2 * M_PI * arg) / per.value[i]) : 0;
+            out.value.setValid(i, on);
+            x[i] = on ? x[i] + 1 : 0;
+        }
+    }
+
+    InputPin<double, N> amplitude;
+    InputPin<double, N> period;
+    InputPin<double, N> in;
+    OutputPin<double, N> out;
+
+private:
+    LaneArray<double, N> x{};
+};
+
+template <size_t N>
+using ModuleSin = ModuleTrigo<sin, N>;
+template <size_t N>
+using ModuleCos = ModuleTrigo<cos, N>;
+
+
+template <size_t N>
+struct ModuleInstance : Module {
+
+    ModuleInstance() {
+        for (size_t i = 0; i < N; i++)
+            out.value.value[i] = i;
+    }
+
+    void step() {
+        for (size_t i = 0; i < N; i++)
+            out.value.setValid(i, true);
+    }
+
+    OutputPin<int64_t, N> out;
+};
+
+
+/*
+ * Random bits, a single draw fills a word of 64 instances. Every instance
+ * gets its own sequence, however not the one of a single instance simulation.
+ */
+template <typename T, size_t N>
+struct ModuleRand;
+
+template <size_t N>
+struct ModuleRand<bool, N> : Module {
+
+    void seed(uint64_t seed, uint64_t stream) {
+        random.reset(seed, stream);
+    }
+
+    void step() {
+        for (size_t w = 0; w < Lanes<bool, N>::words; w++) {
+            out.value.value[w] = random.next() & Lanes<bool, N>::mask(w);
+            out.value.valid[w] = Lanes<bool, N>::mask(w);
+        }
+    }
+
+    OutputPin<bool, N> out;
+
+private:
+    RandomStream<> random;
+};
+
+
+// ## Helpers
+
+template <typename T, typename U, size_t N>
+struct ModuleConvert : Module {
+
+    void step() {
+        const auto& a = in.get();
+        for (size_t i = 0; i < N; i++)
+            out.value.set(i, static_cast<U>(a.get(i)));
+        out.value.valid = a.valid;
+    }
+
+    InputPin<T, N> in;
+    OutputPin<U, N> out;
+};
+
+
+template <typename T, size_t N>
+struct ModuleIdentity : Module {
+
+    void step() {
+        out.value = in.get();
+    }
+
+    InputPin<T, N> in;
+    OutputPin<T, N> out;
+};
+
+
+// Like the scalar clamp, a lane with an invalid in is clamped as T()
+template <typename T, size_t N>
+struct ModuleClamp : Module {
+
+    void step() {
+        const auto& lo = min.get();
+        const auto& hi = max.get();
+        const auto& a = in.get();
+        for (size_t i = 0; i < N; i++) {
+            T x = a.isValid(i) ? a.value[i] : T();
+            T v = x < lo.value[i] ? lo.value[i] : x;
+            out.value.value[i] = v > hi.value[i] ? hi.value[i] : v;
+        }
+        allValid<T, N>(out.value.valid, lo, hi);
+    }
+
+    InputPin<T, N> min;
+    InputPin<T, N> max;
+    InputPin<T, N> in;
+    OutputPin<T, N> out;
+};
+
+
+// ## Functions
+
+template <typename T, typename F, size_t N>
+struct ModuleFunc : Module {
+    using R = typename std::result_of<F(T, T)>::type;
+
+    void step() {
+        const auto& a = in1.get();
+        const auto& b = in2.get();
+        F f;
+        for (size_t i = 0; i < N; i++)
+            out.value.set(i, f(a.value[i], b.value[i]));
+        allValid<T, N>(out.value.valid, a, b);
+    }
+
+    InputPin<T, N> in1;
+    InputPin<T, N> in2;
+    OutputPin<R, N> out;
+};
+
+// Logic functions applied to 64 bit-sliced lanes at once
+template <typename F> struct WordFunc;
+template <> struct WordFunc<std::logical_and<bool>> {
+    uint64_t operator()(uint64_t a, uint64_t b) { return a & b; }
+};
+template <> struct WordFunc<std::logical_or<bool>> {
+    uint64_t operator()(uint64_t a, uint64_t b) { return a | b; }
+};
+template <> struct WordFunc<std::bit_xor<bool>> {
+    uint64_t operator()(uint64_t a, uint64_t b) { return a ^ b; }
+};
+template <> struct WordFunc<FuncImpl> {
+    uint64_t operator()(uint64_t a, uint64_t b) { return ~a | b; }
+};
+template <> struct WordFunc<FuncXnor> {
+    uint64_t operator()(uint64_t a, uint64_t b) { return ~(a ^ b); }
+};
+template <> struct WordFunc<FuncNand> {
+    uint64_t operator()(uint64_t a, uint64_t b) { return ~(a & b); }
+};
+template <> struct WordFunc<FuncNor> {
+    uint64_t operator()(uint64_t a, uint64_t b) { return ~(a | b); }
+};
+
+template <typename F, size_t N>
+struct ModuleFunc<bool, F, N> : Module {
+
+    void step() {
+        const auto& a = in1.get();
+        const auto& b = in2.get();
+        WordFunc<F> f;
+        for (size_t w = 0; w < Lanes<bool, N>::words; w++) {
+            out.value.value[w] = f(a.value[w], b.value[w]);
+            out.value.valid[w] = a.valid[w] & b.valid[w];
+        }
+    }
+
+    InputPin<bool, N> in1;
+    InputPin<bool, N> in2;
+    OutputPin<bool, N> out;
+};
+
+template <typename T, size_t N>
+using ModuleSum = ModuleFunc<T, std::plus<T>, N>;
+template <typename T, size_t N>
+using ModuleDiff = ModuleFunc<T, std::minus<T>, N>;
+template <typename T, size_t N>
+using ModuleMult = ModuleFunc<T, std::multiplies<T>, N>;
+
+template <size_t N>
+using ModuleLogicAnd = ModuleFunc<bool, std::logical_and<bool>, N>;
+template <size_t N>
+using ModuleLogicOr = ModuleFunc<bool, std::logical_or<bool>, N>;
+template <size_t N>
+using ModuleLogicXor = ModuleFunc<bool, std::bit_xor<bool>, N>;
+template <size_t N>
+using ModuleLogicImpl = ModuleFunc<bool, FuncImpl, N>;
+template <size_t N>
+using ModuleLogicXnor = ModuleFunc<bool, FuncXnor, N>;
+template <size_t N>
+using ModuleLogicNand = ModuleFunc<bool, FuncNand, N>;
+template <size_t N>
+using ModuleLogicNor = ModuleFunc<bool, FuncNor, N>;
+
+template <typename T, size_t N>
+using ModuleLess = ModuleFunc<T, std::less<T>, N>;
+template <typename T, size_t N>
+using ModuleLessEqual = ModuleFunc<T, std::less_equal<T>, N>;
+template <typename T, size_t N>
+using ModuleGreater = ModuleFunc<T, std::greater<T>, N>;
+template <typename T, size_t N>
+using ModuleGreaterEqual = ModuleFunc<T, std::greater_equal<T>, N>;
+template <typename T, size_t N>
+using ModuleEqual = ModuleFunc<T, std::equal_to<T>, N>;
+template <typename T, size_t N>
+using ModuleNotEqual = ModuleFunc<T, std::not_equal_to<T>, N>;
+
+
+template <typename T, size_t N>
+struct ModuleNegate : Module {
+
+    void step() {
+        const auto& a = in.get();
+        for (size_t i = 0; i < N; i++)
+            out.value.value[i] = -a.value[i];
+        out.value.valid = a.valid;
+    }
+
+    InputPin<T, N> in;
+    OutputPin<T, N> out;
+};
+
+template <size_t N>
+struct ModuleNegate<bool, N> : Module {
+
+    void step() {
+        const auto& a = in.get();
+        for (size_t w = 0; w < Lanes<bool, N>::words; w++)
+            out.value.value[w] = ~a.value[w];
+        out.value.valid = a.valid;
+    }
+
+    InputPin<bool, N> in;
+    OutputPin<bool, N> out;
+};
+
+
+// ## Output
+
+/*
+ * Table with one block of columns per lane - step, then all columns of lane 0,
+ * all columns of lane 1 and so on.
+ */
+template <typename Dialect, size_t N, typename... Columns>
+class TableWriter {
+public:
+    TableWriter(std::ostream& o, std::initializer_list<std::string> columns)
+        : _file(o)
+    {
+        assert(columns.size() == sizeof...(Columns) + 1 && "Wrong number of columns");
+        _file << Dialect::header;
+
+        auto name = columns.begin();
+        ItemWriter<Dialect, std::string>::write_item(_file, *name);
+        for (size_t lane = 0; lane < N; lane++) {
+            for (auto it = name + 1; it != columns.end(); ++it) {
+                _file << Dialect::separator;
+                ItemWriter<Dialect, std::string>::write_item(_file,
+                    *it + "[" + std::to_string(lane) + "]");
+            }
+        }
+        _file << Dialect::line_end;
+    }
+
+    void write_line(int step, const Columns&... columns) {
+        ItemWriter<Dialect, int>::write_item(_file, step);
+        for (size_t lane = 0; lane < N; lane++)
+            write(lane, columns...);
+        _file << Dialect::line_end;
+    }
+
+private:
+    void write(size_t) {}
+
+    template <typename T, typename... Args>
+    void write(size_t lane, const T& t, const Args&... args) {
+        _file << Dialect::separator;
+        ItemWriter<Dialect, Maybe<typename T::value_type>>::write_item(_file, t.lane(lane));
+        write(lane, args...);
+    }
+
+    std::ostream& _file;
+};
+
+}} //namespace cpplink::batch
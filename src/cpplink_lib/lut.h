@@ -0,0 +1,113 @@
+#pragma once
+
+#include <cmath>
+#include <algorithm>
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+#include <vector>
+
+namespace cpplink {
+
+// Functions which can be tabulated by ModuleLUT
+struct FuncSqrt { double operator()(double x) const { return std::sqrt(x); } };
+struct FuncLog  { double operator()(double x) const { return std::log(x); } };
+struct FuncExp  { double operator()(double x) const { return std::exp(x); } };
+struct FuncSin  { double operator()(double x) const { return std::sin(x); } };
+struct FuncCos  { double operator()(double x) const { return std::cos(x); } };
+struct FuncTan  { double operator()(double x) const { return std::tan(x); } };
+
+enum class Interpolation { Linear, Cubic };
+
+// Allocator of cache line aligned memory
+template <typename T>
+struct CacheAligned {
+    using value_type = T;
+    static const size_t alignment = 64;
+
+    CacheAligned() {}
+    template <typename U>
+    CacheAligned(const CacheAligned<U>&) {}
+
+    T* allocate(size_t n) {
+        void* p = nullptr;
+        if (posix_memalign(&p, alignment, n * sizeof(T)))
+            throw std::bad_alloc();
+        return static_cast<T*>(p);
+    }
+
+    void deallocate(T* p, size_t) {
+        free(p);
+    }
+
+    template <typename U>
+    bool operator==(const CacheAligned<U>&) const { return true; }
+    template <typename U>
+    bool operator!=(const CacheAligned<U>&) const { return false; }
+};
+
+/*
+ * Function F sampled in `size` (at least 2) equal intervals of [min, max].
+ * Values are interpolated linearly or by Catmull-Rom splines, which need one
+ * more sample on both sides - these are extrapolated by a parabola, so F is
+ * never evaluated outside of the range.
+ */
+template <typename F, Interpolation I>
+class LookupTable {
+public:
+    LookupTable(double min, double max, size_t size)
+        : lo(min), hi(max), scale(size / (max - min)), intervals(size), last(size - 1), table(size + 3)
+    {
+        F f;
+        for (size_t i = 0; i <= size; i++)
+            table[i + 1] = f(i == size ? max : min + i / scale);
+        table[0] = 3 * table[1] - 3 * table[2] + table[3];
+        table[size + 2] = 3 * table[size + 1] - 3 * table[size] + table[size - 1];
+    }
+
+    bool inRange(double x) const {
+        return x >= lo && x <= hi;
+    }
+
+    // x has to be in range
+    double operator()(double x) const {
+        double pos = (x - lo) * scale;
+        long i = std::min(long(pos), last); // signed conversion is a single instruction
+        double t = pos - i;
+        const double* p = table.data() + i + 1;
+
+        if (I == Interpolation::Linear)
+            return p[0] + t * (p[1] - p[0]);
+        return p[0] + 0.5 * t * (p[1] - p[-1] + t * (2 * p[-1] - 5 * p[0] + 4 * p[1] - p[2]
+            + t * (3 * (p[0] - p[1]) + p[2] - p[-1])));
+    }
+
+    bool isFinite() const {
+        for (double v : table) {
+            if (!std::isfinite(v))
+                return false;
+        }
+        return true;
+    }
+
+    // Largest difference from F at `samples` points of every interval
+    double maxError(size_t samples = 16) const {
+        F f;
+        double err = 0;
+        for (size_t i = 0; i < intervals * samples; i++) {
+            double x = lo + (hi - lo) * i / (intervals * samples);
+            err = std::max(err, std::abs((*this)(x) - f(x)));
+        }
+        return std::max(err, std::abs((*this)(hi) - f(hi)));
+    }
+
+private:
+    double lo;
+    double hi;
+    double scale;
+    size_t intervals;
+    long last;
+    std::vector<double, CacheAligned<double>> table;
+};
+
+} //namespace cpplink
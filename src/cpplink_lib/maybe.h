@@ -3,60 +3,247 @@
 
 #include <utility> //move
 #include <type_traits> //decltype
+#include <functional> //plus,minus..
+#include <cstdint> //int64_t
+#include <cstring> //memcpy
+#include <limits> //numeric_limits
 
 namespace cpplink {
 
+/*
+ * Representations of validity of a Maybe value:
+ * FlagRepr     - separate bool flag next to the value, works for any type.
+ * NanBoxRepr   - REAL only, nothing is a quiet NaN with a reserved payload.
+ *                Other NaNs remain valid values.
+ * SentinelRepr - INT only, nothing is the minimal int64_t value, which
+ *                therefore cannot be represented as a valid value.
+ * Compact representations keep the Maybe as large as the value itself.
+ */
+struct FlagRepr {};
+struct NanBoxRepr {};
+struct SentinelRepr {};
+
 template <typename T>
-struct Maybe {
+struct DefaultRepr { using type = FlagRepr; };
+
+#ifdef CPPLINK_COMPACT_MAYBE
+template <>
+struct DefaultRepr<double> { using type = NanBoxRepr; };
+
+template <>
+struct DefaultRepr<int64_t> { using type = SentinelRepr; };
+#endif // CPPLINK_COMPACT_MAYBE
+
+template <typename T, typename Repr = typename DefaultRepr<T>::type>
+struct Maybe;
+
+template <typename T>
+struct Maybe<T, FlagRepr> {
     T value;
     using value_type = T;
 
-    Maybe() : valid(false) {}
+    Maybe() : value(), valid(false) {}
     Maybe(T& val) : value(val), valid(true) {}
     Maybe(T&& val) : value(std::move(val)), valid(true) {}
 
     Maybe(const Maybe& m) : valid(m.valid) {
-        if (m.valid) {
-            value = m.value;
-        }
+        copy(m, trivial());
     }
 
     Maybe(Maybe&& m) : valid(m.valid) {
-        if (m.valid) {
-            value = std::move(m.value);
-            m.valid = false;
-        }
+        move(m, trivial());
     }
 
     Maybe& operator=(const Maybe& m) {
         valid = m.valid;
-        if (m.valid) {
-            value = m.value;
-        }
+        copy(m, trivial());
         return *this;
     }
 
     Maybe& operator=(Maybe&& m) {
         valid = m.valid;
+        move(m, trivial());
+        return *this;
+    }
+
+    bool isValid() const {
+        return valid;
+    }
+
+    // Branch-free construction, val is stored even when invalid
+    static Maybe select(bool valid, T val) {
+        Maybe m;
+        m.value = std::move(val);
+        m.valid = valid;
+        return m;
+    }
+
+private:
+    // Trivial values are always initialized and copied without branching
+    using trivial = std::integral_constant<bool, std::is_trivially_copyable<T>::value>;
+
+    void copy(const Maybe& m, std::true_type) {
+        value = m.value;
+    }
+
+    void copy(const Maybe& m, std::false_type) {
+        if (m.valid) {
+            value = m.value;
+        }
+    }
+
+    void move(Maybe& m, std::true_type) {
+        value = m.value;
+        m.valid = false;
+    }
+
+    void move(Maybe& m, std::false_type) {
         if (m.valid) {
             value = std::move(m.value);
             m.valid = false;
         }
+    }
+
+    bool valid;
+};
+
+template <>
+struct Maybe<double, NanBoxRepr> {
+    double value;
+    using value_type = double;
+
+    Maybe() : value(nothing()) {}
+    Maybe(double val) : value(val) {}
+
+    Maybe(const Maybe& m) = default;
+
+    Maybe(Maybe&& m) : value(m.value) {
+        m.value = nothing();
+    }
+
+    Maybe& operator=(const Maybe& m) = default;
+
+    Maybe& operator=(Maybe&& m) {
+        value = m.value;
+        m.value = nothing();
         return *this;
     }
 
     bool isValid() const {
-        return valid;
+        return bits(value) != bits(nothing());
+    }
+
+    static Maybe select(bool valid, double val) {
+        return Maybe(valid ? val : nothing());
     }
 
 private:
-    bool valid;
+    static double nothing() {
+        const uint64_t box = 0x7ffc0de0dead0001ull; // quiet NaN, reserved payload
+        double d;
+        std::memcpy(&d, &box, sizeof(d));
+        return d;
+    }
+
+    static uint64_t bits(double d) {
+        uint64_t b;
+        std::memcpy(&b, &d, sizeof(b));
+        return b;
+    }
 };
 
+template <>
+struct Maybe<int64_t, SentinelRepr> {
+    int64_t value;
+    using value_type = int64_t;
+
+    Maybe() : value(nothing()) {}
+    Maybe(int64_t val) : value(val) {}
+
+    Maybe(const Maybe& m) = default;
 
+    Maybe(Maybe&& m) : value(m.value) {
+        m.value = nothing();
+    }
+
+    Maybe& operator=(const Maybe& m) = default;
+
+    Maybe& operator=(Maybe&& m) {
+        value = m.value;
+        m.value = nothing();
+        return *this;
+    }
 
-template<typename T, typename F> //chaining
-typename std::result_of<F(T)>::type operator|(Maybe<T> m, F&& f) { //>>= :: (m a) -> (a -> m b) -> (m b)      ||      (m a) -> (a -> b) -> (b)
+    bool isValid() const {
+        return value != nothing();
+    }
+
+    static Maybe select(bool valid, int64_t val) {
+        int64_t mask = -int64_t(valid);
+        return Maybe((val & mask) | (nothing() & ~mask));
+    }
+
+private:
+    static int64_t nothing() {
+        return std::numeric_limits<int64_t>::min();
+    }
+};
+
+
+/*
+ * Maybes are identical when both are invalid or both hold the same bits, so
+ * e.g. 0.0 and -0.0 differ and a NaN is identical to itself.
+ */
+template <typename T>
+typename std::enable_if<std::is_arithmetic<T>::value, bool>::type
+identicalValues(const T& a, const T& b) {
+    return std::memcmp(&a, &b, sizeof(T)) == 0;
+}
+
+template <typename T>
+typename std::enable_if<!std::is_arithmetic<T>::value, bool>::type
+identicalValues(const T& a, const T& b) {
+    return a == b;
+}
+
+template <typename T, typename R>
+bool identical(const Maybe<T, R>& a, const Maybe<T, R>& b) {
+    return a.isValid() == b.isValid() && (!a.isValid() || identicalValues(a.value, b.value));
+}
+
+
+/*
+ * Total functions are defined for every value of their arguments and have no
+ * side effects. apply() evaluates them unconditionally and selects the result
+ * without branching on the validity of the arguments.
+ */
+template <typename F>
+struct is_total : std::false_type {};
+
+template <typename T> struct is_total<std::plus<T>> : std::true_type {};
+template <typename T> struct is_total<std::minus<T>> : std::true_type {};
+template <typename T> struct is_total<std::multiplies<T>> : std::true_type {};
+template <typename T> struct is_total<std::negate<T>> : std::true_type {};
+template <typename T> struct is_total<std::logical_and<T>> : std::true_type {};
+template <typename T> struct is_total<std::logical_or<T>> : std::true_type {};
+template <typename T> struct is_total<std::logical_not<T>> : std::true_type {};
+template <typename T> struct is_total<std::bit_xor<T>> : std::true_type {};
+template <typename T> struct is_total<std::less<T>> : std::true_type {};
+template <typename T> struct is_total<std::less_equal<T>> : std::true_type {};
+template <typename T> struct is_total<std::greater<T>> : std::true_type {};
+template <typename T> struct is_total<std::greater_equal<T>> : std::true_type {};
+template <typename T> struct is_total<std::equal_to<T>> : std::true_type {};
+template <typename T> struct is_total<std::not_equal_to<T>> : std::true_type {};
+
+
+// Result of apply() keeps the representation of its argument, if it has the same type
+template <typename T, typename R, typename U>
+using MaybeResult = Maybe<U, typename std::conditional<std::is_same<T, U>::value,
+    R, typename DefaultRepr<U>::type>::type>;
+
+
+template<typename T, typename R, typename F> //chaining
+typename std::result_of<F(T)>::type operator|(Maybe<T, R> m, F&& f) { //>>= :: (m a) -> (a -> m b) -> (m b)      ||      (m a) -> (a -> b) -> (b)
 
     using return_value = typename std::result_of<F(T)>::type;
 
@@ -67,30 +254,70 @@ typename std::result_of<F(T)>::type operator|(Maybe<T> m, F&& f) { //>>= :: (m a
 }
 
 
-template<typename T, typename F> // :: (m a) -> (a -> b) -> (m b)
-Maybe<typename std::result_of<F(T)>::type>
-apply(Maybe<T> m, F&& f) {
+template<typename T, typename R, typename F> // :: (m a) -> (a -> b) -> (m b)
+typename std::enable_if<!is_total<typename std::decay<F>::type>::value,
+    MaybeResult<T, R, typename std::result_of<F(T)>::type>>::type
+apply(Maybe<T, R> m, F&& f) {
 
     if (m.isValid()) {
         return (std::forward<F>(f)(m.value)); //just
     }
 
-    return Maybe<typename std::result_of<F(T)>::type>(); //nothing
+    return MaybeResult<T, R, typename std::result_of<F(T)>::type>(); //nothing
 }
 
-template<typename T, typename F> // :: (m a) -> (a -> b) -> (m b)
-Maybe<typename std::result_of<F(T,T)>::type>
-apply(Maybe<T> m, Maybe<T> n, F&& f) {
+template<typename T, typename R, typename F> // :: (m a) -> (a -> b) -> (m b)
+typename std::enable_if<!is_total<typename std::decay<F>::type>::value,
+    MaybeResult<T, R, typename std::result_of<F(T,T)>::type>>::type
+apply(Maybe<T, R> m, Maybe<T, R> n, F&& f) {
 
     if (m.isValid() && n.isValid()) {
         return (std::forward<F>(f)(m.value, n.value)); //just
     }
 
-    return Maybe<typename std::result_of<F(T,T)>::type>(); //nothing
+    return MaybeResult<T, R, typename std::result_of<F(T,T)>::type>(); //nothing
 }
 
+// Value of an argument passed to a total function. Invalid integers are
+// replaced by zero, so they cannot trigger e.g. an overflow. Floating point
+// arithmetic is safe for any value.
+template <typename T>
+typename std::enable_if<std::is_floating_point<T>::value, T>::type
+sanitize(bool, const T& t) {
+    return t;
+}
 
-} //namespace cpplink
+template <typename T>
+typename std::enable_if<std::is_integral<T>::value, T>::type
+sanitize(bool valid, const T& t) {
+    return t & -T(valid);
+}
+
+template <typename T>
+typename std::enable_if<!std::is_arithmetic<T>::value, T>::type
+sanitize(bool valid, const T& t) {
+    return valid ? t : T();
+}
+
+// Branch-free variants for total functions
+template<typename T, typename R, typename F>
+typename std::enable_if<is_total<typename std::decay<F>::type>::value,
+    MaybeResult<T, R, typename std::result_of<F(T)>::type>>::type
+apply(const Maybe<T, R>& m, F&& f) {
+    bool valid = m.isValid();
+    T a = sanitize(valid, m.value);
+    return MaybeResult<T, R, typename std::result_of<F(T)>::type>::select(valid, std::forward<F>(f)(a));
+}
 
+template<typename T, typename R, typename F>
+typename std::enable_if<is_total<typename std::decay<F>::type>::value,
+    MaybeResult<T, R, typename std::result_of<F(T,T)>::type>>::type
+apply(const Maybe<T, R>& m, const Maybe<T, R>& n, F&& f) {
+    bool valid = m.isValid() & n.isValid();
+    T a = sanitize(valid, m.value);
+    T b = sanitize(valid, n.value);
+    return MaybeResult<T, R, typename std::result_of<F(T,T)>::type>::select(valid, std::forward<F>(f)(a, b));
+}
 
 
+} //namespace cpplink
@@ -3,15 +3,18 @@
 #ifndef _CPPLINK_EMBEDDED_CODE_
     #include "maybe.h"
     #include "doubleequal.h"              
+    #include "philox.h"
+    #include "lut.h"
 #endif // !_CPPLINK_EMBEDDED_CODE_
 
 
 #include <vector>
 #include <array>
 #include <algorithm> //std::any_of
-#include <random>
-#include <ctime>
+#include <numeric> //std::accumulate
+#include <stdexcept> //std::invalid_argument
 #include <climits>
+#include <limits>
 #include <functional> //plus,minus..
 //#define _USE_MATH_DEFINES
 #include <cmath>
@@ -40,6 +43,29 @@ struct Pin {
 template <typename T>
 struct InputPin : public Pin<T> {
     using Pin<T>::operator =;
+
+    InputPin() : source(&this->value) {}
+
+    InputPin(const InputPin& p) : Pin<T>(p), source(p.isAliased() ? p.source : &this->value) {}
+
+    InputPin& operator=(const InputPin& p) {
+        this->value = p.value;
+        source = p.isAliased() ? p.source : &this->value;
+        return *this;
+    }
+
+    // Value seen by the module - own storage or an aliased slot of a net
+    const Maybe<T>& get() const { return *source; }
+    const T& getValue() const { return source->value; }
+    bool isValid() const { return source->isValid(); }
+
+    // Read values directly from the given slot instead of own storage
+    void alias(const Maybe<T>& slot) { source = &slot; }
+    void unalias() { source = &this->value; }
+    bool isAliased() const { return source != &this->value; }
+
+private:
+    const Maybe<T>* source;
 };
 
 template <typename T>
@@ -59,6 +85,11 @@ struct Net : BaseNet {
         inputs.push_back(&in);
     }
 
+    // Input pin which is never copied into, it is always aliased instead
+    void addDemandPin(InputPin<T>& in) {
+        demand.push_back(&in);
+    }
+
     void setOutputPin(OutputPin<T>& out) {
         output = &out;
     }
@@ -66,16 +97,83 @@ struct Net : BaseNet {
     void step() {
         for (auto in : this->inputs)
             in->value = output->value;
+        if (latching)
+            latched = output->value;
         //output->value = Maybe<T>(); //nothing
     }
+
+    // Propagates the value only if it is not identical to the last one
+    // propagated by this method, returns whether it was
+    bool stepChanged() {
+        if (identical(output->value, last))
+            return false;
+        last = output->value;
+        for (auto in : this->inputs)
+            in->value = last;
+        if (latching)
+            latched = last;
+        return true;
+    }
+
+    // Zero-copy wiring: input pins read the output pin directly, step() is
+    // no longer needed
+    void alias() {
+        for (auto in : this->inputs)
+            in->alias(output->value);
+        aliasDemand();
+    }
+
+    // Zero-copy wiring with one tick delay: input pins read a single latch,
+    // which is updated by latch() instead of step()
+    void aliasLatched() {
+        for (auto in : this->inputs)
+            in->alias(latched);
+        aliasDemandLatched();
+    }
+
+    // Aliasing of demand pins only, other input pins are still copied by step()
+    void aliasDemand() {
+        for (auto in : this->demand)
+            in->alias(output->value);
+    }
+
+    // As aliasDemand(), step() also updates the latch
+    void aliasDemandLatched() {
+        for (auto in : this->demand)
+            in->alias(latched);
+        latching = true;
+    }
+
+    void latch() {
+        latched = output->value;
+    }
     
     Maybe<T> getValue() {
         return output->value;
     }
 
+    // Valid and true value, a net enabling a group of modules is on
+    bool isTrue() const {
+        return output->value.isValid() && output->value.value;
+    }
+
+    // Output pin holds nothing until its module steps again
+    void reset() {
+        *output = Maybe<T>();
+    }
+
+    // Value of a driver stepped by another process, received before the net steps
+    void setValue(const Maybe<T>& m) {
+        *output = m;
+    }
+
 private:
     std::vector < InputPin<T>* > inputs;
+    std::vector < InputPin<T>* > demand;
     OutputPin<T>* output;
+    Maybe<T> latched;
+    Maybe<T> last;
+    bool latching = false;
 };
 
 
@@ -85,20 +183,35 @@ struct Module {
 
 // ## Generators
 
+/*
+ * Random modules draw from their own stream of a counter-based generator.
+ * The same seed and stream always give the same sequence, the translator
+ * assigns every module a different stream.
+ */
 template <typename T>
 struct ModuleRand : Module {
 
-    void step() {
-        using GeneratorDistribution =  
-                typename std::conditional<std::is_same<T, int64_t>::value,
-                std::uniform_int_distribution<int>,
-                std::uniform_real_distribution<double>>::type;
+    void seed(uint64_t seed, uint64_t stream) {
+        random.reset(seed, stream);
+    }
 
+    void step() {
         T min_ = min.isValid()? min.getValue() : INT_MIN;
         T max_ = max.isValid()? max.getValue() : INT_MAX;
-        GeneratorDistribution distr(min_, max_);
 
-        out = distr(gen);
+        if (max_ < min_)
+            out = Maybe<T>();
+        else
+            out = draw(min_, max_, std::is_integral<T>());
+    }
+
+    // Skips n steps with constant bounds, a real number takes one draw
+    void advance(uint64_t n) {
+        static_assert(!std::is_integral<T>::value, "Integers take a varying number of draws");
+        T min_ = min.isValid()? min.getValue() : INT_MIN;
+        T max_ = max.isValid()? max.getValue() : INT_MAX;
+        if (!(max_ < min_))
+            random.advance(n);
     }
 
     InputPin<T> min;
@@ -106,22 +219,62 @@ struct ModuleRand : Module {
     OutputPin<T> out;
 
 private:
-    std::default_random_engine gen{static_cast<unsigned long>(time(NULL))};
+    T draw(T min_, T max_, std::true_type) {
+        return T(random.uniform(int64_t(min_), int64_t(max_)));
+    }
+
+    T draw(T min_, T max_, std::false_type) {
+        return min_ + (max_ - min_) * random.uniform();
+    }
+
+    RandomStream<> random;
 };
 
 template <>
 struct ModuleRand<bool> : Module {
 
+    void seed(uint64_t seed, uint64_t stream) {
+        random.reset(seed, stream);
+    }
+
     void step() {
-        std::uniform_int_distribution<int> distr(0, 1);
+        out = bool(random.next() >> 63);
+    }
 
-        out = distr(gen);
+    void advance(uint64_t n) {
+        random.advance(n);
     }
 
     OutputPin<bool> out;
 
 private:
-    std::default_random_engine gen{static_cast<unsigned long>(time(NULL))};
+    RandomStream<> random;
+};
+
+
+struct ModuleRandNormal : Module {
+
+    void seed(uint64_t seed, uint64_t stream) {
+        random.reset(seed, stream);
+    }
+
+    void step() {
+        double mean_ = mean.isValid()? mean.getValue() : 0;
+        double stddev_ = stddev.isValid()? stddev.getValue() : 1;
+
+        out = mean_ + stddev_ * random.next();
+    }
+
+    void advance(uint64_t n) {
+        random.advance(n);
+    }
+
+    InputPin<double> mean;
+    InputPin<double> stddev;
+    OutputPin<double> out;
+
+private:
+    NormalStream<> random;
 };
 
 
@@ -133,7 +286,7 @@ struct ModuleTrigo : Module {
             x = 0;
             out = Maybe<double>();
         } else {
-            out = apply(amplitude.value, period.value,
+            out = apply(amplitude.get(), period.get(),
                               [&,this](double amp, double per){
                 double val = in.isValid()? in.getValue() : x;
                 return amp*F((2*M_PI*val)/per); });
@@ -141,6 +294,21 @@ struct ModuleTrigo : Module {
         }
     }
 
+    // Internal state for periodicity detection, the tick counter never
+    // repeats while the wave is on
+    template <typename S>
+    void state(S& snapshot) const {
+        snapshot << x;
+    }
+
+    // Skips n steps with constant amplitude and period
+    void advance(uint64_t n) {
+        if (!amplitude.isValid() || !period.isValid() || doubleEqual(period.getValue(), 0))
+            x = 0;
+        else
+            x += n;
+    }
+
     InputPin<double> amplitude;
     InputPin<double> period;
     InputPin<double> in;
@@ -154,6 +322,83 @@ using ModuleSin = ModuleTrigo<sin>;
 using ModuleCos = ModuleTrigo<cos>;
 
 
+/*
+ * Sine/cosine oscillator without a libm call in every step. While the period
+ * is constant, the unit vector (cos, sin) of the phase is rotated by a fixed
+ * angle and resynchronized from the phase every `resync` steps, which bounds
+ * the accumulated rounding error. The phase is kept in ticks within one
+ * period, so it does not lose precision in long runs. A change of the period
+ * keeps the phase and changes the frequency. Every wrap of the phase to zero
+ * resynchronizes as well, so with an integral period the whole state repeats
+ * with the period.
+ */
+template <bool Cosine>
+struct ModuleOscillator : Module {
+    static const unsigned resync = 256;
+
+    void step() {
+        if (!amplitude.isValid() || !period.isValid() || doubleEqual(period.getValue(), 0)) {
+            t = 0;
+            sinceSync = resync;
+            out = Maybe<double>();
+            return;
+        }
+
+        double per = period.getValue();
+        if (in.isValid()) {
+            double arg = (2 * M_PI * in.getValue()) / per;
+            out = amplitude.getValue() * (Cosine ? cos(arg) : sin(arg));
+            sinceSync = resync;
+        } else {
+            if (per != lastPeriod) {
+                t = fmod(t / lastPeriod * per, per);
+                if (t < 0)
+                    t += std::abs(per);
+                lastPeriod = per;
+                rc = cos(2 * M_PI / per);
+                rs = sin(2 * M_PI / per);
+                sinceSync = resync;
+            }
+            if (sinceSync == resync || t == 0) {
+                c = cos(2 * M_PI * t / per);
+                s = sin(2 * M_PI * t / per);
+                sinceSync = 0;
+            }
+            out = amplitude.getValue() * (Cosine ? c : s);
+
+            double next = c * rc - s * rs;
+            s = s * rc + c * rs;
+            c = next;
+            sinceSync++;
+        }
+
+        t += 1;
+        if (t >= std::abs(per))
+            t -= std::abs(per);
+    }
+
+    template <typename S>
+    void state(S& snapshot) const {
+        snapshot << t << lastPeriod << c << s << rc << rs << uint64_t(sinceSync);
+    }
+
+    InputPin<double> amplitude;
+    InputPin<double> period;
+    InputPin<double> in;
+    OutputPin<double> out;
+
+private:
+    double t = 0;                // phase in ticks, within [0, |period|)
+    double lastPeriod = 1;
+    double c = 1, s = 0;         // unit vector of the phase
+    double rc = 1, rs = 0;       // rotation by one tick
+    unsigned sinceSync = resync;
+};
+
+using ModuleSinOsc = ModuleOscillator<false>;
+using ModuleCosOsc = ModuleOscillator<true>;
+
+
 struct ModuleTan : Module {
 
     void step() {
@@ -161,13 +406,21 @@ struct ModuleTan : Module {
             x = 0;
             out = Maybe<double>();
         } else {
-            out = period.value | [&,this](double per) -> Maybe<double> {
+            out = period.get() | [&,this](double per) -> Maybe<double> {
                     if (doubleEqual(cos(x*M_PI/per),0)) return Maybe<double>();
                         else return tan(x*(M_PI/per)); };
             x++;
         }
     }
 
+    // Skips n steps with a constant period
+    void advance(uint64_t n) {
+        if (!period.isValid() || doubleEqual(period.getValue(),0))
+            x = 0;
+        else
+            x += n;
+    }
+
     InputPin<double> period;
     OutputPin<double> out;
 
@@ -198,6 +451,21 @@ struct ModuleSaw : Module {
             out = -amplitude.getValue() + (phase - 3 * q_period) / q_period * amplitude.getValue();
         }
     }
+
+    template <typename S>
+    void state(S& snapshot) const {
+        snapshot << phase;
+    }
+
+    // Skips n steps with constant inputs, the phase is exact for a period
+    // of a positive whole number of ticks
+    void advance(uint64_t n) {
+        if (!period.isValid() || doubleEqual(period.getValue(), 0) || !amplitude.isValid())
+            phase = 0;
+        else if (n)
+            phase = std::fmod(phase + double(n - 1), period.getValue()) + 1;
+    }
+
     InputPin<double> amplitude;
     InputPin<double> period;
     OutputPin<double> out;
@@ -212,6 +480,15 @@ struct ModuleLinear : Module {
         out = x++;
     }
 
+    template <typename S>
+    void state(S& snapshot) const {
+        snapshot << x;
+    }
+
+    void advance(uint64_t n) {
+        x += n;
+    }
+
     OutputPin<int64_t> out;
 
 private:
@@ -219,13 +496,23 @@ private:
 };
 
 
+struct ModuleInstance : Module {
+
+    void step() {
+        out = int64_t(0);
+    }
+
+    OutputPin<int64_t> out;
+};
+
+
 // ## Helpers
 
 template <typename T, typename U>
 struct ModuleConvert : Module {
 
     void step() {
-        out = in.value | [](T i)-> Maybe<U>{ return static_cast<U>(i); };
+        out = in.get() | [](T i)-> Maybe<U>{ return static_cast<U>(i); };
     }
 
     InputPin<T> in;
@@ -237,7 +524,7 @@ template <typename T>
 struct ModuleIdentity : Module {
 
     void step() {
-        out.value = in.value;
+        out.value = in.get();
     }
 
     InputPin<T> in;
@@ -248,11 +535,12 @@ struct ModuleIdentity : Module {
 template <typename T>
 struct ModuleClamp : Module {
 
+    // An invalid input is clamped as T(), whatever its representation stores
     void step() {
-        out = apply(min.value, max.value, [&,this](T min, T max) ->T {
-            T in_ = in.getValue();
-            in_ = in_ < min ? min : in_;
-            return in_ > max ? max : in_;
+        T in_ = in.isValid() ? in.getValue() : T();
+        out = apply(min.get(), max.get(), [in_](T min, T max) ->T {
+            T v = in_ < min ? min : in_;
+            return v > max ? max : v;
         });
     }
 
@@ -269,7 +557,7 @@ template <typename T, typename F>
 struct ModuleFunc : Module {
 
     void step() {
-        out = apply(in1.value, in2.value, F());
+        out = apply(in1.get(), in2.get(), F());
     }
 
     InputPin<T> in1;
@@ -301,7 +589,7 @@ struct ModuleFuncThrows : Module {
         };
 
     void step() {
-        out = apply(in1.value, in2.value, func);
+        out = apply(in1.get(), in2.get(), func);
     }
 
     InputPin<T> in1;
@@ -329,6 +617,7 @@ struct FuncImpl {
         return !(a && !b);
     }
 };
+template <> struct is_total<FuncImpl> : std::true_type {};
 using ModuleLogicImpl = ModuleFunc<bool, FuncImpl>;
 
 
@@ -338,6 +627,7 @@ struct FuncXnor {
         return (a == b);
     }
 };
+template <> struct is_total<FuncXnor> : std::true_type {};
 using ModuleLogicXnor = ModuleFunc<bool, FuncXnor>;
 
 
@@ -347,6 +637,7 @@ struct FuncNand {
         return (!a || !b);
     }
 };
+template <> struct is_total<FuncNand> : std::true_type {};
 using ModuleLogicNand = ModuleFunc<bool, FuncNand>;
 
 
@@ -356,6 +647,7 @@ struct FuncNor {
         return (!a && !b);
     }
 };
+template <> struct is_total<FuncNor> : std::true_type {};
 using ModuleLogicNor = ModuleFunc<bool, FuncNor>;
 
 
@@ -393,7 +685,7 @@ struct ModuleInverse : Module {
         };
 
     void step() {
-        out = apply(in.value, func);
+        out = apply(in.get(), func);
     }
 
     InputPin<T> in;
@@ -404,7 +696,7 @@ template <typename T>
 struct ModuleNegate : Module {
 
     void step() {
-        out = apply(in.value, [](T t)->T{ return -t; });
+        out = apply(in.get(), std::negate<T>());
     }
 
     InputPin<T> in;
@@ -415,7 +707,7 @@ template <>
 struct ModuleNegate<bool> : Module{
 
     void step() {
-        out = apply(in.value, [](bool b)->bool{ return !b; });
+        out = apply(in.get(), std::logical_not<bool>());
     }
 
     InputPin<bool> in;
@@ -425,9 +717,9 @@ struct ModuleNegate<bool> : Module{
 struct ModuleLog : Module {
 
     void step() {
-        out = apply(in.value, base.value, [](double val, double base)
+        out = apply(in.get(), base.get(), [](double val, double base)
                     ->double{ return log(val)/log(base); });
-        if (std::isnan(out.getValue())) out = Maybe<double>();
+        if (out.isValid() && std::isnan(out.getValue())) out = Maybe<double>();
     }
 
     InputPin<double> base;
@@ -438,7 +730,7 @@ struct ModuleLog : Module {
 struct ModulePow : Module {
 
     void step() {
-        out = apply(base.value, exp.value, [](double b, double e)
+        out = apply(base.get(), exp.get(), [](double b, double e)
                     ->double{ return pow(b,e); });
     }
 
@@ -450,19 +742,46 @@ struct ModulePow : Module {
 struct ModuleSqrt : Module {
 
     void step() {
-        out = apply(in.value, [](double d)
+        out = apply(in.get(), [](double d)
                     ->double{ return sqrt(d); });
-        if (std::isnan(out.getValue())) out = Maybe<double>();
+        if (out.isValid() && std::isnan(out.getValue())) out = Maybe<double>();
+    }
+
+    InputPin<double> in;
+    OutputPin<double> out;
+};
+
+/*
+ * Function F tabulated in N intervals of [min, max]. Inputs out of the range
+ * are computed by F directly.
+ */
+template <typename F, size_t N, Interpolation I = Interpolation::Linear>
+struct ModuleLUT : Module {
+    static_assert(N >= 2, "Too small table");
+
+    ModuleLUT(double min, double max) : table(min, max, N) {}
+
+    void step() {
+        out = apply(in.get(), [this](double x)
+                    ->double{ return table.inRange(x) ? table(x) : F()(x); });
+        if (out.isValid() && !std::isfinite(out.getValue())) out = Maybe<double>();
     }
 
     InputPin<double> in;
     OutputPin<double> out;
+
+private:
+    LookupTable<F, I> table;
 };
 
+template <typename F, size_t N>
+using ModuleLUTCubic = ModuleLUT<F, N, Interpolation::Cubic>;
+
+
 struct ModuleSignum : Module {
 
     void step() {
-        out = apply(in.value, [](double d) ->int64_t{
+        out = apply(in.get(), [](double d) ->int64_t{
             if (doubleEqual(d,0)) return 0;
             if (d<0) return -1;
             return 1;});
@@ -473,37 +792,92 @@ struct ModuleSignum : Module {
 };
 
 
-struct ModuleAvg : Module {
+/*
+ * Average of the last N samples. The window is a ring buffer with a running
+ * compensated sum of valid samples and a count of invalid ones, so a step
+ * takes constant time regardless of N. Infinite and NaN samples are counted
+ * apart from the sum, the average is infinite or NaN only while they are in
+ * the window, as a sum of the window would be. The running sum is not
+ * bit-identical to summing the window in every step, it stays within 1e-9 of
+ * it for samples up to 1000 in magnitude. The window lives on the heap, so
+ * large N do not grow the stack of the simulation.
+ */
+template <size_t N>
+struct ModuleMovingAvg : Module {
+    static_assert(N > 0, "Empty window");
 
     void step() {
-
-        if (avgs.size()==10) avgs.erase(avgs.begin());
-        avgs.push_back(in.value);
-
-        if ( avgs.size() == 0 || std::any_of(avgs.begin(), avgs.end(), [](Maybe<double> d){ return !d.isValid(); }) )
+        Maybe<double>& oldest = window[pos];
+        if (filled == N)
+            remove(oldest);
+        else
+            filled++;
+
+        oldest = in.get();
+        if (!oldest.isValid())
+            invalid++;
+        else if (std::isfinite(oldest.value))
+            add(oldest.value);
+        else
+            nonFinite(oldest.value)++;
+        pos = pos + 1 == N ? 0 : pos + 1;
+
+        if (invalid)
             out = Maybe<double>();
-        else {
-            auto sum = std::accumulate(avgs.begin(), avgs.end(), Maybe<double>(0),
-                            [](Maybe<double>& m, Maybe<double>& n) {
-                                return apply(m, n, std::plus<double>()); } );
-            out = sum.value / avgs.size();
-        }
-
+        else if (nans || (infs && negativeInfs))
+            out = std::numeric_limits<double>::quiet_NaN();
+        else if (infs || negativeInfs)
+            out = infs ? std::numeric_limits<double>::infinity() : -std::numeric_limits<double>::infinity();
+        else
+            out = sum / filled;
     }
 
     InputPin<double> in;
     OutputPin<double> out;
 private:
-    std::vector<Maybe<double>> avgs;
+    void remove(const Maybe<double>& m) {
+        if (!m.isValid())
+            invalid--;
+        else if (std::isfinite(m.value))
+            add(-m.value);
+        else
+            nonFinite(m.value)--;
+    }
+
+    // Infinite and NaN samples are counted, they would spoil the running sum
+    // for good once they leave the window
+    size_t& nonFinite(double x) {
+        return std::isnan(x) ? nans : x > 0 ? infs : negativeInfs;
+    }
+
+    // Kahan summation
+    void add(double x) {
+        double y = x - compensation;
+        double t = sum + y;
+        compensation = (t - sum) - y;
+        sum = t;
+    }
+
+    std::vector<Maybe<double>> window = std::vector<Maybe<double>>(N);
+    size_t pos = 0;
+    size_t filled = 0;
+    size_t invalid = 0;
+    size_t nans = 0;
+    size_t infs = 0;
+    size_t negativeInfs = 0;
+    double sum = 0;
+    double compensation = 0;
 };
 
+using ModuleAvg = ModuleMovingAvg<10>;
 
-template <typename T>
-struct ModuleMultiplexor : Module {
+
+template <typename T, size_t N>
+struct ModuleMux : Module {
 
     void step() {
-        if (state.isValid() && inRange(state.getValue())) {
-            out = vals[state.getValue()].value;
+        if (state.isValid() && uint64_t(state.getValue()) < N) {
+            out = vals[state.getValue()].get();
         } else {
             out = Maybe<T>();
         }
@@ -511,14 +885,19 @@ struct ModuleMultiplexor : Module {
 
     InputPin<int64_t> state;
     OutputPin<T> out;
-    std::array<InputPin<T>, 32> vals;
-
-private:
-    bool inRange(int64_t i) {
-        return i < 32 && i >= 0;
-    }
+    std::array<InputPin<T>, N> vals;
 };
 
+/*
+ * The same module, the translator wires its vals through demand pins - they
+ * read the nets directly, so unselected values are never copied.
+ */
+template <typename T, size_t N>
+using ModuleMuxDemand = ModuleMux<T, N>;
+
+template <typename T>
+using ModuleMultiplexor = ModuleMux<T, 32>;
+
 
 } //namespace cpplink
 
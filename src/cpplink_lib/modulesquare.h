@@ -1,7 +1,8 @@
 #pragma once
 
 #ifndef _CPPLINK_EMBEDDED_CODE_
-    #include "modules.h"      
+    #include "modules.h"
+    #include "composite.h"
 #endif // !_CPPLINK_EMBEDDED_CODE_
 
 /*
@@ -15,49 +16,32 @@
 
 namespace cpplink {
 
-struct ModuleSquare : Module {
-    
-    ModuleSquare() { //wiring
-            n1.addInputPin(&sig.in);
-            n1.setOutputPin(&sin.out);
-            n2.addInputPin(&mu.in1);
-            n2.setOutputPin(&conv.out);
-            n3.addInputPin(&su.in1);
-            n3.setOutputPin(&mu.out);
-            n4.addInputPin(&conv.in);
-            n4.setOutputPin(&sig.out);
-            sin.amplitude = 1;
-            mid = 0;
-    }
+namespace square {
+    using Sin  = ModuleSin;
+    using Sgn  = ModuleSignum;
+    using Conv = ModuleConvert<int64_t, double>;
+    using Mult = ModuleMult<double>;
+    using Sum  = ModuleSum<double>;
+
+    using Modules = std::tuple<Sin, Sgn, Conv, Mult, Sum>;
+    using Base = Composite<Modules,
+        Wire<0, CPPLINK_PIN(&Sin::out),  1, CPPLINK_PIN(&Sgn::in)>,   // Sin -> Sgn
+        Wire<1, CPPLINK_PIN(&Sgn::out),  2, CPPLINK_PIN(&Conv::in)>,  // Sgn -> Convert
+        Wire<2, CPPLINK_PIN(&Conv::out), 3, CPPLINK_PIN(&Mult::in1)>, // Convert -> Mult
+        Wire<3, CPPLINK_PIN(&Mult::out), 4, CPPLINK_PIN(&Sum::in1)>>; // Mult -> Sum
+}
 
-    void step() {
-        for(unsigned i=0; i<modules.size(); i++) {
-            modules[i]->step();
-            for(auto n: nets) {
-                n->step();
-            }
-        }
+struct ModuleSquare : square::Base {
+
+    ModuleSquare() {
+            std::get<0>(modules).amplitude = 1;
+            mid = 0;
     }
 
-    InputPin<double>& period = sin.period;
-    InputPin<double>& ampl = mu.in2;
-    InputPin<double>& mid = su.in2;
-    OutputPin<double>& out = su.out;
-
-    std::vector<Module*> modules{&sin, &sig, &conv, &mu, &su};
-    std::vector<BaseNet*> nets{&n1, &n2, &n3, &n4};
-
-private:
-    ModuleSignum sig;
-    ModuleSin sin;
-    ModuleSum<double> su;
-    ModuleMult<double> mu;
-    ModuleConvert<int64_t, double> conv;
-    Net<double> n1; // Sin -> Sgn
-    Net<double> n2; // Convert -> Mult
-    Net<double> n3; // Mult -> Sum
-    Net<int64_t> n4; // Sgn -> Convert
+    InputPin<double>& period = std::get<0>(modules).period;
+    InputPin<double>& ampl = std::get<3>(modules).in2;
+    InputPin<double>& mid = std::get<4>(modules).in2;
+    OutputPin<double>& out = std::get<4>(modules).out;
 };
 
 }
-
@@ -0,0 +1,111 @@
+#pragma once
+
+#ifndef _CPPLINK_EMBEDDED_CODE_
+    #include "maybe.h"
+#endif // !_CPPLINK_EMBEDDED_CODE_
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <tuple>
+#include <vector>
+
+/*
+ * Detection of a periodic state of a deterministic simulation. The state of
+ * all modules is written into a snapshot after every tick, once it equals an
+ * earlier one the simulation would only repeat itself and the watched values
+ * of the period can be replayed instead.
+ */
+
+namespace cpplink {
+
+/*
+ * Logical state of the system - values of pins and internal state of modules
+ * as a sequence of words with a running hash. Invalid values are stored
+ * without their payload, so two snapshots are equal exactly when the system
+ * behaves the same from then on.
+ */
+class StateSnapshot {
+public:
+    void clear() {
+        words.clear();
+        hash = 0;
+    }
+
+    StateSnapshot& operator<<(uint64_t w) {
+        words.push_back(w);
+        hash = (hash ^ w) * 0x100000001b3ull;
+        hash ^= hash >> 29;
+        return *this;
+    }
+
+    StateSnapshot& operator<<(int64_t i) { return *this << uint64_t(i); }
+    StateSnapshot& operator<<(bool b) { return *this << uint64_t(b); }
+
+    StateSnapshot& operator<<(double d) {
+        uint64_t w;
+        std::memcpy(&w, &d, sizeof(w));
+        return *this << w;
+    }
+
+    template <typename T>
+    StateSnapshot& operator<<(const Maybe<T>& m) {
+        if (!m.isValid())
+            return *this << uint64_t(0);
+        return *this << uint64_t(1) << T(m.value);
+    }
+
+    bool operator==(const StateSnapshot& s) const {
+        return hash == s.hash && words == s.words;
+    }
+
+private:
+    std::vector<uint64_t> words;
+    uint64_t hash = 0;
+};
+
+/*
+ * Brent's cycle detection over the snapshots of consecutive ticks. A single
+ * snapshot is kept and replaced after a window of ticks, which doubles up to
+ * the budget, the rows of watched values since then are recorded. Once the
+ * current snapshot equals the kept one, the rows hold a whole period. Periods
+ * longer than the budget are not found, so at most `budget` rows are kept.
+ */
+template <typename Row>
+class PeriodDetector {
+public:
+    explicit PeriodDetector(size_t budget) : budget(budget) {}
+
+    // Records the row of a tick and the snapshot after it, true once the
+    // snapshot repeats
+    bool tick(const StateSnapshot& state, const Row& row) {
+        if (!started) {
+            started = true;
+            saved = state;
+            return false;
+        }
+        rows.push_back(row);
+        if (state == saved)
+            return true;
+        if (rows.size() == window) {
+            window = std::min(2 * window, budget);
+            saved = state;
+            rows.clear();
+        }
+        return false;
+    }
+
+    size_t period() const { return rows.size(); }
+
+    // Row of the k-th tick after the one which closed the period
+    const Row& replay(size_t k) const { return rows[k % rows.size()]; }
+
+private:
+    size_t budget;
+    size_t window = 1;
+    bool started = false;
+    StateSnapshot saved;
+    std::vector<Row> rows;
+};
+
+} // namespace cpplink
@@ -0,0 +1,194 @@
+#pragma once
+
+#include <array>
+#include <cmath>
+#include <cstdint>
+
+namespace cpplink {
+
+/*
+ * Philox4x32-10 counter-based generator (Salmon et al., Parallel Random
+ * Numbers: As Easy as 1, 2, 3). Every output block is a pure function of the
+ * counter and the key, so independent streams need no shared state and blocks
+ * can be generated in any order.
+ */
+struct Philox4x32 {
+    using Counter = std::array<uint32_t, 4>;
+    using Key = std::array<uint32_t, 2>;
+
+    static Counter generate(Counter c, Key k) {
+        for (int i = 0; i < 10; i++) {
+            uint64_t p0 = uint64_t(0xD2511F53) * c[0];
+            uint64_t p1 = uint64_t(0xCD9E8D57) * c[2];
+            c = {{ uint32_t(p1 >> 32) ^ c[1] ^ k[0], uint32_t(p1),
+                   uint32_t(p0 >> 32) ^ c[3] ^ k[1], uint32_t(p0) }};
+            k[0] += 0x9E3779B9;
+            k[1] += 0xBB67AE85;
+        }
+        return c;
+    }
+};
+
+/*
+ * Full product of two 64-bit numbers, returns the low half and stores the
+ * high half into hi. The portable version builds it from 32-bit halves, it
+ * is used by compilers without a 128-bit integer type.
+ */
+inline uint64_t mulhiloPortable(uint64_t a, uint64_t b, uint64_t& hi) {
+    uint64_t ll = (a & 0xFFFFFFFF) * (b & 0xFFFFFFFF);
+    uint64_t lh = (a & 0xFFFFFFFF) * (b >> 32);
+    uint64_t hl = (a >> 32) * (b & 0xFFFFFFFF);
+    uint64_t hh = (a >> 32) * (b >> 32);
+    uint64_t mid = (ll >> 32) + (lh & 0xFFFFFFFF) + (hl & 0xFFFFFFFF);
+    hi = hh + (lh >> 32) + (hl >> 32) + (mid >> 32);
+    return (mid << 32) | (ll & 0xFFFFFFFF);
+}
+
+inline uint64_t mulhilo(uint64_t a, uint64_t b, uint64_t& hi) {
+#ifdef __SIZEOF_INT128__
+    unsigned __int128 p = (unsigned __int128)a * b;
+    hi = uint64_t(p >> 64);
+    return uint64_t(p);
+#else
+    return mulhiloPortable(a, b, hi);
+#endif
+}
+
+/*
+ * Stream of random 64-bit numbers. Block n of the stream is Philox with
+ * counter (n, stream) and key seed, the stream keeps K numbers generated
+ * ahead so the generation loop runs over whole blocks.
+ */
+template <size_t K = 64>
+class RandomStream {
+    static_assert(K % 2 == 0, "Philox block holds two 64-bit numbers");
+public:
+    RandomStream(uint64_t seed = 0, uint64_t stream = 0) {
+        reset(seed, stream);
+    }
+
+    void reset(uint64_t seed, uint64_t stream) {
+        key = {{ uint32_t(seed), uint32_t(seed >> 32) }};
+        id = stream;
+        block = 0;
+        pos = K;
+    }
+
+    uint64_t next() {
+        if (pos == K)
+            refill();
+        return buffer[pos++];
+    }
+
+    // Uniform double in [0, 1)
+    double uniform() {
+        return (next() >> 11) * (1.0 / 9007199254740992.0);
+    }
+
+    // Unbiased uniform integer in [min, max] (Lemire's multiply-shift)
+    int64_t uniform(int64_t min, int64_t max) {
+        uint64_t range = uint64_t(max) - uint64_t(min) + 1;
+        if (range == 0)
+            return int64_t(next());
+        uint64_t hi;
+        uint64_t lo = mulhilo(next(), range, hi);
+        if (lo < range) {
+            uint64_t threshold = -range % range;
+            while (lo < threshold)
+                lo = mulhilo(next(), range, hi);
+        }
+        return int64_t(uint64_t(min) + hi);
+    }
+
+    // Index of the next number in the stream
+    uint64_t position() const {
+        return 2 * block + pos - K;
+    }
+
+    // Continues from the number at the given index, blocks before it are
+    // never generated
+    void seek(uint64_t index) {
+        block = index / K * (K / 2);
+        refill();
+        pos = index % K;
+    }
+
+    void advance(uint64_t n) {
+        seek(position() + n);
+    }
+
+private:
+    void refill() {
+        for (size_t b = 0; b < K / 2; b++) {
+            uint64_t n = block + b;
+            auto r = Philox4x32::generate({{ uint32_t(n), uint32_t(n >> 32),
+                uint32_t(id), uint32_t(id >> 32) }}, key);
+            buffer[2 * b] = r[0] | (uint64_t(r[1]) << 32);
+            buffer[2 * b + 1] = r[2] | (uint64_t(r[3]) << 32);
+        }
+        block += K / 2;
+        pos = 0;
+    }
+
+    std::array<uint64_t, K> buffer;
+    Philox4x32::Key key;
+    uint64_t id;
+    uint64_t block;
+    size_t pos;
+};
+
+/*
+ * Stream of standard normal numbers, K at once by the Box-Muller transform.
+ */
+template <size_t K = 64>
+class NormalStream {
+    static_assert(K % 2 == 0, "Box-Muller produces pairs");
+public:
+    NormalStream(uint64_t seed = 0, uint64_t stream = 0) : uniforms(seed, stream) {}
+
+    void reset(uint64_t seed, uint64_t stream) {
+        uniforms.reset(seed, stream);
+        pos = K;
+    }
+
+    double next() {
+        if (pos == K)
+            refill();
+        return buffer[pos++];
+    }
+
+    // Index of the next number in the stream, every K numbers come from K
+    // uniform ones
+    uint64_t position() const {
+        return uniforms.position() - K + pos;
+    }
+
+    void seek(uint64_t index) {
+        uniforms.seek(index / K * K);
+        refill();
+        pos = index % K;
+    }
+
+    void advance(uint64_t n) {
+        seek(position() + n);
+    }
+
+private:
+    void refill() {
+        for (size_t i = 0; i < K; i++)
+            buffer[i] = uniforms.uniform();
+        for (size_t i = 0; i < K; i += 2) {
+            double r = std::sqrt(-2 * std::log(1 - buffer[i])); // 1 - u is in (0, 1]
+            double phi = 2 * M_PI * buffer[i + 1];
+            buffer[i] = r * std::cos(phi);
+            buffer[i + 1] = r * std::sin(phi);
+        }
+        pos = 0;
+    }
+
+    RandomStream<K> uniforms;
+    std::array<double, K> buffer;
+    size_t pos = K;
+};
+
+} //namespace cpplink
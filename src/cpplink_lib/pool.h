@@ -0,0 +1,64 @@
+#pragma once
+
+#ifndef _CPPLINK_EMBEDDED_CODE_
+    #include "maybe.h"
+    #include "modules.h"
+#endif // !_CPPLINK_EMBEDDED_CODE_
+
+#include <array>
+#include <cstddef>
+
+namespace cpplink {
+
+/*
+ * N modules of the same type stored contiguously and stepped in a single loop.
+ * The loop calls the step of the exact type, so there is no virtual dispatch
+ * and a netlist with thousands of modules steps in as many loops as it has
+ * module types. Modules of a pool have to be independent within a tick, as
+ * they are in the phased schedule.
+ *
+ * pool[i] gives the i-th module, whose pins are wired as those of a single
+ * module.
+ */
+template <typename M, size_t N>
+struct ModulePool {
+
+    void step() {
+        for (auto& m : modules)
+            m.M::step();
+    }
+
+    M& operator[](size_t i) { return modules[i]; }
+
+    std::array<M, N> modules;
+};
+
+/*
+ * Pool of functions of two arguments holds its pins in parallel arrays and
+ * applies the function without a call per module. The values are not
+ * contiguous, each pin reads through its own source, which may alias a net.
+ * pool[i] gives references to the pins of the i-th function.
+ */
+template <typename T, typename F, size_t N>
+struct ModulePool<ModuleFunc<T, F>, N> {
+
+    struct Ref {
+        InputPin<T>& in1;
+        InputPin<T>& in2;
+        OutputPin<T>& out;
+    };
+
+    void step() {
+        F f;
+        for (size_t i = 0; i < N; i++)
+            out[i] = apply(in1[i].get(), in2[i].get(), f);
+    }
+
+    Ref operator[](size_t i) { return { in1[i], in2[i], out[i] }; }
+
+    std::array<InputPin<T>, N> in1;
+    std::array<InputPin<T>, N> in2;
+    std::array<OutputPin<T>, N> out;
+};
+
+} //namespace cpplink
@@ -0,0 +1,127 @@
+#pragma once
+
+#ifndef _CPPLINK_EMBEDDED_CODE_
+    #include "threads.h"
+#endif // !_CPPLINK_EMBEDDED_CODE_
+
+#include <cstddef>
+#include <cstdlib>
+#include <iostream>
+#include <new>
+#include <stdexcept>
+#include <vector>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+/*
+ * Partitioned simulation in several processes of one machine. Memory shared
+ * by the processes is mapped before they are forked, it holds a barrier ending
+ * every tick and a mailbox for every net crossing partitions. Everything else
+ * is private to a process, so a partition touches only its own modules.
+ */
+
+namespace cpplink {
+
+class ProcessGroup {
+public:
+    static const size_t line = 64;
+
+    ProcessGroup(size_t processes, size_t mailboxes) : processes(processes), mailboxes(mailboxes) {
+        size = line * (barrierLines + mailboxes);
+        void* p = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+        if (p == MAP_FAILED)
+            throw std::runtime_error("Cannot map memory shared by processes");
+        memory = static_cast<char*>(p);
+        barrier = new (memory) SpinBarrier(processes);
+    }
+
+    ProcessGroup(const ProcessGroup&) = delete;
+    ProcessGroup& operator=(const ProcessGroup&) = delete;
+
+    ~ProcessGroup() {
+        munmap(memory, size);
+    }
+
+    // Cache line of the next mailbox, so writers of different mailboxes do
+    // not share lines
+    void* allocate() {
+        if (used == mailboxes)
+            throw std::logic_error("More mailboxes than the process group holds");
+        return memory + line * (barrierLines + used++);
+    }
+
+    // Forks the other processes, returns the partition of the calling one,
+    // the original process is partition 0
+    size_t spawn() {
+        std::cout.flush();
+        for (size_t p = 1; p < processes; p++) {
+            pid_t pid = fork();
+            if (pid < 0)
+                throw std::runtime_error("Cannot fork a process");
+            if (pid == 0)
+                return p;
+            children.push_back(pid);
+        }
+        return 0;
+    }
+
+    // All values written before the barrier are visible to all processes after it
+    void wait() {
+        barrier->wait();
+    }
+
+    // Other processes exit without flushing buffers inherited from partition
+    // 0, which waits for them. Returns whether all of them succeeded.
+    bool finish(size_t partition) {
+        if (partition != 0)
+            _exit(0);
+        bool ok = true;
+        for (pid_t pid : children) {
+            int status;
+            if (waitpid(pid, &status, 0) != pid || !WIFEXITED(status) || WEXITSTATUS(status) != 0)
+                ok = false;
+        }
+        return ok;
+    }
+
+private:
+    static const size_t barrierLines = (sizeof(SpinBarrier) + line - 1) / line;
+
+    size_t processes;
+    size_t mailboxes;
+    size_t used = 0;
+    size_t size;
+    char* memory;
+    SpinBarrier* barrier;
+    std::vector<pid_t> children;
+};
+
+/*
+ * Value of a net crossing partitions. The driving process publishes the value
+ * for a tick before the barrier, readers take it after. Ticks alternate
+ * between two slots, so the value of the next tick does not overwrite one
+ * still being read.
+ */
+template <typename T>
+class Mailbox {
+    static_assert(2 * sizeof(Maybe<T>) <= ProcessGroup::line, "Mailbox fits a cache line");
+public:
+    explicit Mailbox(ProcessGroup& group) : slots(static_cast<Maybe<T>*>(group.allocate())) {
+        new (&slots[0]) Maybe<T>();
+        new (&slots[1]) Maybe<T>();
+    }
+
+    void publish(const Maybe<T>& m, long tick) {
+        slots[tick & 1] = m;
+    }
+
+    const Maybe<T>& read(long tick) const {
+        return slots[tick & 1];
+    }
+
+private:
+    Maybe<T>* slots;
+};
+
+} //namespace cpplink
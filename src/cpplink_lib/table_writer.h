@@ -3,6 +3,7 @@
 #include <cassert>
 #include <type_traits>
 #include <string>
+#include <vector>
 
 #ifndef _CPPLINK_EMBEDDED_CODE_
     #include "maybe.h"        
@@ -56,9 +57,9 @@ struct ItemWriter : ItemEscaper {
     }
 };
 
-template <typename Dialect, typename T>
-struct ItemWriter<Dialect, Maybe<T>>: ItemEscaper {
-    static void write_item(std::ostream& file, const Maybe<T>& t) {
+template <typename Dialect, typename T, typename R>
+struct ItemWriter<Dialect, Maybe<T, R>>: ItemEscaper {
+    static void write_item(std::ostream& file, const Maybe<T, R>& t) {
         if (!t.isValid())
             ItemWriter<Dialect, std::string>::write_item(file, "None");
         else
@@ -120,4 +121,39 @@ private:
     std::ostream& _file;
 };
 
+/*
+ * Table whose columns are known only at runtime, items of a line are written
+ * one by one in the same format as TableWriter writes them.
+ */
+template <typename Dialect>
+class RuntimeTableWriter {
+public:
+    RuntimeTableWriter(std::ostream& o, const std::vector<std::string>& columns)
+        : _file(o)
+    {
+        _file << Dialect::header;
+        for (const std::string& name : columns)
+            *this << name;
+        end_line();
+    }
+
+    template <typename T>
+    RuntimeTableWriter& operator<<(const T& t) {
+        if (!_first)
+            _file << Dialect::separator;
+        ItemWriter<Dialect, T>::write_item(_file, t);
+        _first = false;
+        return *this;
+    }
+
+    void end_line() {
+        _file << Dialect::line_end;
+        _first = true;
+    }
+
+private:
+    std::ostream& _file;
+    bool _first = true;
+};
+
 };
@@ -0,0 +1,171 @@
+#pragma once
+
+#ifndef _CPPLINK_EMBEDDED_CODE_
+    #include "modules.h"
+#endif // !_CPPLINK_EMBEDDED_CODE_
+
+#include <atomic>
+#include <cstddef>
+#include <thread>
+#include <vector>
+
+namespace cpplink {
+
+// Busy waiting which gives up the core after a while, so an oversubscribed
+// machine still makes progress
+inline void backoff(unsigned& spins) {
+    if (spins++ < 4096) {
+#if defined(__x86_64__) || defined(__i386__)
+        __builtin_ia32_pause();
+#endif
+    }
+    else {
+        std::this_thread::yield();
+    }
+}
+
+/*
+ * Reusable barrier for a fixed number of threads. Waiting threads spin, as
+ * the phases of a tick are short.
+ */
+class SpinBarrier {
+public:
+    explicit SpinBarrier(size_t threads) : count(threads), arrived(0), generation(0) {}
+
+    SpinBarrier(const SpinBarrier&) = delete;
+    SpinBarrier& operator=(const SpinBarrier&) = delete;
+
+    size_t threads() const {
+        return count;
+    }
+
+    // Writes of every thread before the barrier are visible to all threads after it
+    void wait() {
+        unsigned gen = generation.load(std::memory_order_acquire);
+        if (arrived.fetch_add(1, std::memory_order_acq_rel) == count - 1) {
+            arrived.store(0, std::memory_order_relaxed);
+            generation.fetch_add(1, std::memory_order_release);
+            return;
+        }
+
+        unsigned spins = 0;
+        while (generation.load(std::memory_order_acquire) == gen)
+            backoff(spins);
+    }
+
+private:
+    const size_t count;
+    alignas(64) std::atomic<size_t> arrived;
+    alignas(64) std::atomic<unsigned> generation;
+};
+
+/*
+ * Persistent team of threads sharing the work of every tick. run() calls
+ * work(t) in each thread t of the team, the calling thread being thread 0,
+ * and returns once all of them are done. The work can synchronize its own
+ * phases on the same barrier.
+ */
+template <typename F>
+class ThreadTeam {
+public:
+    ThreadTeam(SpinBarrier& barrier, F& work) : barrier(barrier), work(work), stop(false) {
+        for (size_t t = 1; t < barrier.threads(); t++)
+            workers.emplace_back([this, t] { loop(t); });
+    }
+
+    ThreadTeam(const ThreadTeam&) = delete;
+    ThreadTeam& operator=(const ThreadTeam&) = delete;
+
+    ~ThreadTeam() {
+        stop.store(true, std::memory_order_relaxed);
+        barrier.wait();
+        for (auto& w : workers)
+            w.join();
+    }
+
+    void run() {
+        barrier.wait();
+        work(0);
+        barrier.wait();
+    }
+
+private:
+    void loop(size_t t) {
+        while (true) {
+            barrier.wait();
+            if (stop.load(std::memory_order_relaxed))
+                return;
+            work(t);
+            barrier.wait();
+        }
+    }
+
+    SpinBarrier& barrier;
+    F& work;
+    std::atomic<bool> stop;
+    std::vector<std::thread> workers;
+};
+
+/*
+ * Bounded lock-free queue passing values of a net from the thread of its
+ * driver to a thread of its readers, which may run a few ticks behind.
+ * Input pins wired to the channel read the value taken by the last pull().
+ */
+template <typename T>
+class Channel {
+public:
+    explicit Channel(size_t capacity) : slots(capacity + 1), head(0), tail(0), tailCache(0), headCache(0) {}
+
+    Channel(const Channel&) = delete;
+    Channel& operator=(const Channel&) = delete;
+
+    // Producer side, waits while the channel is full
+    void push(const Maybe<T>& m) {
+        size_t t = tail.load(std::memory_order_relaxed);
+        size_t next = t + 1 == slots.size() ? 0 : t + 1;
+        unsigned spins = 0;
+        while (next == headCache) {
+            headCache = head.load(std::memory_order_acquire);
+            if (next == headCache)
+                backoff(spins);
+        }
+        slots[t] = m;
+        tail.store(next, std::memory_order_release);
+    }
+
+    // Consumer side, waits while the channel is empty
+    Maybe<T> pop() {
+        size_t h = head.load(std::memory_order_relaxed);
+        unsigned spins = 0;
+        while (h == tailCache) {
+            tailCache = tail.load(std::memory_order_acquire);
+            if (h == tailCache)
+                backoff(spins);
+        }
+        Maybe<T> m = slots[h];
+        head.store(h + 1 == slots.size() ? 0 : h + 1, std::memory_order_release);
+        return m;
+    }
+
+    void pull() {
+        value = pop();
+    }
+
+    void addInputPin(InputPin<T>& in) {
+        in.alias(value);
+    }
+
+    void addDemandPin(InputPin<T>& in) {
+        in.alias(value);
+    }
+
+private:
+    std::vector<Maybe<T>> slots;
+    alignas(64) std::atomic<size_t> head;
+    alignas(64) std::atomic<size_t> tail;
+    alignas(64) size_t tailCache; // consumer's view of tail
+    Maybe<T> value;
+    alignas(64) size_t headCache; // producer's view of head
+};
+
+} //namespace cpplink
@@ -0,0 +1,630 @@
+#include "interpreter.h"
+#include "quoteunquotecompiler.h"
+#include "typechecker.h"
+#include "cpplink_lib/modules.h"
+#include "cpplink_lib/table_writer.h"
+
+#include <functional>
+
+namespace cpplink { namespace translator {
+
+using std::string;
+
+// Only random modules have a seed
+template <typename M>
+static auto seedModule(M& m, uint64_t seed, uint64_t stream, int) -> decltype(m.seed(seed, stream)) {
+    m.seed(seed, stream);
+}
+
+template <typename M>
+static void seedModule(M&, uint64_t, uint64_t, long) {}
+
+template <typename M>
+class Held : public RuntimeModule {
+public:
+    template <typename... A>
+    explicit Held(A... args) : module(args...) {}
+
+    void step() override { module.step(); }
+    void seed(uint64_t seed, uint64_t stream) override { seedModule(module, seed, stream, 0); }
+
+    M module;
+};
+
+template <typename M, typename... A>
+static M& hold(ModulePtr& owner, A... args) {
+    auto held = new Held<M>(args...);
+    owner.reset(held);
+    return held->module;
+}
+
+// ## Pins of modules by their shape
+
+struct Source {
+    template <typename M>
+    static ModulePtr make() {
+        ModulePtr p;
+        M& m = hold<M>(p);
+        p->bind("out", m.out);
+        return p;
+    }
+};
+
+struct Unary {
+    template <typename M>
+    static ModulePtr make() {
+        ModulePtr p;
+        M& m = hold<M>(p);
+        p->bind("in", m.in);
+        p->bind("out", m.out);
+        return p;
+    }
+};
+
+struct Binary {
+    template <typename M>
+    static ModulePtr make() {
+        ModulePtr p;
+        M& m = hold<M>(p);
+        p->bind("in1", m.in1);
+        p->bind("in2", m.in2);
+        p->bind("out", m.out);
+        return p;
+    }
+};
+
+struct Bounded {
+    template <typename M>
+    static ModulePtr make() {
+        ModulePtr p;
+        M& m = hold<M>(p);
+        p->bind("min", m.min);
+        p->bind("max", m.max);
+        p->bind("out", m.out);
+        return p;
+    }
+};
+
+struct Clamp {
+    template <typename M>
+    static ModulePtr make() {
+        ModulePtr p;
+        M& m = hold<M>(p);
+        p->bind("min", m.min);
+        p->bind("max", m.max);
+        p->bind("in", m.in);
+        p->bind("out", m.out);
+        return p;
+    }
+};
+
+struct Normal {
+    template <typename M>
+    static ModulePtr make() {
+        ModulePtr p;
+        M& m = hold<M>(p);
+        p->bind("mean", m.mean);
+        p->bind("stddev", m.stddev);
+        p->bind("out", m.out);
+        return p;
+    }
+};
+
+struct Wave {
+    template <typename M>
+    static ModulePtr make() {
+        ModulePtr p;
+        M& m = hold<M>(p);
+        p->bind("amplitude", m.amplitude);
+        p->bind("period", m.period);
+        p->bind("out", m.out);
+        return p;
+    }
+};
+
+struct Tan {
+    template <typename M>
+    static ModulePtr make() {
+        ModulePtr p;
+        M& m = hold<M>(p);
+        p->bind("period", m.period);
+        p->bind("out", m.out);
+        return p;
+    }
+};
+
+struct Log {
+    template <typename M>
+    static ModulePtr make() {
+        ModulePtr p;
+        M& m = hold<M>(p);
+        p->bind("base", m.base);
+        p->bind("in", m.in);
+        p->bind("out", m.out);
+        return p;
+    }
+};
+
+struct Pow {
+    template <typename M>
+    static ModulePtr make() {
+        ModulePtr p;
+        M& m = hold<M>(p);
+        p->bind("base", m.base);
+        p->bind("exp", m.exp);
+        p->bind("out", m.out);
+        return p;
+    }
+};
+
+template <typename T>
+struct MakeMux {
+    template <size_t N>
+    static ModulePtr make() {
+        ModulePtr p;
+        auto& m = hold<ModuleMux<T, N>>(p);
+        p->bind("state", m.state);
+        p->bind("out", m.out);
+        for (size_t i = 0; i < N; i++)
+            p->bind("vals[" + std::to_string(i) + "]", m.vals[i]);
+        return p;
+    }
+};
+
+struct MakeMovingAvg {
+    template <size_t N>
+    static ModulePtr make() {
+        return Unary::make<ModuleMovingAvg<N>>();
+    }
+};
+
+template <typename F, Interpolation I>
+struct MakeLUT {
+    template <size_t N>
+    static ModulePtr make(double min, double max) {
+        ModulePtr p;
+        auto& m = hold<ModuleLUT<F, N, I>>(p, min, max);
+        p->bind("in", m.in);
+        p->bind("out", m.out);
+        return p;
+    }
+};
+
+// ## Template arguments known only at runtime
+
+template <typename Shape, typename M>
+static ModulePtr plain(const ModuleDeclaration&) {
+    return Shape::template make<M>();
+}
+
+template <typename Shape, template <typename> class M>
+static ModulePtr numeric(const ModuleDeclaration& d) {
+    if (d.template_args[0] == "INT")
+        return Shape::template make<M<int64_t>>();
+    return Shape::template make<M<double>>();
+}
+
+template <typename Shape, template <typename> class M>
+static ModulePtr anyType(const ModuleDeclaration& d) {
+    if (d.template_args[0] == "BOOL")
+        return Shape::template make<M<bool>>();
+    return numeric<Shape, M>(d);
+}
+
+/*
+ * Sizes given by template arguments are instantiated in advance, either all
+ * sizes of a range or only the listed ones. Other sizes give no module.
+ */
+template <typename Make, size_t From, size_t To>
+struct SizeRange {
+    template <typename... A>
+    static ModulePtr make(size_t n, A... args) {
+        const size_t middle = (From + To) / 2;
+        if (n < From || n > To)
+            return nullptr;
+        if (n <= middle)
+            return SizeRange<Make, From, middle>::make(n, args...);
+        return SizeRange<Make, middle + 1, To>::make(n, args...);
+    }
+};
+
+template <typename Make, size_t N>
+struct SizeRange<Make, N, N> {
+    template <typename... A>
+    static ModulePtr make(size_t n, A... args) {
+        return n == N ? Make::template make<N>(args...) : nullptr;
+    }
+};
+
+template <typename Make, size_t... N>
+struct SizeList;
+
+template <typename Make>
+struct SizeList<Make> {
+    template <typename... A>
+    static ModulePtr make(size_t, A...) {
+        return nullptr;
+    }
+};
+
+template <typename Make, size_t N, size_t... Tail>
+struct SizeList<Make, N, Tail...> {
+    template <typename... A>
+    static ModulePtr make(size_t n, A... args) {
+        return n == N ? Make::template make<N>(args...) : SizeList<Make, Tail...>::make(n, args...);
+    }
+};
+
+const size_t maxMuxWidth = 32;
+const size_t maxAvgWindow = 64;
+
+template <typename Make>
+using LutSizes = SizeList<Make, 2, 4, 8, 10, 16, 32, 64, 100, 128, 256, 512, 1000, 1024, 2048, 4096,
+    8192, 10000, 16384, 32768, 65536, 100000>;
+
+static ModulePtr randomModule(const ModuleDeclaration& d) {
+    if (d.template_args[0] == "BOOL")
+        return Source::make<ModuleRand<bool>>();
+    return numeric<Bounded, ModuleRand>(d);
+}
+
+// Remainder is defined only for integers, the translated code of ModuleMod<REAL>
+// does not compile either
+static ModulePtr mod(const ModuleDeclaration& d) {
+    if (d.template_args[0] == "INT")
+        return Binary::make<ModuleMod<int64_t>>();
+    return nullptr;
+}
+
+static ModulePtr convert(const ModuleDeclaration& d) {
+    bool fromInt = d.template_args[0] == "INT";
+    bool toInt = d.template_args[1] == "INT";
+    if (fromInt)
+        return toInt ? Unary::make<ModuleConvert<int64_t, int64_t>>() : Unary::make<ModuleConvert<int64_t, double>>();
+    return toInt ? Unary::make<ModuleConvert<double, int64_t>>() : Unary::make<ModuleConvert<double, double>>();
+}
+
+static ModulePtr mux(const ModuleDeclaration& d) {
+    size_t width = std::stoul(d.template_args[1]);
+    if (d.template_args[0] == "INT")
+        return SizeRange<MakeMux<int64_t>, 1, maxMuxWidth>::make(width);
+    if (d.template_args[0] == "REAL")
+        return SizeRange<MakeMux<double>, 1, maxMuxWidth>::make(width);
+    return SizeRange<MakeMux<bool>, 1, maxMuxWidth>::make(width);
+}
+
+static ModulePtr movingAvg(const ModuleDeclaration& d) {
+    return SizeRange<MakeMovingAvg, 1, maxAvgWindow>::make(std::stoul(d.template_args[0]));
+}
+
+// Bounds are passed to the constructor as in the translated code
+template <Interpolation I>
+static ModulePtr lut(const ModuleDeclaration& d) {
+    const string& f = d.template_args[0];
+    double min = std::stod(d.template_args[1]);
+    double max = std::stod(d.template_args[2]);
+    size_t size = std::stoul(d.template_args[3]);
+    if (f == "SQRT")
+        return LutSizes<MakeLUT<FuncSqrt, I>>::make(size, min, max);
+    if (f == "LOG")
+        return LutSizes<MakeLUT<FuncLog, I>>::make(size, min, max);
+    if (f == "EXP")
+        return LutSizes<MakeLUT<FuncExp, I>>::make(size, min, max);
+    if (f == "SIN")
+        return LutSizes<MakeLUT<FuncSin, I>>::make(size, min, max);
+    if (f == "COS")
+        return LutSizes<MakeLUT<FuncCos, I>>::make(size, min, max);
+    return LutSizes<MakeLUT<FuncTan, I>>::make(size, min, max);
+}
+
+/*
+ * Module type -> factory creating the module for its template arguments,
+ * checked by the type checker. Relational modules are missing, their output
+ * pin has the type of their inputs, so they cannot be built from modules.h.
+ */
+using Factory = ModulePtr (*)(const ModuleDeclaration&);
+
+static const std::map<string, Factory> factories{
+    {"ModuleRand", &randomModule},
+    {"ModuleRandNormal", &plain<Normal, ModuleRandNormal>},
+    {"ModuleSin", &plain<Wave, ModuleSin>},
+    {"ModuleCos", &plain<Wave, ModuleCos>},
+    {"ModuleSinOsc", &plain<Wave, ModuleSinOsc>},
+    {"ModuleCosOsc", &plain<Wave, ModuleCosOsc>},
+    {"ModuleSaw", &plain<Wave, ModuleSaw>},
+    {"ModuleTan", &plain<Tan, ModuleTan>},
+    {"ModuleLinear", &plain<Source, ModuleLinear>},
+    {"ModuleInstance", &plain<Source, ModuleInstance>},
+    {"ModuleConvert", &convert},
+    {"ModuleIdentity", &anyType<Unary, ModuleIdentity>},
+    {"ModuleClamp", &numeric<Clamp, ModuleClamp>},
+    {"ModuleSum", &numeric<Binary, ModuleSum>},
+    {"ModuleDiff", &numeric<Binary, ModuleDiff>},
+    {"ModuleMult", &numeric<Binary, ModuleMult>},
+    {"ModuleDiv", &numeric<Binary, ModuleDiv>},
+    {"ModuleMod", &mod},
+    {"ModuleLogicAnd", &plain<Binary, ModuleLogicAnd>},
+    {"ModuleLogicOr", &plain<Binary, ModuleLogicOr>},
+    {"ModuleLogicXor", &plain<Binary, ModuleLogicXor>},
+    {"ModuleLogicImpl", &plain<Binary, ModuleLogicImpl>},
+    {"ModuleLogicXnor", &plain<Binary, ModuleLogicXnor>},
+    {"ModuleLogicNand", &plain<Binary, ModuleLogicNand>},
+    {"ModuleLogicNor", &plain<Binary, ModuleLogicNor>},
+    {"ModuleInverse", &numeric<Unary, ModuleInverse>},
+    {"ModuleNegate", &anyType<Unary, ModuleNegate>},
+    {"ModuleLog", &plain<Log, ModuleLog>},
+    {"ModulePow", &plain<Pow, ModulePow>},
+    {"ModuleSqrt", &plain<Unary, ModuleSqrt>},
+    {"ModuleAvg", &plain<Unary, ModuleAvg>},
+    {"ModuleLUT", &lut<Interpolation::Linear>},
+    {"ModuleLUTCubic", &lut<Interpolation::Cubic>},
+    {"ModuleMux", &mux},
+    {"ModuleMuxDemand", &mux},
+    {"ModuleMovingAvg", &movingAvg}
+};
+
+ModulePtr createModule(const ModuleDeclaration& d) {
+    auto f = factories.find(d.type);
+    return f == factories.end() ? nullptr : f->second(d);
+}
+
+// ## Nets
+
+template <typename T>
+static bool assign(RuntimeModule& m, const string& access, const Maybe<T>& value) {
+    if (auto in = m.pin<InputPin<T>>(access)) {
+        *in = value;
+        return true;
+    }
+    if (auto out = m.pin<OutputPin<T>>(access)) {
+        *out = value;
+        return true;
+    }
+    return false;
+}
+
+// Constants are parsed from the literals written into the translated code,
+// so both use the same values
+static bool assignConstant(RuntimeModule& m, const string& access, const std::pair<DataType, string>& c) {
+    if (c.first == Int)
+        return assign(m, access, Maybe<int64_t>(int64_t(std::stoll(c.second))));
+    if (c.first == Real)
+        return assign(m, access, Maybe<double>(std::stod(c.second)));
+    return assign(m, access, Maybe<bool>(c.second == "true"));
+}
+
+class RuntimeNet {
+public:
+    explicit RuntimeNet(DataType type) : type(type) {}
+    virtual ~RuntimeNet() {}
+
+    // Connects the pin to the net, false if the pin has a different type
+    virtual bool wire(RuntimeModule& m, const string& access, bool output, bool demand) = 0;
+    virtual void aliasDemand(bool latched) = 0;
+    virtual void step() = 0;
+    virtual void reset() = 0;
+    virtual bool isTrue() const = 0;
+
+    const DataType type;
+};
+
+// Nets without a driver read a blank output pin, which never holds a value
+template <typename T>
+class TypedNet : public RuntimeNet {
+public:
+    explicit TypedNet(DataType type) : RuntimeNet(type) {
+        net.setOutputPin(blank);
+    }
+
+    bool wire(RuntimeModule& m, const string& access, bool output, bool demand) override {
+        if (output) {
+            auto out = m.pin<OutputPin<T>>(access);
+            if (out)
+                net.setOutputPin(*out);
+            return out;
+        }
+        auto in = m.pin<InputPin<T>>(access);
+        if (in && demand)
+            net.addDemandPin(*in);
+        else if (in)
+            net.addInputPin(*in);
+        return in;
+    }
+
+    void aliasDemand(bool latched) override {
+        if (latched)
+            net.aliasDemandLatched();
+        else
+            net.aliasDemand();
+    }
+
+    void step() override { net.step(); }
+    void reset() override { net.reset(); }
+    bool isTrue() const override { return net.isTrue(); }
+
+    cpplink::Net<T> net;
+
+private:
+    OutputPin<T> blank;
+};
+
+static std::unique_ptr<RuntimeNet> makeNet(DataType type) {
+    if (type == Int)
+        return std::unique_ptr<RuntimeNet>(new TypedNet<int64_t>(type));
+    if (type == Real)
+        return std::unique_ptr<RuntimeNet>(new TypedNet<double>(type));
+    return std::unique_ptr<RuntimeNet>(new TypedNet<bool>(type));
+}
+
+static string templateList(const ModuleDeclaration& d) {
+    string res;
+    for (const auto& arg : d.template_args)
+        res += (res.empty() ? "<" : ", ") + arg;
+    return res.empty() ? res : res + ">";
+}
+
+// ## Interpreter
+
+Interpreter::Interpreter(const ParsedFile& file, uint64_t seed, std::vector<ParseError>& errors)
+    : graph(file)
+{
+    // Streams of random modules are given by their positions as in the translated code
+    for (size_t i = 0; i < file.declarations.size(); i++) {
+        const auto& d = file.declarations[i];
+        ModulePtr m = createModule(d);
+        if (m)
+            m->seed(seed, i);
+        else
+            errors.push_back(ParseError(d.type + templateList(d)
+                + " is not available in the interpreter, translate the netlist instead", d.line));
+        modules.push_back(std::move(m));
+    }
+    if (!errors.empty())
+        return;
+
+    // Type of a net is given by the first pin wired to it
+    for (const auto& n : file.net_pin) {
+        size_t m = graph.index.at(n.module);
+        string access = pinAccess(graph.modules[m], n.pin);
+        Pin pin;
+        findPin(graph.modules[m], n.pin, pin);
+
+        bool wired;
+        auto c = constDeclarations.find(n.net);
+        if (c != constDeclarations.end()) {
+            wired = assignConstant(*modules[m], access, c->second);
+        } else {
+            auto& net = nets[n.net];
+            if (!net) {
+                DataType type;
+                inferPinType(graph.modules[m], n.pin, type);
+                net = makeNet(type);
+            }
+            wired = net->wire(*modules[m], access, n.is_out, pin.demand);
+        }
+        if (!wired)
+            errors.push_back(ParseError("Mismatch in pin types in net: " + n.net, n.line));
+    }
+
+    // Demand pins read values directly from nets
+    std::set<string> latched = latchedNets(graph, Schedule::TwoPhase);
+    for (const auto& net : graph.demandNets)
+        nets.at(net)->aliasDemand(latched.count(net));
+
+    for (const auto& net : nets) {
+        auto r = graph.netRate.find(net.first);
+        auto g = graph.netGroup.find(net.first);
+        netSteps.push_back({ net.second.get(), r == graph.netRate.end() ? 1 : r->second,
+            g == graph.netGroup.end() ? 0 : g->second });
+    }
+    for (size_t m : stepOrder(graph, Schedule::TwoPhase))
+        moduleSteps.push_back({ modules[m].get(), graph.rate[m], graph.group[m] });
+
+    resets.resize(file.enables.size());
+    for (size_t g = 0; g < file.enables.size(); g++) {
+        enableNets.push_back(nets.at(file.enables[g].net).get());
+        if (file.enables[g].policy != "reset")
+            continue;
+        for (size_t m = 0; m < graph.modules.size(); m++) {
+            if (graph.group[m] != g + 1)
+                continue;
+            for (const auto& net : graph.outputs[m])
+                resets[g].push_back(nets.at(net).get());
+        }
+    }
+    enabled.resize(file.enables.size());
+}
+
+Interpreter::~Interpreter() {}
+
+template <typename T>
+bool Interpreter::runs(const Guarded<T>& g, long tick) const {
+    return (g.rate == 1 || tick % long(g.rate) == 0) && (!g.group || enabled[g.group - 1]);
+}
+
+void Interpreter::step(long tick) {
+    // Enable nets are read once at the beginning of every tick, groups with
+    // the reset policy clear their outputs while disabled
+    for (size_t g = 0; g < enableNets.size(); g++) {
+        enabled[g] = enableNets[g]->isTrue();
+        if (!enabled[g]) {
+            for (RuntimeNet* net : resets[g])
+                net->reset();
+        }
+    }
+
+    for (const auto& n : netSteps) {
+        if (runs(n, tick))
+            n.item->step();
+    }
+    for (const auto& m : moduleSteps) {
+        if (runs(m, tick))
+            m.item->step();
+    }
+}
+
+template <typename Dialect, typename T>
+static std::function<void(RuntimeTableWriter<Dialect>&)> column(RuntimeNet* n) {
+    cpplink::Net<T>* net = &static_cast<TypedNet<T>*>(n)->net;
+    return [net](RuntimeTableWriter<Dialect>& table) { table << net->getValue(); };
+}
+
+template <typename Dialect, typename T>
+static std::function<void(RuntimeTableWriter<Dialect>&)> constant(const Maybe<T>& value) {
+    return [value](RuntimeTableWriter<Dialect>& table) { table << value; };
+}
+
+template <typename Dialect>
+void Interpreter::simulate(long steps, const std::vector<string>& watched, std::ostream& out) {
+    std::vector<std::function<void(RuntimeTableWriter<Dialect>&)>> columns;
+    for (const auto& name : watched) {
+        auto n = nets.find(name);
+        if (n != nets.end()) {
+            RuntimeNet* net = n->second.get();
+            if (net->type == Int)
+                columns.push_back(column<Dialect, int64_t>(net));
+            else if (net->type == Real)
+                columns.push_back(column<Dialect, double>(net));
+            else
+                columns.push_back(column<Dialect, bool>(net));
+            continue;
+        }
+
+        // Nets driven by a constant are not simulated
+        const auto& c = constDeclarations.at(name);
+        if (c.first == Int)
+            columns.push_back(constant<Dialect>(Maybe<int64_t>(int64_t(std::stoll(c.second)))));
+        else if (c.first == Real)
+            columns.push_back(constant<Dialect>(Maybe<double>(std::stod(c.second))));
+        else
+            columns.push_back(constant<Dialect>(Maybe<bool>(c.second == "true")));
+    }
+
+    std::vector<string> names{ "step" };
+    names.insert(names.end(), watched.begin(), watched.end());
+    RuntimeTableWriter<Dialect> table(out, names);
+    for (long i = 0; steps == -1 || i != steps; i++) {
+        step(i);
+        if (watched.empty())
+            continue;
+        table << int(i);
+        for (const auto& c : columns)
+            c(table);
+        table.end_line();
+    }
+}
+
+void Interpreter::run(long steps, const string& interface, const std::vector<string>& watched,
+    std::ostream& out)
+{
+    if (interface == "csv")
+        return simulate<CsvDialect>(steps, watched, out);
+    if (interface == "excel")
+        return simulate<ExcelCsvDialect>(steps, watched, out);
+    if (interface == "plain")
+        return simulate<PlainTextDialect>(steps, watched, out);
+    for (long i = 0; steps == -1 || i != steps; i++)
+        step(i);
+}
+
+}}
@@ -0,0 +1,110 @@
+#pragma once
+
+#include "translator.h"
+#include "schedule.h"
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <typeinfo>
+#include <vector>
+
+namespace cpplink { namespace translator {
+
+class RuntimeNet;
+
+/*
+ * Module of any type with its pins registered by their access paths, the
+ * same paths the translated code uses (in1, vals[2], ...).
+ */
+class RuntimeModule {
+public:
+    virtual ~RuntimeModule() {}
+    virtual void step() = 0;
+    virtual void seed(uint64_t seed, uint64_t stream) = 0;
+
+    template <typename P>
+    void bind(const std::string& access, P& pin) {
+        pins[access] = { &pin, &typeid(P) };
+    }
+
+    // Pin of the given type, null if the module has no such pin
+    template <typename P>
+    P* pin(const std::string& access) const {
+        auto p = pins.find(access);
+        if (p == pins.end() || *p->second.type != typeid(P))
+            return nullptr;
+        return static_cast<P*>(p->second.pin);
+    }
+
+private:
+    struct Bound {
+        void* pin;
+        const std::type_info* type;
+    };
+
+    std::map<std::string, Bound> pins;
+};
+
+using ModulePtr = std::unique_ptr<RuntimeModule>;
+
+/*
+ * Module of modules.h for a type checked declaration, null if the module is
+ * not available without compiling the netlist - relational modules,
+ * ModuleMod<REAL> and sizes of pin arrays, windows and tables which are not
+ * instantiated in advance.
+ */
+ModulePtr createModule(const ModuleDeclaration& d);
+
+/*
+ * Netlist simulated directly by the translator, without generating and
+ * compiling C++ code. Modules of modules.h are created through a factory keyed
+ * by the module type and its template arguments and real nets are wired to
+ * their pins at runtime. A tick is done as in the translated code with the
+ * default options - phased schedule, copy wiring, rate dividers and enable
+ * groups - so both print the same output.
+ *
+ * The netlist has to be type checked first and outlive the interpreter.
+ */
+class Interpreter {
+public:
+    // Errors of modules or wiring which the interpreter cannot build are
+    // appended to `errors`, the system must not be run then
+    Interpreter(const ParsedFile& file, uint64_t seed, std::vector<ParseError>& errors);
+    ~Interpreter();
+
+    // Does `steps` ticks, -1 for infinity, and writes the watched nets after
+    // every tick to `out` in the given interface: csv, excel, plain or silent
+    void run(long steps, const std::string& interface, const std::vector<std::string>& watched,
+        std::ostream& out);
+
+    void step(long tick);
+
+private:
+    template <typename Dialect>
+    void simulate(long steps, const std::vector<std::string>& watched, std::ostream& out);
+
+    // Step done only in ticks divisible by its rate and while its enable
+    // group is on, group 0 is always on
+    template <typename T>
+    struct Guarded {
+        T* item;
+        size_t rate;
+        size_t group;
+    };
+
+    template <typename T>
+    bool runs(const Guarded<T>& g, long tick) const;
+
+    Dataflow graph;
+    std::vector<std::unique_ptr<RuntimeModule>> modules;    // in declaration order
+    std::map<std::string, std::unique_ptr<RuntimeNet>> nets;
+    std::vector<Guarded<RuntimeNet>> netSteps;
+    std::vector<Guarded<RuntimeModule>> moduleSteps;
+    std::vector<RuntimeNet*> enableNets;                    // enable group -> net enabling it
+    std::vector<std::vector<RuntimeNet*>> resets;           // enable group -> nets reset while disabled
+    std::vector<char> enabled;
+};
+
+}}
@@ -18,6 +18,8 @@ static void yyerror(StatementUnion& u, const char *s) { u = std::string(s); }
     cpplink::translator::IoPinDeclaration*   io_pin;
     cpplink::translator::BlackboxCommand*    blackbox;
     cpplink::translator::GenericDeclaration* generic;
+    cpplink::translator::RateCommand*        rate;
+    cpplink::translator::EnableCommand*      enable;
     int                                      token;
 }
 
@@ -29,9 +31,13 @@ static void yyerror(StatementUnion& u, const char *s) { u = std::string(s); }
 %type <net_const>      net_const
 %type <token>          dir
 %type <args>           arguments
+%type <string>         argument
 %type <generic>        generic
 %type <io_pin>         io_pin
 %type <blackbox>       blackbox
+%type <rate>           rate
+%type <enable>         enable
+%type <args>           names
 
 %start statement
 
@@ -56,6 +62,8 @@ static void yyerror(StatementUnion& u, const char *s) { u = std::string(s); }
 %token <token>  TBLACKBOX "keyword 'blackbox'"
 %token <token>  TIN_WORD  "keyword 'modulein'"
 %token <token>  TOUT_WORD "keyword 'moduleout'"
+%token <token>  TRATE     "keyword 'rate'"
+%token <token>  TENABLE   "keyword 'enable'"
 
 
 %%
@@ -66,14 +74,21 @@ statement : declaration { root = StatementUnion(*$1); delete $1; }
           | generic     { root = StatementUnion(*$1); delete $1; }
           | io_pin      { root = StatementUnion(*$1); delete $1; }
           | blackbox    { root = StatementUnion(*$1); delete $1; }
+          | rate        { root = StatementUnion(*$1); delete $1; }
+          | enable      { root = StatementUnion(*$1); delete $1; }
           ;
 
 declaration : TNAME TNAME { $$ = new cpplink::translator::ModuleDeclaration{*$1, *$2, {}}; delete $1; delete $2; }
             | TNAME LPAR arguments TNAME { $$ = new cpplink::translator::ModuleDeclaration{*$1, *$4, {$3->rbegin(), $3->rend()}}; delete $1; delete $3; delete $4; }
             ;
 
-arguments : TNAME SEP arguments { $$ = $3; $$->push_back(*$1); delete $1; }
-          | TNAME RPAR { $$ = new std::vector<std::string>({ *$1 }); delete $1; }
+arguments : argument SEP arguments { $$ = $3; $$->push_back(*$1); delete $1; }
+          | argument RPAR { $$ = new std::vector<std::string>({ *$1 }); delete $1; }
+          ;
+
+argument : TNAME
+         | TINTEGER
+         | TREAL
           ;
 
 net_pin : TNET TNAME TDOT TNAME dir TNAME { $$ = new cpplink::translator::NetPinCommand{*$6, *$2, *$4, $5 == TOUT}; delete $2; delete $4; delete $6; }
@@ -94,6 +109,16 @@ io_pin  : TIN_WORD TNAME TDOT TNAME  { $$ = new cpplink::translator::IoPinDeclar
 blackbox : TBLACKBOX int_constant { $$ = new cpplink::translator::BlackboxCommand{static_cast<int32_t>($2)}; }
          ;
 
+rate : TRATE int_constant names { $$ = new cpplink::translator::RateCommand{$2, {$3->rbegin(), $3->rend()}}; delete $3; }
+     ;
+
+enable : TENABLE TNAME TNAME names { $$ = new cpplink::translator::EnableCommand{*$2, *$3, {$4->rbegin(), $4->rend()}}; delete $2; delete $3; delete $4; }
+       ;
+
+names : TNAME names { $$ = $2; $$->push_back(*$1); delete $1; }
+      | TNAME { $$ = new std::vector<std::string>({ *$1 }); delete $1; }
+      ;
+
 dir : TIN
     | TOUT
     ;
@@ -16,6 +16,8 @@ using StatementUnion = brick::types::Union<
     cpplink::translator::BlackboxCommand,
     cpplink::translator::IoPinDeclaration,
     cpplink::translator::GenericDeclaration,
+    cpplink::translator::RateCommand,
+    cpplink::translator::EnableCommand,
     std::string>;
 
 StatementUnion parse_line(const std::string& s);
@@ -4,11 +4,16 @@
 #include <sstream>
 #include <iomanip>
 #include <cassert>
+#include <stdexcept>
 #include <docopt/docopt.h>
 
 #include "quoteunquotecompiler.h"
 #include "typechecker.h"
+#include "schedule.h"
+#include "interpreter.h"
+#include "bytecode.h"
 #include <cpplink_const_lib.h>
+#include "cpplink_lib/lut.h"
 
 using std::string;
 
@@ -16,7 +21,10 @@ static const char USAGE[] =
 R"(CppLink.
 
 Usage:
-    cpplink <input_file> <output_file> --steps=<x> [--interface=<type> --watch=<list>] [--uselib]
+    cpplink run <input_file> --steps=<x> [--interface=<type> --watch=<list>] [--seed=<s>] [--lut-tolerance=<e>]
+    cpplink bytecode <input_file> <output_file> [--seed=<s>] [--lut-tolerance=<e>]
+    cpplink exec <program_file> --steps=<x> [--interface=<type> --watch=<list>]
+    cpplink <input_file> <output_file> --steps=<x> [--interface=<type> --watch=<list>] [--uselib] [--schedule=<order>] [--wiring=<mode>] [--instances=<n>] [--compact-maybe] [--seed=<s>] [--lut-tolerance=<e>] [--threads=<n>] [--pipeline=<lag>] [--events] [--lazy] [--block=<k>] [--periodic=<budget>] [--start-step=<k>] [--processes=<n>] [--pools]
     cpplink -h | --help
     cpplink --version
 
@@ -27,6 +35,21 @@ Options:
     --watch=<list>        Comma separated list with net names, which will be watched.
     --steps=<x>           Number of iterations, -1 for infinity.
     --uselib              Use #include <cpplink_lib.h> instead of embedding it.
+    --schedule=<order>    Order of steps within a tick: phased (default) or topo.
+    --wiring=<mode>       How nets pass values: copy (default) or alias.
+    --instances=<n>       Simulate n instances of the system at once.
+    --compact-maybe       Encode invalid REAL and INT values in the values themselves.
+    --seed=<s>            Seed of random modules [default: 0].
+    --lut-tolerance=<e>   Maximal allowed interpolation error of lookup tables.
+    --threads=<n>         Share every tick among n threads, phased schedule only.
+    --pipeline=<lag>      Threads run their own ticks, up to lag ticks apart.
+    --events              Step pure modules only when their inputs change.
+    --lazy                Simulate only modules influencing the watched nets.
+    --block=<k>           Process k ticks at once, topo schedule only.
+    --periodic=<budget>   Replay output once the state repeats with a period of at most budget ticks.
+    --start-step=<k>      Output from tick k on, generators jump there directly where possible.
+    --processes=<n>       Split the netlist among n processes sharing memory, phased schedule only.
+    --pools               Step modules of the same type in pools.
 )";
 
 namespace cpplink {
@@ -36,10 +59,59 @@ using namespace translator;
 std::map<string, string> _types{{"REAL", "double"}, {"INT", "int64_t"}, {"BOOL", "bool"}};
 
 
-string generateHeaders(bool embed) {
+/*
+ * Modules with a batched implementation, which can be simulated in multiple
+ * instances at once.
+ */
+std::set<string> batchedModules{"ModuleSin", "ModuleCos", "ModuleInstance",
+    "ModuleConvert", "ModuleIdentity", "ModuleClamp", "ModuleNegate",
+    "ModuleSum", "ModuleDiff", "ModuleMult",
+    "ModuleLogicAnd", "ModuleLogicOr", "ModuleLogicXor", "ModuleLogicImpl",
+    "ModuleLogicXnor", "ModuleLogicNand", "ModuleLogicNor",
+    "ModuleLess", "ModuleLessEqual", "ModuleGreater", "ModuleGreaterEqual",
+    "ModuleEqual", "ModuleNotEqual"};
+
+/*
+ * Modules with a block implementation, which can process several ticks at
+ * once.
+ */
+std::set<string> blockModules{"ModuleSin", "ModuleCos", "ModuleSaw", "ModuleLinear",
+    "ModuleConvert", "ModuleIdentity", "ModuleClamp", "ModuleNegate",
+    "ModuleSum", "ModuleDiff", "ModuleMult",
+    "ModuleLogicAnd", "ModuleLogicOr", "ModuleLogicXor", "ModuleLogicImpl",
+    "ModuleLogicXnor", "ModuleLogicNand", "ModuleLogicNor",
+    "ModuleLess", "ModuleLessEqual", "ModuleGreater", "ModuleGreaterEqual",
+    "ModuleEqual", "ModuleNotEqual"};
+
+/*
+ * Modules drawing random numbers, every one of them gets its own stream.
+ */
+std::set<string> randomModules{"ModuleRand", "ModuleRandNormal"};
+
+/*
+ * Generators providing their internal state for periodicity detection. Pure
+ * modules and ModuleInstance keep no state besides their pins.
+ */
+std::set<string> periodicModules{"ModuleSin", "ModuleCos", "ModuleSinOsc", "ModuleCosOsc",
+    "ModuleSaw", "ModuleLinear"};
+
+/*
+ * Generators which jump ahead by advance(n) while the listed input pins are
+ * constant, their state does not depend on other inputs.
+ */
+std::map<string, std::set<string>> jumpingModules{{"ModuleLinear", {}},
+    {"ModuleSin", {"amplitude", "period"}}, {"ModuleCos", {"amplitude", "period"}},
+    {"ModuleTan", {"period"}}, {"ModuleSaw", {"amplitude", "period"}},
+    {"ModuleRand", {"min", "max"}}, {"ModuleRandNormal", {}}};
+
+string generateHeaders(bool embed, const Lanes& lanes, bool compact, bool threads, bool processes,
+    bool periodic, bool pools)
+{
     std::string res;
     res += "// CppLink header begin ===========================================================\n";
     res += "#include <iostream>\n";
+    if (compact)
+        res += "#define CPPLINK_COMPACT_MAYBE\n";
     if (embed) {
         res += "#define _CPPLINK_EMBEDDED_CODE_\n";
         res += "#include <iostream>\n";
@@ -47,10 +119,34 @@ string generateHeaders(bool embed) {
         res += "\n";
         res += DOUBLEEQUAL_H;
         res += "\n";
+        res += PHILOX_H;
+        res += "\n";
+        res += LUT_H;
+        res += "\n";
         res += MODULES_H;
         res += "\n";
         res += TABLE_WRITER_H;
         res += "\n";
+        if (lanes) {
+            res += lanes.ns == "block" ? BLOCK_H : LANES_H;
+            res += "\n";
+        }
+        if (threads || processes) {
+            res += THREADS_H;
+            res += "\n";
+        }
+        if (processes) {
+            res += PROCESSES_H;
+            res += "\n";
+        }
+        if (periodic) {
+            res += PERIODIC_H;
+            res += "\n";
+        }
+        if (pools) {
+            res += POOL_H;
+            res += "\n";
+        }
     }
     else {
         res += "#include <cpplink_lib.h>\n";
@@ -73,7 +169,8 @@ string getPinType(DeclarationsMap& modules, string moduleName, string pinName) {
     std::vector<DataType> types{Int, Real, Bool};
 
     const ModuleDeclaration* m = modules[moduleName];
-    Pin pin = moduleInfo[m->type].pins[pinName];
+    Pin pin;
+    findPin(m, pinName, pin);
     DataType type = pin.type;
 
     if(std::find(types.begin(), types.end(), type) != types.end()) {
@@ -82,63 +179,1238 @@ string getPinType(DeclarationsMap& modules, string moduleName, string pinName) {
     return typeToStr[m->template_args[pin.pos - 1]];
 }
 
-string generateSystemSteps(const std::vector<ModuleDeclaration>& modules,
+string generateNetStep(const string& net, Wiring wiring, const std::set<string>& latched) {
+    if (wiring == Wiring::Copy)
+        return tabs(2) + net + ".step();\n";
+    if (latched.count(net))
+        return tabs(2) + net + ".latch();\n";
+    return ""; // readers alias the output pin
+}
+
+/*
+ * Step done only in ticks divisible by its rate and while its enable group is
+ * on, group 0 is always on.
+ */
+struct GuardedStep {
+    size_t rate;
+    size_t group;
+    string code;
+
+    bool operator<(const GuardedStep& s) const {
+        return std::make_pair(rate, group) < std::make_pair(s.rate, s.group);
+    }
+};
+
+GuardedStep guardedNetStep(const Dataflow& graph, const string& net, const string& code) {
+    auto r = graph.netRate.find(net);
+    auto g = graph.netGroup.find(net);
+    return { r == graph.netRate.end() ? 1 : r->second, g == graph.netGroup.end() ? 0 : g->second, code };
+}
+
+GuardedStep guardedModuleStep(const Dataflow& graph, size_t m) {
+    return { graph.rate[m], graph.group[m], tabs(2) + graph.modules[m]->name + ".step();\n" };
+}
+
+string stepGuard(const GuardedStep& s) {
+    string res;
+    if (s.rate != 1)
+        res = "_cpplink_i % " + std::to_string(s.rate) + " == 0";
+    if (s.group)
+        res += (res.empty() ? "" : " && ") + string("_cpplink_enable") + std::to_string(s.group - 1);
+    return res;
+}
+
+// Runs of steps with the same guard are done under a single branch, skipped
+// modules hold their outputs
+string generateGuardedSteps(const std::vector<GuardedStep>& steps) {
+    string res, open;
+    for (const auto& s : steps) {
+        if (s.code.empty())
+            continue;
+        string guard = stepGuard(s);
+        if (guard != open) {
+            if (!open.empty())
+                res += tabs(2) + "}\n";
+            if (!guard.empty())
+                res += tabs(2) + "if (" + guard + ") {\n";
+            open = guard;
+        }
+        res += (open.empty() ? "" : tabs(1)) + s.code;
+    }
+    if (!open.empty())
+        res += tabs(2) + "}\n";
+    return res;
+}
+
+// Enable nets are read once at the beginning of every tick, groups with the
+// reset policy clear their outputs while disabled
+string generateEnableFlags(const ParsedFile& file, const Dataflow& graph) {
+    string res;
+    for (size_t g = 0; g < file.enables.size(); g++) {
+        string flag = "_cpplink_enable" + std::to_string(g);
+        res += tabs(2) + "bool " + flag + " = " + file.enables[g].net + ".isTrue();\n";
+        if (file.enables[g].policy != "reset")
+            continue;
+
+        string resets;
+        for (size_t m = 0; m < graph.modules.size(); m++) {
+            if (graph.group[m] != g + 1)
+                continue;
+            for (const auto& net : graph.outputs[m])
+                resets += tabs(3) + net + ".reset();\n";
+        }
+        if (!resets.empty())
+            res += tabs(2) + "if (!" + flag + ") {\n" + resets + tabs(2) + "}\n";
+    }
+    return res.empty() ? res : tabs(2) + "// Enable groups\n" + res + "\n";
+}
+
+/*
+ * Modules of the same type, rate and enable group held in a ModulePool and
+ * stepped by a single loop. Pools step in the order their first modules
+ * have in the phased schedule, which reorders modules of different pools -
+ * every net read directly from its output pin is latched then. Modules are
+ * bound by reference to their elements, the wiring of their pins does not
+ * change.
+ *
+ * The topological schedule pools modules of the same dataflow level only,
+ * they do not read from each other within a tick. Modules of a feedback loop
+ * get a pool of their own each, so the loop keeps its order.
+ */
+struct Pools {
+    struct Pool {
+        string type;
+        size_t rate;
+        size_t group;
+        size_t level;
+        bool loop;
+        std::vector<size_t> modules;
+    };
+
+    Pools() {}
+
+    Pools(const Dataflow& graph, Schedule schedule) : poolOf(graph.modules.size()) {
+        std::vector<size_t> levels(graph.modules.size(), 0);
+        std::vector<bool> loop(graph.modules.size(), false);
+        if (schedule == Schedule::Topological) {
+            levels = dataflowLevels(graph);
+            for (const auto& component : stronglyConnectedComponents(graph))
+                for (size_t m : component)
+                    loop[m] = component.size() > 1;
+        }
+
+        std::map<std::tuple<string, size_t, size_t, size_t, size_t>, size_t> index;
+        for (size_t m : stepOrder(graph, schedule)) {
+            string type = graph.modules[m]->generateType();
+            auto key = std::make_tuple(type, graph.rate[m], graph.group[m], levels[m], loop[m] ? m + 1 : 0);
+            auto p = index.find(key);
+            if (p == index.end()) {
+                p = index.insert({ key, pools.size() }).first;
+                pools.push_back({ type, graph.rate[m], graph.group[m], levels[m], loop[m], {} });
+            }
+            pools[p->second].modules.push_back(m);
+            poolOf[m] = p->second;
+        }
+    }
+
+    static string name(size_t p) {
+        return "_cpplink_pool" + std::to_string(p);
+    }
+
+    string generateDeclarations(const Dataflow& graph) const {
+        string res = tabs(1) + "// Modules of the same type step in pools\n";
+        for (size_t p = 0; p < pools.size(); p++) {
+            const Pool& pool = pools[p];
+            string args;
+            for (size_t m : pool.modules) {
+                string a = graph.modules[m]->generateConstructorArgs();
+                if (!a.empty())
+                    args += (args.empty() ? "" : ", ") + a;
+            }
+            res += tabs(1) + "ModulePool<" + pool.type + ", " + std::to_string(pool.modules.size()) + "> "
+                + name(p) + (args.empty() ? "" : "{{{ " + args + " }}}") + ";\n";
+            for (size_t i = 0; i < pool.modules.size(); i++)
+                res += tabs(1) + "auto&& " + graph.modules[pool.modules[i]]->name + " = " + name(p)
+                    + "[" + std::to_string(i) + "];\n";
+        }
+        return res + "\n";
+    }
+
+    GuardedStep step(size_t p) const {
+        return { pools[p].rate, pools[p].group, tabs(2) + name(p) + ".step();\n" };
+    }
+
+    std::vector<GuardedStep> steps() const {
+        std::vector<GuardedStep> res;
+        for (size_t p = 0; p < pools.size(); p++)
+            res.push_back(step(p));
+        return res;
+    }
+
+    explicit operator bool() const { return !pools.empty(); }
+
+    std::vector<Pool> pools;
+    std::vector<size_t> poolOf;  // module -> its pool
+};
+
+string generatePhasedSteps(const Dataflow& graph,
     const std::map<std::string, std::string>& nets,
-    const std::vector<string>& watched_nets, long steps)
+    Wiring wiring, const std::set<string>& latched, const Pools& pools)
 {
-    std::string res;
-    if (steps == -1)
-        res += tabs(1) + "for(long _cpplink_i = 0; true ; _cpplink_i++) {\n";
-    else
-        res += tabs(1) + "for(long _cpplink_i = 0; "
-            "_cpplink_i != " + std::to_string(steps) + "; _cpplink_i++) {\n";
+    std::vector<GuardedStep> netSteps;
+    for (const auto& net : nets)
+        netSteps.push_back(guardedNetStep(graph, net.first, generateNetStep(net.first, wiring, latched)));
+    std::stable_sort(netSteps.begin(), netSteps.end());
 
+    std::string res;
     res += tabs(2) + "// Propagate values through nets\n";
-    for (const auto& net : nets)
-        res += tabs(2) + net.first + ".step();\n";
+    res += generateGuardedSteps(netSteps);
 
     res += "\n";
     res += tabs(2) + "// Do step in each module\n";
 
-    for (const auto& module : modules)
-        res += tabs(2) + module.name + ".step();\n";
+    std::vector<GuardedStep> moduleSteps = pools.steps();
+    if (!pools) {
+        for (size_t m : stepOrder(graph, Schedule::TwoPhase))
+            moduleSteps.push_back(guardedModuleStep(graph, m));
+    }
+    res += generateGuardedSteps(moduleSteps);
+    return res;
+}
+
+// Switch running the given ranges of statements in threads of a team
+string generateThreadSwitch(const std::vector<string>& statements, const std::vector<size_t>& ranges) {
+    string res = tabs(2) + "switch (_cpplink_t) {\n";
+    for (size_t t = 0; t + 1 < ranges.size(); t++) {
+        if (ranges[t] == ranges[t + 1])
+            continue;
+        res += tabs(2) + "case " + std::to_string(t) + ":\n";
+        for (size_t i = ranges[t]; i < ranges[t + 1]; i++)
+            res += statements[i];
+        res += tabs(3) + "break;\n";
+    }
+    return res + tabs(2) + "}\n";
+}
+
+/*
+ * Threads share every tick, each of them propagates a part of the nets and
+ * after a barrier steps a part of the modules. Modules read only values
+ * propagated before the barrier, so they are independent of each other.
+ */
+string generateThreadTeam(const Dataflow& graph,
+    const std::map<std::string, std::string>& nets,
+    Wiring wiring, const std::set<string>& latched, size_t threads)
+{
+    std::map<string, size_t> readers;
+    for (const auto& inputs : graph.inputs)
+        for (const auto& net : inputs)
+            readers[net]++;
+
+    std::vector<string> netSteps;
+    std::vector<double> netCosts;
+    for (const auto& net : nets) {
+        string step = generateNetStep(net.first, wiring, latched);
+        if (step.empty())
+            continue;
+        netSteps.push_back(tabs(1) + step);
+        netCosts.push_back(0.5 * (wiring == Wiring::Copy ? std::max<size_t>(readers[net.first], 1) : 1));
+    }
+
+    std::vector<string> moduleSteps;
+    std::vector<double> moduleCosts;
+    for (size_t m : stepOrder(graph, Schedule::TwoPhase)) {
+        moduleSteps.push_back(tabs(3) + graph.modules[m]->name + ".step();\n");
+        moduleCosts.push_back(stepCost(*graph.modules[m]));
+    }
+
+    string res;
+    res += tabs(1) + "// " + std::to_string(threads) + " threads share the nets and modules of every tick\n";
+    res += tabs(1) + "SpinBarrier _cpplink_barrier(" + std::to_string(threads) + ");\n";
+    res += tabs(1) + "auto _cpplink_work = [&](size_t _cpplink_t) {\n";
+    res += generateThreadSwitch(netSteps, balancedPartition(netCosts, threads));
+    res += tabs(2) + "_cpplink_barrier.wait();\n";
+    res += generateThreadSwitch(moduleSteps, balancedPartition(moduleCosts, threads));
+    res += tabs(1) + "};\n";
+    res += tabs(1) + "ThreadTeam<decltype(_cpplink_work)> _cpplink_team(_cpplink_barrier, _cpplink_work);\n\n";
+    return res;
+}
+
+/*
+ * Event-driven phased steps: pure modules step only when one of their input
+ * nets changed, nets driven by pure modules are propagated only after their
+ * driver stepped. Other modules are always active and other nets always
+ * propagated.
+ */
+struct EventFlags {
+    EventFlags(const Dataflow& graph) : dirty(graph.modules.size()) {
+        for (size_t m = 0; m < graph.modules.size(); m++) {
+            if (!moduleInfo[graph.modules[m]->type].pure)
+                continue;
+            dirty[m] = modules++;
+            for (const auto& net : graph.inputs[m])
+                pureReaders[net].insert(dirty[m]);
+        }
+        for (const auto& d : graph.driver)
+            if (moduleInfo[graph.modules[d.second]->type].pure)
+                pending[d.first] = nets++;
+    }
+
+    bool pure(const Dataflow& graph, size_t m) const {
+        return moduleInfo[graph.modules[m]->type].pure;
+    }
+
+    std::vector<size_t> dirty;                          // pure module -> its flag
+    std::map<string, size_t> pending;                   // net driven by a pure module -> its flag
+    std::map<string, std::set<size_t>> pureReaders;     // net -> flags of its pure readers
+    size_t modules = 0;
+    size_t nets = 0;
+};
+
+string generateEventSteps(const Dataflow& graph,
+    const std::map<std::string, std::string>& nets, const std::set<string>& latched)
+{
+    EventFlags flags(graph);
+
+    std::string res;
+    res += tabs(2) + "// Propagate values through nets, pure readers of changed nets become dirty\n";
+    for (const auto& net : nets) {
+        auto p = flags.pending.find(net.first);
+        string indent = p == flags.pending.end() ? "" : tabs(1);
+        if (p != flags.pending.end()) {
+            string flag = "_cpplink_pending[" + std::to_string(p->second) + "]";
+            res += tabs(2) + "if (" + flag + ") {\n";
+            res += tabs(3) + flag + " = false;\n";
+        }
+
+        auto r = flags.pureReaders.find(net.first);
+        if (r == flags.pureReaders.end()) {
+            res += indent + generateNetStep(net.first, Wiring::Copy, latched);
+        }
+        else {
+            res += indent + tabs(2) + "if (" + net.first + ".stepChanged()) {\n";
+            for (size_t d : r->second)
+                res += indent + tabs(3) + "_cpplink_dirty[" + std::to_string(d) + "] = true;\n";
+            res += indent + tabs(3) + "_cpplink_changed++;\n";
+            res += indent + tabs(2) + "}\n";
+        }
+
+        if (p != flags.pending.end())
+            res += tabs(2) + "}\n";
+    }
+
+    res += "\n";
+    res += tabs(2) + "// Do step in each active or dirty module\n";
+    for (size_t m : stepOrder(graph, Schedule::TwoPhase)) {
+        const string& name = graph.modules[m]->name;
+        if (!flags.pure(graph, m)) {
+            res += tabs(2) + name + ".step();\n";
+            continue;
+        }
+        string d = "_cpplink_dirty[" + std::to_string(flags.dirty[m]) + "]";
+        res += tabs(2) + "if (" + d + ") {\n";
+        res += tabs(3) + d + " = false;\n";
+        res += tabs(3) + name + ".step();\n";
+        for (const auto& net : graph.outputs[m])
+            res += tabs(3) + "_cpplink_pending[" + std::to_string(flags.pending[net]) + "] = true;\n";
+        res += tabs(3) + "_cpplink_stepped++;\n";
+        res += tabs(2) + "}\n";
+    }
+    return res;
+}
+
+// Flags and counters of the event-driven steps, everything is done in the first tick
+string generateEventCounters(const Dataflow& graph) {
+    EventFlags flags(graph);
+
+    string res;
+    res += tabs(1) + "std::vector<char> _cpplink_dirty(" + std::to_string(flags.modules) + ", true);\n";
+    res += tabs(1) + "std::vector<char> _cpplink_pending(" + std::to_string(flags.nets) + ", true);\n";
+    res += tabs(1) + "long _cpplink_stepped = 0;\n";
+    res += tabs(1) + "long _cpplink_changed = 0;\n\n";
+    return res;
+}
+
+// Share of modules and nets read by pure modules which did any work
+string generateUtilizationReport(const Dataflow& graph, const std::map<std::string, std::string>& nets,
+    long steps)
+{
+    EventFlags flags(graph);
+    size_t tracked = 0;
+    for (const auto& r : flags.pureReaders)
+        tracked += nets.count(r.first);
+
+    string active = std::to_string(graph.modules.size() - flags.modules) + "L * " + std::to_string(steps);
+    string modules = std::to_string(graph.modules.size()) + "L * " + std::to_string(steps);
+    string res;
+    res += "\n" + tabs(1) + "// Utilization of the event-driven schedule\n";
+    res += tabs(1) + "std::cerr << \"Module steps: \" << _cpplink_stepped + " + active
+        + " << \" of \" << " + modules + "\n";
+    res += tabs(2) + "<< \" (\" << 100.0 * (_cpplink_stepped + " + active + ") / ("
+        + modules + ") << \"%)\\n\";\n";
+    if (tracked) {
+        string total = std::to_string(tracked) + "L * " + std::to_string(steps);
+        res += tabs(1) + "std::cerr << \"Changed values of nets read by pure modules: \" << _cpplink_changed"
+            " << \" of \" << " + total + "\n";
+        res += tabs(2) + "<< \" (\" << 100.0 * _cpplink_changed / (" + total + ") << \"%)\\n\";\n";
+    }
+    return res;
+}
+
+string generateTopologicalSteps(const Dataflow& graph, Wiring wiring,
+    const std::set<string>& latched)
+{
+    std::set<string> propagated;
+
+    // Nets without any reader are not propagated at all
+    std::vector<GuardedStep> steps;
+    for (size_t m : topologicalOrder(graph)) {
+        for (const auto& net : graph.inputs[m]) {
+            if (propagated.insert(net).second)
+                steps.push_back(guardedNetStep(graph, net, generateNetStep(net, wiring, latched)));
+        }
+        steps.push_back(guardedModuleStep(graph, m));
+    }
+
+    std::string res;
+    res += tabs(2) + "// Step modules in dataflow order, each right after its input nets\n";
+    res += generateGuardedSteps(steps);
+    return res;
+}
+
+/*
+ * Topological schedule of pools. Every level of the dataflow propagates the
+ * nets first read at that level and steps its pools, every module then sees
+ * the same values as without pools. Feedback loops step module by module
+ * after the pools of their level, each net driven within a loop is
+ * propagated right before its first reader in the loop.
+ */
+string generatePooledTopologicalSteps(const Dataflow& graph, Wiring wiring,
+    const std::set<string>& latched, const Pools& pools)
+{
+    std::vector<size_t> levels = dataflowLevels(graph);
+    size_t count = 0;
+    for (size_t l : levels)
+        count = std::max(count, l + 1);
+
+    std::map<string, size_t> first;
+    for (size_t m = 0; m < graph.modules.size(); m++) {
+        for (const auto& net : graph.inputs[m]) {
+            auto it = first.insert({ net, levels[m] }).first;
+            it->second = std::min(it->second, levels[m]);
+        }
+    }
+
+    std::vector<std::vector<GuardedStep>> nets(count), steps(count), loops(count);
+    std::set<string> propagated;
+    for (const auto& component : stronglyConnectedComponents(graph)) {
+        if (!pools.pools[pools.poolOf[component.front()]].loop)
+            continue;
+        std::set<size_t> members(component.begin(), component.end());
+        auto& loop = loops[levels[component.front()]];
+        for (size_t m : component) {
+            for (const auto& net : graph.inputs[m]) {
+                auto d = graph.driver.find(net);
+                if (d != graph.driver.end() && members.count(d->second) && propagated.insert(net).second)
+                    loop.push_back(guardedNetStep(graph, net, generateNetStep(net, wiring, latched)));
+            }
+            loop.push_back(pools.step(pools.poolOf[m]));
+        }
+    }
+
+    // Nets without any reader are not propagated at all
+    for (size_t m : topologicalOrder(graph)) {
+        for (const auto& net : graph.inputs[m]) {
+            if (propagated.insert(net).second)
+                nets[first[net]].push_back(guardedNetStep(graph, net, generateNetStep(net, wiring, latched)));
+        }
+    }
+    for (size_t p = 0; p < pools.pools.size(); p++) {
+        if (!pools.pools[p].loop)
+            steps[pools.pools[p].level].push_back(pools.step(p));
+    }
+
+    std::vector<GuardedStep> res;
+    for (size_t l = 0; l < count; l++) {
+        std::stable_sort(nets[l].begin(), nets[l].end());
+        std::stable_sort(steps[l].begin(), steps[l].end());
+        res.insert(res.end(), nets[l].begin(), nets[l].end());
+        res.insert(res.end(), steps[l].begin(), steps[l].end());
+        res.insert(res.end(), loops[l].begin(), loops[l].end());
+    }
+    return tabs(2) + "// Step pools level by level of the dataflow, each right after its input nets\n"
+        + generateGuardedSteps(res);
+}
+
+string generateTickLoop(long steps, unsigned indent, long start = 0) {
+    string first = "for(long _cpplink_i = " + std::to_string(start) + "; ";
+    if (steps == -1)
+        return tabs(indent) + first + "true ; _cpplink_i++) {\n";
+    return tabs(indent) + first + "_cpplink_i != " + std::to_string(steps) + "; _cpplink_i++) {\n";
+}
+
+// Watched values come from the nets or from the given channels
+string generateTableLine(const std::vector<string>& watched_nets, const std::map<string, string>& channels,
+    const string& step = "_cpplink_i", unsigned indent = 2)
+{
+    string res;
+    res += tabs(indent) + "// Output values in this step\n";
+    res += tabs(indent) + "_cpplink_table.write_line(\n";
+    res += tabs(indent + 1) + step;
+    for (const std::string& net : watched_nets) {
+        auto c = channels.find(net);
+        res += ",\n" + tabs(indent + 1) + (c == channels.end() ? net + ".getValue()" : c->second + ".pop()");
+    }
+    res += "\n" + tabs(indent) + ");\n";
+    return res;
+}
+
+/*
+ * Periodicity detection: after every tick the values of all pins and the
+ * internal state of generators are written into a snapshot. Once it repeats,
+ * the watched values of the recorded period are replayed for the rest of the
+ * run instead of simulating it.
+ */
+string generatePeriodDetector(const std::map<std::string, std::string>& nets,
+    const std::vector<string>& watched_nets, size_t budget)
+{
+    string res = tabs(1) + "// Watched values of a period replayed once the state repeats\n";
+    res += tabs(1) + "using _cpplink_row = std::tuple<";
+    for (size_t i = 0; i < watched_nets.size(); i++)
+        res += string(i ? ", " : "") + "Maybe<" + nets.find(watched_nets[i])->second + ">";
+    res += ">;\n";
+    res += tabs(1) + "PeriodDetector<_cpplink_row> _cpplink_period(" + std::to_string(budget) + ");\n";
+    res += tabs(1) + "StateSnapshot _cpplink_state;\n\n";
+    return res;
+}
+
+string generatePeriodCheck(const ParsedFile& file, const std::vector<string>& watched_nets, long steps) {
+    string res = "\n" + tabs(2) + "// Stop simulating once the state repeats and replay the period\n";
+    res += tabs(2) + "_cpplink_state.clear();\n";
+    for (const auto& d : file.declarations) {
+        std::vector<string> pins;
+        for (const auto& p : getPins(&d)) {
+            string access = p.second.dir == Direction::In ? ".get()" : ".value";
+            if (!p.second.width) {
+                pins.push_back(p.first + access);
+                continue;
+            }
+            size_t width = std::stoul(d.template_args[p.second.width - 1]);
+            for (size_t i = 0; i < width; i++)
+                pins.push_back(p.first + "[" + std::to_string(i) + "]" + access);
+        }
+        res += tabs(2) + "_cpplink_state";
+        for (const auto& p : pins)
+            res += " << " + d.name + "." + p;
+        res += ";\n";
+        if (periodicModules.count(d.type))
+            res += tabs(2) + d.name + ".state(_cpplink_state);\n";
+    }
+
+    res += tabs(2) + "if (_cpplink_period.tick(_cpplink_state, _cpplink_row(";
+    for (size_t i = 0; i < watched_nets.size(); i++)
+        res += string(i ? ", " : "") + watched_nets[i] + ".getValue()";
+    res += "))) {\n";
+    res += tabs(3) + "std::cerr << \"Period of \" << _cpplink_period.period() << \" ticks detected, \"\n";
+    res += tabs(4) + "<< \"replaying from tick \" << _cpplink_i + 1 << \"\\n\";\n";
+    if (!watched_nets.empty()) {
+        string end = steps == -1 ? "true" : "_cpplink_i + 1 + _cpplink_k != " + std::to_string(steps);
+        res += tabs(3) + "for (long _cpplink_k = 0; " + end + "; _cpplink_k++) {\n";
+        res += tabs(4) + "const _cpplink_row& _cpplink_r = _cpplink_period.replay(_cpplink_k);\n";
+        res += tabs(4) + "_cpplink_table.write_line(_cpplink_i + 1 + _cpplink_k";
+        for (size_t i = 0; i < watched_nets.size(); i++)
+            res += ", std::get<" + std::to_string(i) + ">(_cpplink_r)";
+        res += ");\n";
+        res += tabs(3) + "}\n";
+    }
+    res += tabs(3) + "break;\n";
+    res += tabs(2) + "}\n";
+    return res;
+}
+
+/*
+ * Fast-forward to the start step. Generators with a closed-form state jump
+ * there directly and only the last `refill` ticks are simulated, which brings
+ * their values through all modules behind them. Otherwise the ticks before
+ * the start are simulated without output.
+ */
+struct FastForward {
+    long start = 0;
+    std::vector<string> jumping;    // generators jumping ahead, empty for the simulation
+    size_t refill = 0;
+};
+
+// Why a stateful module has to be simulated, empty if it jumps in closed form
+string simulationReason(const ParsedFile& file, const Dataflow& graph, const ModuleDeclaration& d) {
+    auto j = jumpingModules.find(d.type);
+    if (j == jumpingModules.end())
+        return "it has no closed form";
+    if (d.type == "ModuleRand" && d.template_args[0] == "INT")
+        return "it takes a varying number of random draws";
+
+    for (const auto& n : file.net_pin) {
+        if (n.module != d.name || n.is_out || !j->second.count(n.pin))
+            continue;
+        if (graph.driver.count(n.net))
+            return "its " + n.pin + " is not constant";
+        if (d.type != "ModuleSaw" || n.pin != "period")
+            continue;
+        for (const auto& c : file.net_const) {
+            if (c.net != n.net)
+                continue;
+            double per = c.parameter.is<double>() ? c.parameter.get<double>()
+                                                  : double(c.parameter.get<int64_t>());
+            if (!(per >= 1) || per != std::floor(per))
+                return "its period is not a positive whole number";
+        }
+    }
+    return "";
+}
+
+/*
+ * Decides how every module gets to the start step and reports it. A single
+ * simulated module, a feedback loop, rate dividers or enable groups make all
+ * modules simulated, so they see the same inputs as in a full run.
+ */
+FastForward planFastForward(const ParsedFile& file, long start, std::ostream& report) {
+    Dataflow graph(file);
+    FastForward res;
+    res.start = start;
+
+    report << "Fast-forward to tick " << start << ":\n";
+    bool closedForm = true;
+    for (const auto& d : file.declarations) {
+        report << "    " << d.name << " (" << d.type << ") ";
+        if (moduleInfo[d.type].pure || d.type == "ModuleInstance") {
+            report << "keeps no state\n";
+            continue;
+        }
+        string reason = simulationReason(file, graph, d);
+        if (reason.empty()) {
+            report << "jumps in closed form\n";
+            res.jumping.push_back(d.name);
+        } else {
+            report << "is simulated, " << reason << "\n";
+            closedForm = false;
+        }
+    }
+
+    res.refill = longestChain(graph);
+    string simulated;
+    if (!closedForm)
+        simulated = "some modules have to be simulated";
+    else if (res.refill == 0)
+        simulated = "feedback loops have to be simulated";
+    else if (!file.rates.empty() || !file.enables.empty())
+        simulated = "rate dividers and enable groups skip steps";
+    else if (size_t(start) <= res.refill)
+        simulated = "the start is within the longest chain of modules";
+
+    if (simulated.empty()) {
+        report << "  last " << res.refill << " ticks are simulated to refill the pins\n";
+    } else {
+        report << "  all ticks are simulated without output, " << simulated << "\n";
+        res.jumping.clear();
+        res.refill = 0;
+    }
+    return res;
+}
+
+string generateFastForward(const FastForward& ff, const string& steps) {
+    string res;
+    long from = 0;
+    if (!ff.jumping.empty()) {
+        from = ff.start - long(ff.refill);
+        res += tabs(1) + "// Jump generators to the start, the last ticks refill the pins\n";
+        for (const auto& m : ff.jumping)
+            res += tabs(1) + m + ".advance(" + std::to_string(from) + ");\n";
+    } else {
+        res += tabs(1) + "// Simulate the ticks before the start without output\n";
+    }
+    res += tabs(1) + "for(long _cpplink_i = " + std::to_string(from) + "; _cpplink_i != "
+        + std::to_string(ff.start) + "; _cpplink_i++) {\n";
+    res += steps;
+    res += tabs(1) + "}\n\n";
+    return res;
+}
+
+string generateSystemSteps(const ParsedFile& file,
+    const std::map<std::string, std::string>& nets,
+    const std::vector<string>& watched_nets, long steps,
+    Schedule schedule, Wiring wiring, size_t threads, bool events, size_t periodic,
+    const FastForward& fastForward, bool pooled)
+{
+    Dataflow graph(file);
+    std::set<string> latched = latchedNets(graph, schedule, threads > 1 || pooled);
+
+    std::string res;
+    if (threads > 1)
+        res += generateThreadTeam(graph, nets, wiring, latched, threads);
+    if (events)
+        res += generateEventCounters(graph);
+    if (periodic)
+        res += generatePeriodDetector(nets, watched_nets, periodic);
+
+    string body = generateEnableFlags(file, graph);
+    if (threads > 1)
+        body += tabs(2) + "_cpplink_team.run();\n";
+    else if (events)
+        body += generateEventSteps(graph, nets, latched);
+    else if (schedule == Schedule::Topological && pooled)
+        body += generatePooledTopologicalSteps(graph, wiring, latched, Pools(graph, schedule));
+    else if (schedule == Schedule::Topological)
+        body += generateTopologicalSteps(graph, wiring, latched);
+    else
+        body += generatePhasedSteps(graph, nets, wiring, latched, pooled ? Pools(graph, schedule) : Pools());
+
+    if (fastForward.start)
+        res += generateFastForward(fastForward, body);
+    res += generateTickLoop(steps, 1, fastForward.start);
+    res += body;
+
+    if (!watched_nets.empty())
+        res += "\n" + generateTableLine(watched_nets, {});
+    if (periodic)
+        res += generatePeriodCheck(file, watched_nets, steps);
+
+    res += tabs(1) + "}\n";
+    if (events && steps > 0)
+        res += generateUtilizationReport(graph, nets, steps);
+    return res;
+}
+
+/*
+ * Block processing: every pin holds a block of ticks. Modules outside of
+ * feedback loops step the whole block at once in the topological order,
+ * modules of a loop are stepped together tick by tick. Nets closing a loop
+ * are read one tick back, their readers see the previous tick as with the
+ * topological schedule.
+ */
+string generateBlockAliasing(const Dataflow& graph) {
+    std::set<string> feedback = feedbackNets(graph);
+    string res = tabs(1) + "// Input pins read blocks directly from nets\n";
+    for (const auto& net : graph.nets)
+        res += tabs(1) + net + (feedback.count(net) ? ".aliasLatched();\n" : ".alias();\n");
+    return res + "\n";
+}
+
+string generateBlockSteps(const Dataflow& graph, const std::vector<string>& watched_nets,
+    long steps, size_t block)
+{
+    string k = std::to_string(block);
+    string res;
+    if (steps == -1) {
+        res += tabs(1) + "for(long _cpplink_i = 0; true; _cpplink_i += " + k + ") {\n";
+        res += tabs(2) + "size_t _cpplink_k = " + k + ";\n";
+    }
+    else {
+        string n = std::to_string(steps);
+        res += tabs(1) + "for(long _cpplink_i = 0; _cpplink_i < " + n + "; _cpplink_i += " + k + ") {\n";
+        res += tabs(2) + "size_t _cpplink_k = std::min<long>(" + k + ", " + n + " - _cpplink_i);\n";
+    }
+
+    res += "\n" + tabs(2) + "// Step modules in dataflow order, loops tick by tick\n";
+    for (const auto& component : stronglyConnectedComponents(graph)) {
+        size_t first = component.front();
+        if (component.size() == 1 && !graph.successors[first].count(first)) {
+            res += tabs(2) + graph.modules[first]->name + ".stepBlock(_cpplink_k);\n";
+            continue;
+        }
+        res += tabs(2) + "for (size_t _cpplink_t = 0; _cpplink_t < _cpplink_k; _cpplink_t++) {\n";
+        for (size_t m : component)
+            res += tabs(3) + graph.modules[m]->name + ".step(_cpplink_t);\n";
+        res += tabs(2) + "}\n";
+    }
+
+    std::set<string> feedback = feedbackNets(graph);
+    if (!feedback.empty()) {
+        res += "\n" + tabs(2) + "// Keep the last tick of nets closing loops for the next block\n";
+        for (const auto& net : feedback)
+            res += tabs(2) + net + ".carry(_cpplink_k);\n";
+    }
 
     if (!watched_nets.empty()) {
+        res += "\n" + tabs(2) + "// Output values in this block\n";
+        res += tabs(2) + "for (size_t _cpplink_t = 0; _cpplink_t < _cpplink_k; _cpplink_t++) {\n";
+        res += tabs(3) + "_cpplink_table.write_line(\n";
+        res += tabs(4) + "_cpplink_i + _cpplink_t";
+        for (const auto& net : watched_nets)
+            res += ",\n" + tabs(4) + net + ".getValue(_cpplink_t)";
+        res += "\n" + tabs(3) + ");\n";
+        res += tabs(2) + "}\n";
+    }
+    res += tabs(1) + "}\n";
+    return res;
+}
+
+/*
+ * Pipelined execution: every thread runs its own loop over the ticks with a
+ * part of the modules. Values of nets read by other threads are sent through
+ * channels, so a thread waits only for the threads it reads from and runs up
+ * to `lag` ticks ahead of its readers.
+ */
+struct Pipeline {
+    Pipeline(const ParsedFile& file, size_t threads, size_t lag)
+        : file(file), graph(file), threads(threads), lag(lag),
+          thread(pipelineThreads(graph, threads))
+    {
+        for (const auto& d : graph.driver)
+            driver[d.first] = thread[d.second];
+        for (size_t m = 0; m < graph.modules.size(); m++)
+            for (const auto& net : graph.inputs[m])
+                readers[net].insert(thread[m]);
+    }
+
+    static string channel(const string& net, size_t t) {
+        return "_cpplink_" + net + "_to" + std::to_string(t);
+    }
+
+    static string watchChannel(const string& net) {
+        return "_cpplink_" + net + "_watch";
+    }
+
+    // Nets crossing threads and their channels
+    std::map<string, std::set<size_t>> crossings() const {
+        std::map<string, std::set<size_t>> res;
+        for (const auto& r : readers) {
+            auto d = driver.find(r.first);
+            if (d == driver.end())
+                continue;
+            for (size_t t : r.second)
+                if (t != d->second)
+                    res[r.first].insert(t);
+        }
+        return res;
+    }
+
+    // Watched nets driven outside of the main thread
+    std::map<string, string> watchChannels(const std::vector<string>& watched) const {
+        std::map<string, string> res;
+        for (const auto& net : watched) {
+            auto d = driver.find(net);
+            if (d != driver.end() && d->second != 0)
+                res[net] = watchChannel(net);
+        }
+        return res;
+    }
+
+    std::map<std::pair<string, string>, string> rewiring() const {
+        std::map<std::pair<string, string>, string> res;
+        for (const auto& n : file.net_pin) {
+            auto m = graph.index.find(n.module);
+            auto d = driver.find(n.net);
+            if (n.is_out || m == graph.index.end() || d == driver.end())
+                continue;
+            if (thread[m->second] != d->second)
+                res[{ n.net, n.module }] = channel(n.net, thread[m->second]);
+        }
+        return res;
+    }
+
+    string generateChannels(DeclarationsMap& modules, const std::vector<string>& watched) const {
+        std::map<string, string> types;
+        for (const auto& n : file.net_pin)
+            if (n.is_out)
+                types[n.net] = getPinType(modules, n.module, n.pin);
+
+        string res;
+        for (const auto& c : crossings())
+            for (size_t t : c.second)
+                res += tabs(1) + "Channel<" + types[c.first] + "> " + channel(c.first, t)
+                    + "(" + std::to_string(lag + 1) + ");\n";
+        for (const auto& c : watchChannels(watched))
+            res += tabs(1) + "Channel<" + types[c.first] + "> " + c.second
+                + "(" + std::to_string(lag) + ");\n";
+        return res.empty() ? res : tabs(1) + "// Values of nets passed between threads\n" + res + "\n";
+    }
+
+    string generateSteps(const std::vector<string>& watched, long steps,
+        Wiring wiring, const std::set<string>& latched) const
+    {
+        auto watches = watchChannels(watched);
+        string res;
+        for (size_t t = 1; t < threads; t++) {
+            res += tabs(1) + "auto _cpplink_thread" + std::to_string(t) + " = [&] {\n";
+            res += generateTickLoop(steps, 2);
+            res += generateTick(t, tabs(1), watches, wiring, latched);
+            res += tabs(2) + "}\n";
+            res += tabs(1) + "};\n\n";
+        }
+
+        res += tabs(1) + "// Every reader starts with the values before the first tick\n";
+        for (const auto& c : crossings())
+            for (size_t t : c.second)
+                res += tabs(1) + channel(c.first, t) + ".push(" + c.first + ".getValue());\n";
+        // Nets without a driver never change, they are propagated just once
+        for (const auto& net : graph.nets)
+            if (!driver.count(net) && wiring == Wiring::Copy)
+                res += tabs(1) + net + ".step();\n";
+        for (size_t t = 1; t < threads; t++)
+            res += tabs(1) + "std::thread _cpplink_run" + std::to_string(t)
+                + "(_cpplink_thread" + std::to_string(t) + ");\n";
         res += "\n";
-        res += tabs(2) + "// Output values in this step\n";
-        res += tabs(2) + "_cpplink_table.write_line(\n";
-        res += tabs(3) + "_cpplink_i";
-        for (const std::string& net : watched_nets)
-            res += ",\n" + tabs(3) + net + ".getValue()";
-        res += "\n" + tabs(2) + ");\n";
+
+        res += generateTickLoop(steps, 1);
+        res += generateTick(0, "", watches, wiring, latched);
+        if (!watched.empty())
+            res += "\n" + generateTableLine(watched, watches);
+        res += tabs(1) + "}\n";
+
+        for (size_t t = 1; t < threads; t++)
+            res += tabs(1) + "_cpplink_run" + std::to_string(t) + ".join();\n";
+        return res;
+    }
+
+    // Single tick of the modules of thread t
+    string generateTick(size_t t, const string& indent, const std::map<string, string>& watches,
+        Wiring wiring, const std::set<string>& latched) const
+    {
+        string pulls, propagation, modules, pushes;
+        for (const auto& c : crossings()) {
+            if (c.second.count(t))
+                pulls += indent + tabs(2) + channel(c.first, t) + ".pull();\n";
+        }
+
+        for (const auto& d : driver) {
+            if (d.second != t)
+                continue;
+            auto r = readers.find(d.first);
+            if (r != readers.end() && r->second.count(t))
+                propagation += indent + generateNetStep(d.first, wiring, latched);
+            if (r != readers.end()) {
+                for (size_t reader : r->second)
+                    if (reader != t)
+                        pushes += indent + tabs(2) + channel(d.first, reader) + ".push(" + d.first + ".getValue());\n";
+            }
+            auto w = watches.find(d.first);
+            if (w != watches.end())
+                pushes += indent + tabs(2) + w->second + ".push(" + d.first + ".getValue());\n";
+        }
+
+        for (size_t m : topologicalOrder(graph))
+            if (thread[m] == t)
+                modules += indent + tabs(2) + graph.modules[m]->name + ".step();\n";
+
+        string res;
+        if (!pulls.empty())
+            res += indent + tabs(2) + "// Receive values of nets driven by other threads\n" + pulls + "\n";
+        if (!propagation.empty())
+            res += indent + tabs(2) + "// Propagate values through nets\n" + propagation + "\n";
+        res += indent + tabs(2) + "// Do step in each module\n" + modules;
+        if (!pushes.empty())
+            res += "\n" + indent + tabs(2) + "// Send values to other threads\n" + pushes;
+        return res;
+    }
+
+    const ParsedFile& file;
+    Dataflow graph;
+    size_t threads;
+    size_t lag;
+    std::vector<size_t> thread;                   // module -> thread
+    std::map<string, size_t> driver;              // net -> thread of its driver
+    std::map<string, std::set<size_t>> readers;   // net -> threads of its readers
+};
+
+/*
+ * Partitioned simulation: every process steps the modules of its partition
+ * with the phased schedule. At the beginning of a tick the values of nets
+ * crossing partitions are published to mailboxes in shared memory, after a
+ * barrier the readers take them as the values of their drivers. Process 0
+ * writes the output, watched nets of other partitions cross to it as well.
+ * Their values after a tick arrive only in the next one, so the output is
+ * written a tick late and the last line after one more exchange.
+ */
+string generateProcessSteps(const ParsedFile& file, const std::map<std::string, std::string>& nets,
+    const std::vector<string>& watched, long steps, size_t processes, std::ostream& report)
+{
+    Dataflow graph(file);
+    std::vector<size_t> part = processPartition(graph, processes);
+
+    std::map<string, std::set<size_t>> readers;
+    for (size_t m = 0; m < graph.modules.size(); m++)
+        for (const auto& net : graph.inputs[m])
+            readers[net].insert(part[m]);
+    for (const auto& net : watched)
+        readers[net].insert(0);
+
+    std::map<string, std::set<size_t>> crossing;   // net -> reading processes of other partitions
+    for (const auto& d : graph.driver)
+        for (size_t p : readers[d.first])
+            if (p != part[d.second])
+                crossing[d.first].insert(p);
+
+    std::vector<size_t> modules(processes, 0);
+    for (size_t p : part)
+        modules[p]++;
+    for (size_t p = 0; p < processes; p++)
+        report << "Process " << p << ": " << modules[p] << " modules\n";
+    report << "Nets crossing processes: " << crossing.size() << ", cut "
+           << partitionCut(graph, part) << "\n";
+
+    auto box = [](const string& net) { return "_cpplink_" + net + "_box"; };
+    auto exchange = [&](size_t p, const string& tick, unsigned indent) {
+        string publish, receive;
+        for (const auto& c : crossing) {
+            if (part[graph.driver[c.first]] == p)
+                publish += tabs(indent) + box(c.first) + ".publish(" + c.first + ".getValue(), " + tick + ");\n";
+            else if (c.second.count(p))
+                receive += tabs(indent) + c.first + ".setValue(" + box(c.first) + ".read(" + tick + "));\n";
+        }
+        string res;
+        if (!publish.empty())
+            res += tabs(indent) + "// Publish values of nets read by other processes\n" + publish;
+        res += tabs(indent) + "_cpplink_group.wait();\n";
+        if (!receive.empty())
+            res += tabs(indent) + "// Receive values of nets driven by other processes\n" + receive;
+        return res;
+    };
+
+    string res;
+    res += tabs(1) + "// " + std::to_string(processes) + " processes simulate partitions of the netlist, "
+        "nets crossing them pass through shared memory\n";
+    res += tabs(1) + "ProcessGroup _cpplink_group(" + std::to_string(processes) + ", "
+        + std::to_string(crossing.size()) + ");\n";
+    for (const auto& c : crossing)
+        res += tabs(1) + "Mailbox<" + nets.find(c.first)->second + "> " + box(c.first) + "(_cpplink_group);\n";
+    res += tabs(1) + "size_t _cpplink_p = _cpplink_group.spawn();\n\n";
+
+    res += generateTickLoop(steps, 1);
+    res += tabs(2) + "switch (_cpplink_p) {\n";
+    for (size_t p = 0; p < processes; p++) {
+        string propagation, moduleSteps;
+        for (const auto& r : readers)
+            if (r.second.count(p))
+                propagation += tabs(1) + generateNetStep(r.first, Wiring::Copy, {});
+        for (size_t m : stepOrder(graph, Schedule::TwoPhase))
+            if (part[m] == p)
+                moduleSteps += tabs(3) + graph.modules[m]->name + ".step();\n";
+
+        res += tabs(2) + "case " + std::to_string(p) + ":\n";
+        res += exchange(p, "_cpplink_i", 3);
+        if (p == 0 && !watched.empty()) {
+            res += "\n" + tabs(3) + "if (_cpplink_i != 0) {\n";
+            res += generateTableLine(watched, {}, "_cpplink_i - 1", 4);
+            res += tabs(3) + "}\n";
+        }
+        if (!propagation.empty())
+            res += "\n" + tabs(3) + "// Propagate values through nets\n" + propagation;
+        if (!moduleSteps.empty())
+            res += "\n" + tabs(3) + "// Do step in each module\n" + moduleSteps;
+        res += tabs(3) + "break;\n";
+    }
+    res += tabs(2) + "}\n";
+    res += tabs(1) + "}\n";
+
+    if (!watched.empty() && steps > 0) {
+        res += "\n" + tabs(1) + "// Values after the last step\n";
+        res += tabs(1) + "switch (_cpplink_p) {\n";
+        for (size_t p = 0; p < processes; p++) {
+            res += tabs(1) + "case " + std::to_string(p) + ":\n";
+            res += exchange(p, std::to_string(steps), 2);
+            if (p == 0)
+                res += generateTableLine(watched, {}, std::to_string(steps - 1), 2);
+            res += tabs(2) + "break;\n";
+        }
+        res += tabs(1) + "}\n";
     }
 
+    res += tabs(1) + "if (!_cpplink_group.finish(_cpplink_p)) {\n";
+    res += tabs(2) + "std::cerr << \"A process of the simulation failed\\n\";\n";
+    res += tabs(2) + "return 1;\n";
     res += tabs(1) + "}\n";
     return res;
 }
 
+string generateNetAliasing(const ParsedFile& file, Schedule schedule, Wiring wiring, size_t threads,
+    bool pooled)
+{
+    Dataflow graph(file);
+    std::set<string> latched = latchedNets(graph, schedule, threads > 1 || pooled);
 
-string generateNetDeclaration(string name, string type) {
-    return tabs(1) + "Net<" + type + "> " + name + ";\n";
+    if (wiring == Wiring::Copy) {
+        if (graph.demandNets.empty())
+            return {};
+        string res = tabs(1) + "// Demand pins read values directly from nets\n";
+        for (const auto& net : graph.demandNets)
+            res += tabs(1) + net + (latched.count(net) ? ".aliasDemandLatched();\n" : ".aliasDemand();\n");
+        return res + "\n";
+    }
+
+    string res = tabs(1) + "// Input pins read values directly from nets\n";
+    for (const auto& net : graph.nets)
+        res += tabs(1) + net + (latched.count(net) ? ".aliasLatched();\n" : ".alias();\n");
+    return res + "\n";
 }
 
-string generateConstWiring(const NetPinCommand& n) {
-    return tabs(1) + n.module + "." + n.pin + " = " + constDeclarations[n.net].second + ";\n";
+// Streams are given by positions in the original netlist, so pruned netlists
+// draw the same numbers
+string generateSeeding(const ParsedFile& file, uint64_t seed, const ParsedFile& generated) {
+    std::set<string> declared;
+    for (const auto& d : generated.declarations)
+        declared.insert(d.name);
+
+    string res;
+    for (size_t i = 0; i < file.declarations.size(); i++) {
+        const auto& module = file.declarations[i];
+        if (randomModules.count(module.type) && declared.count(module.name))
+            res += tabs(1) + module.name + ".seed(" + std::to_string(seed) + "ull, " + std::to_string(i) + ");\n";
+    }
+    return res.empty() ? res : tabs(1) + "// Every random module draws from its own stream\n" + res + "\n";
 }
 
-string ModuleDeclaration::generateCode() const {
-    string res = tabs(1) + type;
-    size_t argsize = this->template_args.size();
+/*
+ * Netlist reduced to the cone of influence of the watched nets, modules and
+ * nets outside of it cannot change the watched values.
+ */
+ParsedFile pruneToCone(const ParsedFile& file, const std::vector<string>& watched) {
+    Dataflow graph(file);
+    std::set<string> cone;
+    for (size_t m : coneOfInfluence(graph, watched))
+        cone.insert(graph.modules[m]->name);
 
-    if (argsize) {
-        res += "<";
-        for(unsigned i=0; i<argsize; i++) {
-            res += typeToStr.find(template_args[i])->second;
-            if (i<argsize-1) res += ", ";
+    ParsedFile res = file;
+    res.declarations.clear();
+    res.net_pin.clear();
+    for (const auto& d : file.declarations)
+        if (cone.count(d.name))
+            res.declarations.push_back(d);
+    for (const auto& n : file.net_pin)
+        if (cone.count(n.module))
+            res.net_pin.push_back(n);
+
+    // Enable groups without any module in the cone are dropped
+    res.enables.clear();
+    for (auto e : file.enables) {
+        e.modules.erase(std::remove_if(e.modules.begin(), e.modules.end(),
+            [&](const string& m) { return !cone.count(m); }), e.modules.end());
+        if (!e.modules.empty())
+            res.enables.push_back(e);
+    }
+    return res;
+}
+
+template <typename F>
+double lutError(double min, double max, size_t size, bool cubic, bool& finite) {
+    if (cubic) {
+        LookupTable<F, Interpolation::Cubic> table(min, max, size);
+        finite = table.isFinite();
+        return table.maxError();
+    }
+    LookupTable<F, Interpolation::Linear> table(min, max, size);
+    finite = table.isFinite();
+    return table.maxError();
+}
+
+using LutError = double (*)(double, double, size_t, bool, bool&);
+std::map<string, LutError> lutErrors{{"SQRT", &lutError<FuncSqrt>}, {"LOG", &lutError<FuncLog>},
+    {"EXP", &lutError<FuncExp>}, {"SIN", &lutError<FuncSin>}, {"COS", &lutError<FuncCos>},
+    {"TAN", &lutError<FuncTan>}};
+
+/*
+ * Checks lookup tables and reports their interpolation error. Tables with a
+ * larger error than tolerance (if positive) are errors.
+ */
+std::vector<ParseError> checkLookupTables(const ParsedFile& file, double tolerance, std::ostream& report) {
+    std::vector<ParseError> errors;
+    for (const auto& d : file.declarations) {
+        if (d.type != "ModuleLUT" && d.type != "ModuleLUTCubic")
+            continue;
+
+        const string& func = d.template_args[0];
+        double min = std::stod(d.template_args[1]);
+        double max = std::stod(d.template_args[2]);
+        size_t size = std::stoul(d.template_args[3]);
+        if (!(min < max)) {
+            errors.push_back(ParseError("Empty range of lookup table " + d.name, d.line));
+            continue;
+        }
+        if (size < 2) {
+            errors.push_back(ParseError("Lookup table " + d.name + " needs at least 2 intervals", d.line));
+            continue;
         }
-        res += ">";
+
+        bool finite;
+        double err = lutErrors[func](min, max, size, d.type == "ModuleLUTCubic", finite);
+        if (!finite) {
+            errors.push_back(ParseError(func + " is not finite on the range of lookup table "
+                                        + d.name, d.line));
+            continue;
+        }
+        if (tolerance > 0 && !(err <= tolerance)) {
+            errors.push_back(ParseError("Lookup table " + d.name + " exceeds tolerance, error "
+                                        + itos<double>(err), d.line));
+            continue;
+        }
+        report << "Lookup table " << d.name << ": " << func << " on [" << min << ", " << max
+               << "] with " << size << " intervals, max error " << err << "\n";
+    }
+    return errors;
+}
+
+
+string lanesArg(const Lanes& lanes) {
+    return lanes ? ", " + std::to_string(lanes.count) : "";
+}
+
+string generateNetDeclaration(string name, string type, const Lanes& lanes) {
+    return tabs(1) + lanes.prefix() + "Net<" + type + lanesArg(lanes) + "> " + name + ";\n";
+}
+
+string generateConstWiring(const NetPinCommand& n, DeclarationsMap& modules) {
+    return tabs(1) + n.module + "." + pinAccess(modules[n.module], n.pin) + " = "
+        + constDeclarations[n.net].second + ";\n";
+}
+
+string ModuleDeclaration::generateCode(const Lanes& lanes) const {
+    return tabs(1) + generateType(lanes) + " " + name + generateConstructorArgs() + ";\n";
+}
+
+// Decimal arguments cannot be passed as C++ template arguments, they are
+// passed to the constructor instead
+string ModuleDeclaration::generateType(const Lanes& lanes) const {
+    string res = lanes.prefix() + type;
+    const auto& allowed = moduleInfo[type].allowed_types;
+
+    std::vector<string> targs;
+    for (size_t i = 0; i < template_args.size(); i++) {
+        const string& arg = template_args[i];
+        if (std::count(allowed[i].begin(), allowed[i].end(), Decimal))
+            continue;
+        if (typeToStr.count(arg))
+            targs.push_back(typeToStr[arg]);
+        else if (functionToStr.count(arg))
+            targs.push_back(functionToStr[arg]);
+        else
+            targs.push_back(arg);
+    }
+
+    if (!targs.empty()) {
+        res += "<";
+        for (size_t i = 0; i < targs.size(); i++)
+            res += (i ? ", " : "") + targs[i];
+        res += lanesArg(lanes) + ">";
+    }
+    else if (lanes) {
+        res += "<" + std::to_string(lanes.count) + ">";
+    }
+    return res;
+}
+
+string ModuleDeclaration::generateConstructorArgs() const {
+    const auto& allowed = moduleInfo[type].allowed_types;
+    std::vector<string> cargs;
+    for (size_t i = 0; i < template_args.size(); i++) {
+        if (std::count(allowed[i].begin(), allowed[i].end(), Decimal))
+            cargs.push_back(template_args[i]);
     }
-    return res + " " + name + ";\n";
+
+    string res;
+    for (size_t i = 0; i < cargs.size(); i++)
+        res += (i ? ", " : "") + cargs[i];
+    return cargs.empty() ? res : "{" + res + "}";
+}
+
+string NetPinCommand::generateDemandCode() const {
+    return tabs(1) + net + ".addDemandPin(" + module + "." + pin + ");\n";
 }
 
 string NetPinCommand::generateCode() const {
@@ -156,7 +1428,7 @@ void checkForStrayNets(const NetPinCommand& n, std::map<string, string>& strayNe
     }   
 }
 
-string netStrayNets(std::map<string, string>& strayNets) {
+string netStrayNets(std::map<string, string>& strayNets, const Lanes& lanes) {
     string res;
     std::map<string, std::vector<string>> typeToNets;
     for (auto n : strayNets) {
@@ -164,7 +1436,7 @@ string netStrayNets(std::map<string, string>& strayNets) {
     }
     for (auto n : typeToNets) {
         string name = "blank" + n.first;
-        res += tabs(1) + "OutputPin<" + n.first + "> " + name + ";\n";
+        res += tabs(1) + lanes.prefix() + "OutputPin<" + n.first + lanesArg(lanes) + "> " + name + ";\n";
         for (auto net : n.second) {
             res += tabs(1) + net + ".setOutputPin(" + name + ");\n";
         }
@@ -173,33 +1445,43 @@ string netStrayNets(std::map<string, string>& strayNets) {
     return res;
 }
 
-string ParsedFile::generateCode(DeclarationsMap& modules, std::map<string, string>& nets) const {
+string ParsedFile::generateCode(DeclarationsMap& modules, std::map<string, string>& nets,
+        const Lanes& lanes, const std::map<std::pair<string, string>, string>& rewired, bool declare) const {
         std::string res;
         std::map<string, string> strayNets; //unset outputPin in net
 
-        for (const auto& d : declarations) {
-            res += d.generateCode();
+        if (declare) {
+            for (const auto& d : declarations) {
+                res += d.generateCode(lanes);
+            }
+            res += "\n";
         }
-        res += "\n";
 
         for (const auto& n : net_pin) {
             string net_type;
             if (constDeclarations.find(n.net) != constDeclarations.end()) {
-                res += generateConstWiring(n);
+                res += generateConstWiring(n, modules);
             } else {
                 if (nets.find(n.net) == nets.end()) {
                     net_type = getPinType(modules, n.module, n.pin);
-                    res += generateNetDeclaration(n.net, net_type);
+                    res += generateNetDeclaration(n.net, net_type, lanes);
                     strayNets.insert({ n.net, net_type });
                 }
-                res += n.generateCode();
+                NetPinCommand wired = n;
+                Pin pin;
+                findPin(modules[n.module], n.pin, pin);
+                wired.pin = pinAccess(modules[n.module], n.pin);
+                auto r = rewired.find({ n.net, n.module });
+                if (r != rewired.end() && !n.is_out)
+                    wired.net = r->second;
+                res += pin.demand ? wired.generateDemandCode() : wired.generateCode();
                 checkForStrayNets(n, strayNets); 
                 nets.insert({ n.net, net_type });
             }
             
         }
         res += "\n";
-        res += netStrayNets(strayNets) + "\n";
+        res += netStrayNets(strayNets, lanes) + "\n";
 
         return res;
 }
@@ -244,7 +1526,7 @@ nets_to_watch(std::string config, translator::ParsedFile& file) {
 }
 
 std::string generate_output(std::string output_type, const std::map<std::string, std::string>& nets,
-        const std::vector<std::string>& watched)
+        const std::vector<std::string>& watched, size_t lanes)
 {
     if (output_type == "silent")
         return {};
@@ -258,10 +1540,16 @@ std::string generate_output(std::string output_type, const std::map<std::string,
         assert(false && "Invalid output type specified");
 
     std::string res;
-    res += tabs(1) + "TableWriter<" + output_type + ", int";
+    if (lanes)
+        res += tabs(1) + "batch::TableWriter<" + output_type + ", " + std::to_string(lanes);
+    else
+        res += tabs(1) + "TableWriter<" + output_type + ", int";
     for (const std::string& net : watched) {
         res += ",\n";
-        res += tabs(3) + "Maybe<" + nets.find(net)->second + ">";
+        if (lanes)
+            res += tabs(3) + "batch::Lanes<" + nets.find(net)->second + lanesArg(lanes) + ">";
+        else
+            res += tabs(3) + "Maybe<" + nets.find(net)->second + ">";
     }
     res += "\n" + tabs(2) + "> _cpplink_table (std::cout, {\"step\"";
     for (const std::string& net : watched) {
@@ -285,27 +1573,228 @@ int main(int argc, char* argv[]) {
         true,
         "CppLink 0.1");
 
-    std::string in_file = args["<input_file>"].asString();
-    std::string out_file = args["<output_file>"].asString();
+    bool        run = args["run"].asBool();
+    bool        bytecode = args["bytecode"].asBool();
+    bool        exec = args["exec"].asBool();
+    std::string in_file = args["<input_file>"].isString() ? args["<input_file>"].asString() : "";
+    std::string program_file = args["<program_file>"].isString() ? args["<program_file>"].asString() : "";
+    std::string out_file = args["<output_file>"].isString() ? args["<output_file>"].asString() : "";
     std::string output_type = args["--interface"].isString() ? args["--interface"].asString() : "silent";
     std::transform(output_type.begin(), output_type.end(), output_type.begin(), ::tolower);
     std::string to_watch = args["--watch"].isString() ? args["--watch"].asString() : "";
-    long        step_num = args["--steps"].asLong();
+    long        step_num = args["--steps"].isString() ? args["--steps"].asLong() : 0;
     bool        embed_lib = !args["--uselib"].asBool();
+    std::string schedule_type = args["--schedule"].isString() ? args["--schedule"].asString() : "phased";
+    std::string wiring_type = args["--wiring"].isString() ? args["--wiring"].asString() : "copy";
+    long        instances = args["--instances"].isString() ? args["--instances"].asLong() : 0;
+    bool        compact_maybe = args["--compact-maybe"].asBool();
+    std::string seed_str = args["--seed"].isString() ? args["--seed"].asString() : "0";
+    std::string tolerance_str = args["--lut-tolerance"].isString() ? args["--lut-tolerance"].asString() : "0";
+    long        threads = args["--threads"].isString() ? args["--threads"].asLong() : 1;
+    long        lag = args["--pipeline"].isString() ? args["--pipeline"].asLong() : 0;
+    bool        events = args["--events"].asBool();
+    bool        lazy = args["--lazy"].asBool();
+    long        block = args["--block"].isString() ? args["--block"].asLong() : 0;
+    long        periodic = args["--periodic"].isString() ? args["--periodic"].asLong() : 0;
+    long        start_step = args["--start-step"].isString() ? args["--start-step"].asLong() : 0;
+    long        processes = args["--processes"].isString() ? args["--processes"].asLong() : 1;
+    bool        pools = args["--pools"].asBool();
 
     if (step_num < -1) {
         std::cerr << "Invalid number of steps! Please specify positive number or -1 for infinite loop\n";
         return 1;
     }
 
+    Schedule schedule;
+    if (schedule_type == "phased")
+        schedule = Schedule::TwoPhase;
+    else if (schedule_type == "topo")
+        schedule = Schedule::Topological;
+    else {
+        std::cerr << "Invalid schedule \"" << schedule_type << "\"! Please specify phased or topo\n";
+        return 1;
+    }
+
+    Wiring wiring;
+    if (wiring_type == "copy")
+        wiring = Wiring::Copy;
+    else if (wiring_type == "alias")
+        wiring = Wiring::Alias;
+    else {
+        std::cerr << "Invalid wiring \"" << wiring_type << "\"! Please specify copy or alias\n";
+        return 1;
+    }
+
+    if (args["--instances"].isString() && instances < 1) {
+        std::cerr << "Invalid number of instances! Please specify positive number\n";
+        return 1;
+    }
+
+    if (threads < 1) {
+        std::cerr << "Invalid number of threads! Please specify positive number\n";
+        return 1;
+    }
+
+    if (threads > 1 && schedule != Schedule::TwoPhase) {
+        std::cerr << "Multiple threads are supported only with the phased schedule\n";
+        return 1;
+    }
+
+    if (args["--pipeline"].isString() && lag < 1) {
+        std::cerr << "Invalid pipeline lag! Please specify positive number\n";
+        return 1;
+    }
+
+    if (lag && threads < 2) {
+        std::cerr << "Pipelined execution needs multiple threads\n";
+        return 1;
+    }
+
+    if (lag && instances) {
+        std::cerr << "Pipelined execution is not supported with multiple instances\n";
+        return 1;
+    }
+
+    if (events && (schedule != Schedule::TwoPhase || wiring != Wiring::Copy || threads > 1 || instances)) {
+        std::cerr << "Event-driven steps are supported only with the phased schedule, copy wiring, "
+                     "single thread and instance\n";
+        return 1;
+    }
+
+    if (args["--block"].isString() && block < 1) {
+        std::cerr << "Invalid block size! Please specify positive number\n";
+        return 1;
+    }
+
+    if (block && schedule != Schedule::Topological) {
+        std::cerr << "Block processing is supported only with the topological schedule\n";
+        return 1;
+    }
+
+    if (block && args["--wiring"].isString() && wiring == Wiring::Copy) {
+        std::cerr << "Block processing reads nets directly, it cannot be combined with copy wiring\n";
+        return 1;
+    }
+
+    if (block && (threads > 1 || events || instances)) {
+        std::cerr << "Block processing is not supported with multiple threads or instances "
+                     "or event-driven steps\n";
+        return 1;
+    }
+
+    if (args["--periodic"].isString() && periodic < 1) {
+        std::cerr << "Invalid period budget! Please specify positive number\n";
+        return 1;
+    }
+
+    if (periodic && (threads > 1 || events || instances || block)) {
+        std::cerr << "Periodicity detection is not supported with multiple threads or instances, "
+                     "block processing or event-driven steps\n";
+        return 1;
+    }
+
+    if (start_step < 0 || (step_num != -1 && start_step > step_num)) {
+        std::cerr << "Invalid start step! Please specify non-negative number up to the number of steps\n";
+        return 1;
+    }
+
+    if (start_step && (threads > 1 || events || instances || block || periodic)) {
+        std::cerr << "Start step is not supported with multiple threads or instances, block processing, "
+                     "event-driven steps or periodicity detection\n";
+        return 1;
+    }
+
+    if (processes < 1) {
+        std::cerr << "Invalid number of processes! Please specify positive number\n";
+        return 1;
+    }
+
+    if (processes > 1 && (schedule != Schedule::TwoPhase || wiring != Wiring::Copy)) {
+        std::cerr << "Multiple processes are supported only with the phased schedule and copy wiring\n";
+        return 1;
+    }
+
+    if (processes > 1 && (threads > 1 || events || instances || periodic || start_step)) {
+        std::cerr << "Multiple processes are not supported with multiple threads or instances, "
+                     "event-driven steps, periodicity detection or a start step\n";
+        return 1;
+    }
+
+    if (pools && (threads > 1 || events || instances || block || processes > 1)) {
+        std::cerr << "Module pools are supported only with a single thread and instance, "
+                     "without event-driven steps, block processing or multiple processes\n";
+        return 1;
+    }
+
+    if (instances && wiring == Wiring::Alias) {
+        std::cerr << "Aliased wiring is not supported with multiple instances\n";
+        return 1;
+    }
+
+    uint64_t seed;
+    if (seed_str.empty() || seed_str.find_first_not_of("0123456789") != string::npos) {
+        std::cerr << "Invalid seed \"" << seed_str << "\"! Please specify non-negative number\n";
+        return 1;
+    }
+    try {
+        seed = std::stoull(seed_str);
+    }
+    catch (const std::out_of_range&) {
+        std::cerr << "Invalid seed \"" << seed_str << "\"! Please specify number below 2^64\n";
+        return 1;
+    }
+
+    double tolerance;
+    try {
+        tolerance = std::stod(tolerance_str);
+    }
+    catch (const std::exception&) {
+        tolerance = -1;
+    }
+    if (!(tolerance >= 0)) {
+        std::cerr << "Invalid tolerance \"" << tolerance_str << "\"! Please specify non-negative number\n";
+        return 1;
+    }
+
+    if ((run || exec) && output_type != "silent" && output_type != "csv" && output_type != "excel" && output_type != "plain") {
+        std::cerr << "Invalid interface \"" << output_type << "\"! Please specify csv, excel or plain\n";
+        return 1;
+    }
+
+    // A lowered program is run without the netlist, its nets are checked by the program
+    if (exec) {
+        try {
+            std::unique_ptr<Bytecode> program = Bytecode::map(program_file);
+            std::vector<string> net_watch;
+            std::istringstream in(to_watch);
+            for (string net; getline(in, net, ','); ) {
+                if (!program->findNet(net)) {
+                    std::cerr << "Invalid net watch list:\n\t\"" << net << "\" is not a valid net name.\n";
+                    return 1;
+                }
+                net_watch.push_back(net);
+            }
+            BytecodeMachine machine(*program);
+            machine.run(step_num, output_type, net_watch, std::cout);
+        }
+        catch (const std::exception& e) {
+            std::cerr << "Simulation aborted: " << e.what() << "\n";
+            return 1;
+        }
+        return 0;
+    }
+
     std::ifstream filein(in_file);
     if (!filein.is_open()) {
         std::cerr << "Cannot open input file " << in_file << "!\n";
         return 1;
     }
 
-    std::ofstream fileout(out_file);
-    if (!fileout.is_open()) {
+    // The interpreter writes the output of the simulation directly
+    std::ofstream fileout;
+    if (!run)
+        fileout.open(out_file, bytecode ? std::ios::out | std::ios::binary : std::ios::out);
+    if (!run && !fileout.is_open()) {
         std::cerr << "Cannot open output file " << out_file << "!\n";
         return 1;
     }
@@ -327,6 +1816,8 @@ int main(int argc, char* argv[]) {
     
     ParsedFile parsedFile = res.right();
     auto errors = typeCheck(parsedFile, modules);
+    if (errors.empty())
+        errors = checkLookupTables(parsedFile, tolerance, std::cerr);
     
     if (!errors.empty()) {
         std::cerr << "Could not produce .cpp file, following errors occurred:\n\n";
@@ -335,6 +1826,71 @@ int main(int argc, char* argv[]) {
         return 1;
     }
 
+    if (instances) {
+        bool batched = true;
+        for (const auto& d : parsedFile.declarations) {
+            bool randomBits = d.type == "ModuleRand" && d.template_args == std::vector<string>{"BOOL"};
+            if (!batchedModules.count(d.type) && !randomBits) {
+                std::cerr << "On line " << d.line << ": " << d.type
+                          << " cannot be simulated in multiple instances\n";
+                batched = false;
+            }
+        }
+        if (!batched)
+            return 1;
+    }
+
+    if (block) {
+        bool blocked = true;
+        for (const auto& d : parsedFile.declarations) {
+            if (!blockModules.count(d.type)) {
+                std::cerr << "On line " << d.line << ": " << d.type
+                          << " cannot be processed in blocks\n";
+                blocked = false;
+            }
+        }
+        if (!blocked)
+            return 1;
+    }
+
+    if (block && (!parsedFile.rates.empty() || !parsedFile.enables.empty())) {
+        std::cerr << "Block processing is not supported with rate dividers or enable groups\n";
+        return 1;
+    }
+
+    if (periodic) {
+        bool comparable = true;
+        for (const auto& d : parsedFile.declarations) {
+            if (!periodicModules.count(d.type) && !moduleInfo[d.type].pure && d.type != "ModuleInstance") {
+                std::cerr << "On line " << d.line << ": state of " << d.type
+                          << " cannot be checked for periodicity\n";
+                comparable = false;
+            }
+        }
+        if (!comparable)
+            return 1;
+        if (!parsedFile.rates.empty()) {
+            std::cerr << "Periodicity detection is not supported with rate dividers\n";
+            return 1;
+        }
+    }
+
+    if (!parsedFile.rates.empty() && (threads > 1 || events)) {
+        std::cerr << "Rate dividers are supported only with a single thread and without event-driven steps\n";
+        return 1;
+    }
+
+    if ((!parsedFile.rates.empty() || !parsedFile.enables.empty()) && processes > 1) {
+        std::cerr << "Multiple processes are not supported with rate dividers or enable groups\n";
+        return 1;
+    }
+
+    if (!parsedFile.enables.empty() && (threads > 1 || events || instances)) {
+        std::cerr << "Enable groups are supported only with a single thread and instance "
+                     "and without event-driven steps\n";
+        return 1;
+    }
+
     std::vector<std::string> net_watch;
     bool valid;
     std::tie(net_watch, valid) = nets_to_watch(to_watch, parsedFile);
@@ -345,12 +1901,72 @@ int main(int argc, char* argv[]) {
         return 1;
     }
 
-    fileout << generateHeaders(embed_lib)
+    if (run) {
+        std::vector<ParseError> unsupported;
+        Interpreter interpreter(parsedFile, seed, unsupported);
+        if (!unsupported.empty()) {
+            std::cerr << "Could not build the system, following errors occurred:\n\n";
+            print_error_messages(std::cerr, unsupported, vecs);
+            return 1;
+        }
+        try {
+            interpreter.run(step_num, output_type, net_watch, std::cout);
+        }
+        catch (const std::exception& e) {
+            std::cerr << "Simulation aborted: " << e.what() << "\n";
+            return 1;
+        }
+        return 0;
+    }
+
+    if (bytecode) {
+        std::vector<ParseError> unsupported;
+        std::vector<char> image = lowerToBytecode(parsedFile, seed, unsupported);
+        if (!unsupported.empty()) {
+            std::cerr << "Could not lower the netlist, following errors occurred:\n\n";
+            print_error_messages(std::cerr, unsupported, vecs);
+            return 1;
+        }
+        fileout.write(image.data(), image.size());
+        return fileout.good() ? 0 : 1;
+    }
+
+    if (lazy && net_watch.empty()) {
+        std::cerr << "Lazy evaluation needs nets to watch\n";
+        return 1;
+    }
+
+    ParsedFile generated = lazy ? pruneToCone(parsedFile, net_watch) : parsedFile;
+    FastForward fastForward;
+    if (start_step)
+        fastForward = planFastForward(generated, start_step, std::cerr);
+    Pipeline pipeline(generated, lag ? threads : 1, lag);
+    Lanes lanes = block ? Lanes(block, "block") : Lanes(instances);
+    fileout << generateHeaders(embed_lib, lanes, compact_maybe, threads > 1, processes > 1, periodic, pools)
             << "int main(int argc, char* argv[]){\n"
-            << parsedFile.generateCode(modules, nets);
-    fileout << generate_output(output_type, nets, net_watch)
-            << generateSystemSteps(parsedFile.declarations, nets, net_watch, step_num)
-            << tabs(1) << "return 0;\n" << "}\n";
+            << pipeline.generateChannels(modules, net_watch)
+            << (pools ? Pools(Dataflow(generated), schedule).generateDeclarations(Dataflow(generated)) : "")
+            << generated.generateCode(modules, nets, lanes, pipeline.rewiring(), !pools)
+            << (block ? generateBlockAliasing(Dataflow(generated))
+                      : generateNetAliasing(generated, schedule, wiring, threads, pools))
+            << generateSeeding(parsedFile, seed, generated);
+    fileout << generate_output(output_type, nets, net_watch, instances);
+    if (lag) {
+        Dataflow graph(generated);
+        fileout << pipeline.generateSteps(net_watch, step_num, wiring,
+            latchedNets(graph, schedule, true));
+    }
+    else if (block) {
+        fileout << generateBlockSteps(Dataflow(generated), net_watch, step_num, block);
+    }
+    else if (processes > 1) {
+        fileout << generateProcessSteps(generated, nets, net_watch, step_num, processes, std::cerr);
+    }
+    else {
+        fileout << generateSystemSteps(generated, nets, net_watch, step_num, schedule, wiring, threads,
+            events, periodic, fastForward, pools);
+    }
+    fileout << tabs(1) << "return 0;\n" << "}\n";
                 
     if (!fileout.good()) {
         std::cerr << "Cannot write to output file " << out_file << "!\n";
@@ -13,6 +13,7 @@ namespace cpplink { namespace translator {
 
 extern std::map<std::string, DataType> _types;
 extern std::map<std::string, std::string> typeToStr;
+extern std::map<std::string, std::string> functionToStr;
 
 /*
  * Specifies modules & types of their pins:
@@ -0,0 +1,508 @@
+#include "schedule.h"
+#include "typechecker.h"
+
+#include <algorithm>
+#include <limits>
+
+namespace cpplink { namespace translator {
+
+template <typename T>
+static void pushUnique(std::vector<T>& v, const T& t) {
+    if (std::find(v.begin(), v.end(), t) == v.end())
+        v.push_back(t);
+}
+
+static size_t gcd(size_t a, size_t b) {
+    while (b) {
+        size_t t = a % b;
+        a = b;
+        b = t;
+    }
+    return a;
+}
+
+Dataflow::Dataflow(const ParsedFile& file) {
+    for (const auto& d : file.declarations) {
+        index.insert({ d.name, modules.size() });
+        modules.push_back(&d);
+    }
+    inputs.resize(modules.size());
+    outputs.resize(modules.size());
+    successors.resize(modules.size());
+    demand.resize(modules.size(), false);
+    rate.resize(modules.size(), 1);
+
+    for (const auto& r : file.rates) {
+        for (const auto& name : r.modules) {
+            auto m = index.find(name);
+            if (m != index.end())
+                rate[m->second] = r.divider;
+        }
+    }
+
+    group.resize(modules.size(), 0);
+    for (const auto& e : file.enables) {
+        enableNets.push_back(e.net);
+        for (const auto& name : e.modules) {
+            auto m = index.find(name);
+            if (m != index.end())
+                group[m->second] = enableNets.size();
+        }
+    }
+
+    std::set<std::string> constants;
+    for (const auto& n : file.net_const)
+        constants.insert(n.net);
+
+    std::set<std::string> netNames;
+    for (const auto& n : file.net_pin) {
+        auto m = index.find(n.module);
+        if (constants.count(n.net) || m == index.end())
+            continue;
+        netNames.insert(n.net);
+        if (n.is_out) {
+            driver[n.net] = m->second;
+            pushUnique(outputs[m->second], n.net);
+        } else {
+            pushUnique(inputs[m->second], n.net);
+            Pin pin;
+            if (findPin(modules[m->second], n.pin, pin) && pin.demand) {
+                demand[m->second] = true;
+                demandNets.insert(n.net);
+            }
+        }
+    }
+    nets.assign(netNames.begin(), netNames.end());
+
+    for (size_t m = 0; m < modules.size(); m++) {
+        for (const auto& net : inputs[m]) {
+            auto d = driver.find(net);
+            if (d != driver.end())
+                successors[d->second].insert(m);
+            auto r = netRate.find(net);
+            if (r == netRate.end())
+                netRate.insert({ net, rate[m] });
+            else
+                r->second = gcd(r->second, rate[m]);
+            auto g = netGroup.find(net);
+            if (g == netGroup.end())
+                netGroup.insert({ net, group[m] });
+            else if (g->second != group[m])
+                g->second = 0;
+        }
+    }
+}
+
+std::vector<std::vector<size_t>> stronglyConnectedComponents(const Dataflow& graph) {
+    // Iterative Tarjan's algorithm, netlists can be too deep for recursion
+    const size_t none = std::numeric_limits<size_t>::max();
+    size_t count = graph.modules.size();
+    std::vector<size_t> order(count, none), low(count, 0);
+    std::vector<bool> onStack(count, false);
+    std::vector<size_t> stack;
+    std::vector<std::vector<size_t>> components;
+    size_t counter = 0;
+
+    using Frame = std::pair<size_t, std::set<size_t>::const_iterator>;
+    for (size_t root = 0; root < count; root++) {
+        if (order[root] != none)
+            continue;
+        std::vector<Frame> frames{{ root, graph.successors[root].begin() }};
+        order[root] = low[root] = counter++;
+        stack.push_back(root);
+        onStack[root] = true;
+
+        while (!frames.empty()) {
+            size_t v = frames.back().first;
+            auto& it = frames.back().second;
+            if (it != graph.successors[v].end()) {
+                size_t w = *it++;
+                if (order[w] == none) {
+                    order[w] = low[w] = counter++;
+                    stack.push_back(w);
+                    onStack[w] = true;
+                    frames.push_back({ w, graph.successors[w].begin() });
+                } else if (onStack[w]) {
+                    low[v] = std::min(low[v], order[w]);
+                }
+                continue;
+            }
+
+            frames.pop_back();
+            if (!frames.empty())
+                low[frames.back().first] = std::min(low[frames.back().first], low[v]);
+            if (low[v] != order[v])
+                continue;
+
+            std::vector<size_t> component;
+            size_t w;
+            do {
+                w = stack.back();
+                stack.pop_back();
+                onStack[w] = false;
+                component.push_back(w);
+            } while (w != v);
+            std::sort(component.begin(), component.end());
+            components.push_back(std::move(component));
+        }
+    }
+
+    // Order the condensed graph topologically, ties are broken by the
+    // declaration order so independent modules keep their netlist order
+    std::vector<size_t> componentOf(count);
+    for (size_t c = 0; c < components.size(); c++)
+        for (size_t m : components[c])
+            componentOf[m] = c;
+
+    std::vector<size_t> indegree(components.size(), 0);
+    std::vector<std::set<size_t>> edges(components.size());
+    for (size_t m = 0; m < count; m++) {
+        for (size_t s : graph.successors[m]) {
+            if (componentOf[s] != componentOf[m] && edges[componentOf[m]].insert(componentOf[s]).second)
+                indegree[componentOf[s]]++;
+        }
+    }
+
+    // Components are keyed by their first (lowest) module index
+    std::set<std::pair<size_t, size_t>> ready;
+    for (size_t c = 0; c < components.size(); c++)
+        if (indegree[c] == 0)
+            ready.insert({ components[c].front(), c });
+
+    std::vector<std::vector<size_t>> res;
+    while (!ready.empty()) {
+        size_t c = ready.begin()->second;
+        ready.erase(ready.begin());
+        for (size_t s : edges[c])
+            if (--indegree[s] == 0)
+                ready.insert({ components[s].front(), s });
+        res.push_back(std::move(components[c]));
+    }
+    return res;
+}
+
+std::vector<size_t> topologicalOrder(const Dataflow& graph) {
+    std::vector<size_t> res;
+    for (const auto& component : stronglyConnectedComponents(graph))
+        res.insert(res.end(), component.begin(), component.end());
+    return res;
+}
+
+std::vector<size_t> dataflowLevels(const Dataflow& graph) {
+    auto components = stronglyConnectedComponents(graph);
+    std::vector<size_t> componentOf(graph.modules.size());
+    for (size_t c = 0; c < components.size(); c++)
+        for (size_t m : components[c])
+            componentOf[m] = c;
+
+    // Components come in topological order, so all predecessors of a
+    // component raised its level before it is visited
+    std::vector<size_t> res(graph.modules.size(), 0);
+    for (const auto& component : components) {
+        size_t level = 0;
+        for (size_t m : component)
+            level = std::max(level, res[m]);
+        for (size_t m : component) {
+            res[m] = level;
+            for (size_t s : graph.successors[m])
+                if (componentOf[s] != componentOf[m])
+                    res[s] = std::max(res[s], level + 1);
+        }
+    }
+    return res;
+}
+
+std::vector<size_t> stepOrder(const Dataflow& graph, Schedule schedule) {
+    if (schedule == Schedule::Topological)
+        return topologicalOrder(graph);
+
+    // Modules with demand pins go first, so they can read most of their
+    // inputs before the drivers step
+    std::vector<size_t> res;
+    for (size_t m = 0; m < graph.modules.size(); m++)
+        if (graph.demand[m])
+            res.push_back(m);
+    for (size_t m = 0; m < graph.modules.size(); m++)
+        if (!graph.demand[m])
+            res.push_back(m);
+    std::stable_sort(res.begin(), res.end(), [&](size_t a, size_t b) {
+        return std::make_pair(graph.rate[a], graph.group[a]) < std::make_pair(graph.rate[b], graph.group[b]);
+    });
+    return res;
+}
+
+std::set<std::string> latchedNets(const Dataflow& graph, Schedule schedule, bool concurrent) {
+    std::vector<size_t> position(graph.modules.size());
+    auto order = stepOrder(graph, schedule);
+    for (size_t i = 0; i < order.size(); i++)
+        position[order[i]] = i;
+
+    // Span of positions from the propagation of a net to its last reader
+    std::map<std::string, std::pair<size_t, size_t>> span;
+    for (size_t m = 0; m < graph.modules.size(); m++) {
+        for (const auto& net : graph.inputs[m]) {
+            auto it = span.find(net);
+            if (it == span.end())
+                span.insert({ net, { position[m], position[m] } });
+            else
+                it->second = { std::min(it->second.first, position[m]),
+                               std::max(it->second.second, position[m]) };
+        }
+    }
+
+    std::set<std::string> res;
+    for (const auto& s : span) {
+        auto d = graph.driver.find(s.first);
+        if (d == graph.driver.end())
+            continue;
+        // Two-phase schedule propagates all nets before the first module
+        size_t from = schedule == Schedule::TwoPhase ? 0 : s.second.first;
+        size_t driver = position[d->second];
+        if (concurrent || (driver >= from && driver <= s.second.second))
+            res.insert(s.first);
+    }
+    return res;
+}
+
+std::set<std::string> feedbackNets(const Dataflow& graph) {
+    std::vector<size_t> position(graph.modules.size());
+    auto order = topologicalOrder(graph);
+    for (size_t i = 0; i < order.size(); i++)
+        position[order[i]] = i;
+
+    std::set<std::string> res;
+    for (size_t m = 0; m < graph.modules.size(); m++) {
+        for (const auto& net : graph.inputs[m]) {
+            auto d = graph.driver.find(net);
+            if (d != graph.driver.end() && position[d->second] >= position[m])
+                res.insert(net);
+        }
+    }
+    return res;
+}
+
+size_t longestChain(const Dataflow& graph) {
+    if (!feedbackNets(graph).empty())
+        return 0;
+
+    std::vector<size_t> length(graph.modules.size(), 1);
+    size_t res = 0;
+    for (size_t m : topologicalOrder(graph)) {
+        res = std::max(res, length[m]);
+        for (size_t s : graph.successors[m])
+            length[s] = std::max(length[s], length[m] + 1);
+    }
+    return res;
+}
+
+double stepCost(const ModuleDeclaration& module) {
+    static const std::map<std::string, double> costs{
+        {"ModuleRand", 3}, {"ModuleRandNormal", 4},
+        {"ModuleSin", 10}, {"ModuleCos", 10}, {"ModuleTan", 12},
+        {"ModuleSinOsc", 2}, {"ModuleCosOsc", 2}, {"ModuleSaw", 2},
+        {"ModuleLog", 10}, {"ModulePow", 15}, {"ModuleSqrt", 3},
+        {"ModuleDiv", 2}, {"ModuleMod", 2},
+        {"ModuleLUT", 2}, {"ModuleLUTCubic", 3},
+        {"ModuleAvg", 3}, {"ModuleMovingAvg", 3}};
+
+    auto it = costs.find(module.type);
+    return it == costs.end() ? 1 : it->second;
+}
+
+std::vector<size_t> balancedPartition(const std::vector<double>& costs, size_t parts) {
+    double total = 0;
+    for (double c : costs)
+        total += c;
+
+    // Every item belongs to the range containing the midpoint of its cost
+    std::vector<size_t> res{ 0 };
+    double prefix = 0;
+    for (size_t i = 0; i < costs.size(); i++) {
+        double mid = prefix + costs[i] / 2;
+        while (res.size() < parts && mid >= total * res.size() / parts)
+            res.push_back(i);
+        prefix += costs[i];
+    }
+    while (res.size() <= parts)
+        res.push_back(costs.size());
+    return res;
+}
+
+std::vector<size_t> pipelineThreads(const Dataflow& graph, size_t threads) {
+    std::vector<size_t> order = topologicalOrder(graph);
+    std::vector<double> costs;
+    for (size_t m : order)
+        costs.push_back(stepCost(*graph.modules[m]));
+
+    std::vector<size_t> ranges = balancedPartition(costs, threads);
+    std::vector<size_t> res(graph.modules.size());
+    for (size_t t = 0; t < threads; t++)
+        for (size_t i = ranges[t]; i < ranges[t + 1]; i++)
+            res[order[i]] = t;
+    return res;
+}
+
+// Modules reading every net
+static std::map<std::string, std::set<size_t>> netReaders(const Dataflow& graph) {
+    std::map<std::string, std::set<size_t>> res;
+    for (size_t m = 0; m < graph.modules.size(); m++)
+        for (const auto& net : graph.inputs[m])
+            res[net].insert(m);
+    return res;
+}
+
+// Partitions reading a net besides the one of its driver
+static size_t netCut(const Dataflow& graph, const std::map<std::string, std::set<size_t>>& readers,
+    const std::string& net, const std::vector<size_t>& part)
+{
+    auto d = graph.driver.find(net);
+    auto r = readers.find(net);
+    if (d == graph.driver.end() || r == readers.end())
+        return 0;
+    std::set<size_t> parts;
+    for (size_t m : r->second)
+        parts.insert(part[m]);
+    return parts.size() - parts.count(part[d->second]);
+}
+
+size_t partitionCut(const Dataflow& graph, const std::vector<size_t>& part) {
+    auto readers = netReaders(graph);
+    size_t res = 0;
+    for (const auto& d : graph.driver)
+        res += netCut(graph, readers, d.first, part);
+    return res;
+}
+
+std::vector<size_t> processPartition(const Dataflow& graph, size_t parts) {
+    auto order = topologicalOrder(graph);
+    std::vector<double> prefix{ 0 };
+    double largest = 0;
+    for (size_t m : order) {
+        double c = stepCost(*graph.modules[m]);
+        prefix.push_back(prefix.back() + c);
+        largest = std::max(largest, c);
+    }
+    double total = prefix.back();
+
+    // Ranges of the topological order end at the prefix of cost closest to
+    // their share of the total. Every range keeps a module as long as there
+    // are enough of them, so only trailing partitions of a netlist with
+    // fewer modules than parts are empty
+    std::vector<size_t> res(order.size());
+    std::vector<size_t> size(parts, 0);
+    std::vector<double> cost(parts, 0);
+    size_t begin = 0;
+    for (size_t p = 0; p < parts; p++) {
+        size_t end = order.size();
+        if (p + 1 < parts) {
+            size_t later = parts - p - 1;
+            size_t lo = std::min(begin + 1, order.size());
+            size_t hi = order.size() >= lo + later ? order.size() - later : lo;
+            double share = total * (p + 1) / parts;
+            end = std::lower_bound(prefix.begin() + lo, prefix.begin() + hi, share) - prefix.begin();
+            if (end > lo && share - prefix[end - 1] <= prefix[end] - share)
+                end--;
+        }
+        for (size_t i = begin; i < end; i++) {
+            res[order[i]] = p;
+            size[p]++;
+            cost[p] += prefix[i + 1] - prefix[i];
+        }
+        begin = end;
+    }
+    double limit = std::max(1.1 * total / parts, total / parts + largest);
+    double lower = 2 * total / parts - limit;
+
+    auto readers = netReaders(graph);
+
+    // Greedy moves of single modules to the partition of a neighbour, as long
+    // as some of them lowers the cut
+    bool moved = true;
+    for (size_t pass = 0; moved && pass < 16; pass++) {
+        moved = false;
+        for (size_t m : order) {
+            std::vector<std::string> touched = graph.inputs[m];
+            touched.insert(touched.end(), graph.outputs[m].begin(), graph.outputs[m].end());
+            auto cut = [&]() {
+                size_t c = 0;
+                for (const auto& net : touched)
+                    c += netCut(graph, readers, net, res);
+                return c;
+            };
+
+            std::set<size_t> candidates;
+            for (const auto& net : graph.outputs[m]) {
+                auto r = readers.find(net);
+                if (r != readers.end())
+                    for (size_t reader : r->second)
+                        candidates.insert(res[reader]);
+            }
+            for (const auto& net : graph.inputs[m]) {
+                auto d = graph.driver.find(net);
+                if (d != graph.driver.end())
+                    candidates.insert(res[d->second]);
+            }
+
+            size_t from = res[m];
+            double c = stepCost(*graph.modules[m]);
+            if (size[from] == 1 || cost[from] - c < lower)
+                continue;
+            size_t best = from, bestCut = cut();
+            for (size_t to : candidates) {
+                if (to == from || cost[to] + c > limit)
+                    continue;
+                res[m] = to;
+                size_t moveCut = cut();
+                if (moveCut < bestCut) {
+                    best = to;
+                    bestCut = moveCut;
+                }
+            }
+            res[m] = best;
+            if (best != from) {
+                size[from]--;
+                size[best]++;
+                cost[from] -= c;
+                cost[best] += c;
+                moved = true;
+            }
+        }
+    }
+    return res;
+}
+
+std::set<size_t> coneOfInfluence(const Dataflow& graph, const std::vector<std::string>& nets) {
+    std::set<size_t> cone;
+    std::vector<size_t> stack;
+    auto visit = [&](size_t m) {
+        if (cone.insert(m).second)
+            stack.push_back(m);
+    };
+
+    for (const auto& net : nets) {
+        auto d = graph.driver.find(net);
+        if (d != graph.driver.end()) {
+            visit(d->second);
+            continue;
+        }
+        for (size_t m = 0; m < graph.modules.size(); m++)
+            if (std::count(graph.inputs[m].begin(), graph.inputs[m].end(), net))
+                visit(m);
+    }
+
+    while (!stack.empty()) {
+        size_t m = stack.back();
+        stack.pop_back();
+        std::vector<std::string> read = graph.inputs[m];
+        if (graph.group[m])
+            read.push_back(graph.enableNets[graph.group[m] - 1]);
+        for (const auto& net : read) {
+            auto d = graph.driver.find(net);
+            if (d != graph.driver.end())
+                visit(d->second);
+        }
+    }
+    return cone;
+}
+
+}}
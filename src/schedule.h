@@ -0,0 +1,145 @@
+#pragma once
+
+#include "translator.h"
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+namespace cpplink { namespace translator {
+
+/*
+ * Order of module and net steps within a single tick:
+ * TwoPhase    - all nets are propagated first, then all modules are stepped.
+ *               Every module sees values produced in the previous tick.
+ * Topological - modules are stepped in dataflow order, each right after its
+ *               input nets are propagated. Values flow through a feed-forward
+ *               chain within a single tick, only feedback loops keep the
+ *               one tick delay.
+ */
+enum class Schedule { TwoPhase, Topological };
+
+/*
+ * How nets deliver values to input pins:
+ * Copy  - every net copies the value of its output pin into all input pins.
+ * Alias - input pins read the output pin directly. Only nets whose readers
+ *         would observe the driver's current value too early are latched,
+ *         which is a single copy per tick regardless of the fanout.
+ */
+enum class Wiring { Copy, Alias };
+
+/*
+ * Module -> net -> module graph of a netlist. Nets driven by constants are
+ * not part of the graph as they are wired only once and never propagated.
+ */
+struct Dataflow {
+    Dataflow(const ParsedFile& file);
+
+    std::vector<const ModuleDeclaration*> modules;  // in declaration order
+    std::map<std::string, size_t> index;            // module name -> position in modules
+    std::map<std::string, size_t> driver;           // net -> driving module
+    std::vector<std::string> nets;                  // all propagated nets, sorted by name
+    std::vector<std::vector<std::string>> inputs;   // module -> nets read by the module
+    std::vector<std::vector<std::string>> outputs;  // module -> nets driven by the module
+    std::vector<std::set<size_t>> successors;       // module -> modules reading its outputs
+    std::vector<bool> demand;                       // module -> has demand input pins
+    std::set<std::string> demandNets;               // nets read by a demand pin
+    std::vector<size_t> rate;                       // module -> steps only in every rate-th tick
+    std::map<std::string, size_t> netRate;          // net -> gcd of the rates of its readers
+    std::vector<std::string> enableNets;            // enable group -> net enabling it
+    std::vector<size_t> group;                      // module -> 1 + its enable group, 0 for none
+    std::map<std::string, size_t> netGroup;         // net -> group of all its readers, 0 if they differ
+};
+
+/*
+ * Strongly connected components of the module graph in topological order,
+ * modules inside a component are sorted by their declaration order.
+ */
+std::vector<std::vector<size_t>> stronglyConnectedComponents(const Dataflow& graph);
+
+/*
+ * Modules in the order they should be stepped in the topological schedule.
+ */
+std::vector<size_t> topologicalOrder(const Dataflow& graph);
+
+/*
+ * Level of every module in the graph of strongly connected components - 0
+ * for components without predecessors, one more than the highest level of a
+ * preceding component otherwise. Modules of a component share its level,
+ * components of the same level do not read from each other.
+ */
+std::vector<size_t> dataflowLevels(const Dataflow& graph);
+
+/*
+ * Modules in the order they are stepped by the given schedule. Modules are
+ * independent within the two-phase schedule, they are grouped by their rates
+ * and enable groups there and modules with demand pins are stepped first
+ * within a group.
+ */
+std::vector<size_t> stepOrder(const Dataflow& graph, Schedule schedule);
+
+/*
+ * Nets which cannot be read through an alias of their output pin with the
+ * given schedule - the driving module steps between the point where the net
+ * is propagated and the point where one of its readers steps. Concurrently
+ * stepped modules have no order, so every net read by a module is latched.
+ */
+std::set<std::string> latchedNets(const Dataflow& graph, Schedule schedule, bool concurrent = false);
+
+/*
+ * Nets whose readers see the value of the previous tick with the topological
+ * schedule - the driver steps after the first reader, closing a feedback loop.
+ */
+std::set<std::string> feedbackNets(const Dataflow& graph);
+
+/*
+ * Number of modules on the longest chain of the module graph, a value of a
+ * module reaches every module behind it within that many ticks with either
+ * schedule. Returns 0 for a graph with feedback loops.
+ */
+size_t longestChain(const Dataflow& graph);
+
+/*
+ * Rough relative cost of a step of the module, a copy of a value costs 0.5.
+ */
+double stepCost(const ModuleDeclaration& module);
+
+/*
+ * Splits items with the given costs into `parts` contiguous ranges of similar
+ * total cost, so neighbouring items stay together. Returns the first item of
+ * every range followed by the number of items, ranges may be empty.
+ */
+std::vector<size_t> balancedPartition(const std::vector<double>& costs, size_t parts);
+
+/*
+ * Thread of every module in pipelined execution. Modules are split into
+ * ranges of the topological order, so chains mostly stay within a thread and
+ * values flow forward between threads.
+ */
+std::vector<size_t> pipelineThreads(const Dataflow& graph, size_t threads);
+
+/*
+ * Partition of every module for a simulation in several processes, which
+ * exchange values of nets crossing partitions in every tick. Ranges of the
+ * topological order balanced by cost are refined by moving single modules
+ * to partitions of their neighbours while that lowers the cut and keeps the
+ * cost of every partition within 10 % of the average, or the cost of a
+ * single module for small netlists. No partition is emptied, a netlist with
+ * fewer modules than parts leaves only the last partitions empty.
+ */
+std::vector<size_t> processPartition(const Dataflow& graph, size_t parts);
+
+/*
+ * Cut of a partition on net fanout - the number of partitions reading a net
+ * besides the one of its driver, summed over all nets.
+ */
+size_t partitionCut(const Dataflow& graph, const std::vector<size_t>& part);
+
+/*
+ * Modules whose steps influence values of the given nets: their drivers and
+ * transitively the drivers of all nets read by modules in the cone or enabling
+ * them. A net without a driver brings in its readers instead.
+ */
+std::set<size_t> coneOfInfluence(const Dataflow& graph, const std::vector<std::string>& nets);
+
+}}
@@ -93,6 +93,16 @@ parse_file(const std::vector<std::string>& file)
                 statement.get<GenericDeclaration>(),
                 line_num));
         }
+        else if (statement.is<RateCommand>()) {
+            result.rates.push_back(add_line_num(
+                statement.get<RateCommand>(),
+                line_num));
+        }
+        else if (statement.is<EnableCommand>()) {
+            result.enables.push_back(add_line_num(
+                statement.get<EnableCommand>(),
+                line_num));
+        }
         else {
             assert(false && "Unknown type in union!");
         }
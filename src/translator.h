@@ -15,7 +15,9 @@ auto operator<<(std::ostream& o, const T& t) -> decltype(t.dump(o), std::declval
     return o;
 }
 
-enum DataType {Int = 0, Real = 1, Bool = 2, Template = 3}; 
+// Template arguments given as literals: Natural is a positive integer,
+// Decimal a real number and Function a name of a tabulated function
+enum DataType {Int = 0, Real = 1, Bool = 2, Template = 3, Natural = 4, Decimal = 5, Function = 6}; 
 enum class Direction {In, Out};
 
 const std::vector<std::string> DataTypeToString{"int64_t","double","bool"};
@@ -24,16 +26,20 @@ struct Pin {
 
     Pin(){}
 
-    Pin(DataType typ, Direction d, unsigned pos=0)
+    Pin(DataType typ, Direction d, unsigned pos=0, unsigned width=0, bool demand=false)
         :
           type(typ),
           dir(d),
-          pos(pos)
+          pos(pos),
+          width(width),
+          demand(demand)
     {}
 
     DataType type;
     Direction dir;
     unsigned pos;
+    unsigned width;  // array of pins sized by this template argument, named pin0, pin1...
+    bool demand;     // input pins aliased instead of copied by nets
 };
 
 struct PrimitiveModule {
@@ -42,16 +48,19 @@ struct PrimitiveModule {
 
     PrimitiveModule(unsigned count,
                     std::vector<std::vector<DataType>> allowed,
-                    std::map<std::string, Pin> pins)
+                    std::map<std::string, Pin> pins,
+                    bool pure=false)
         :
           templates_count(count),
           allowed_types(allowed),
-          pins(pins)
+          pins(pins),
+          pure(pure)
     {}
 
     unsigned templates_count;
     std::vector<std::vector<DataType>> allowed_types;
     std::map<std::string, Pin> pins;
+    bool pure;  // outputs depend only on the current inputs, no state
 };
 
 struct Net {
@@ -60,6 +69,21 @@ struct Net {
     std::string type;
 };
 
+/*
+ * Pins holding several values at once - lanes of instances simulated in a
+ * batch or ticks processed in a block. Library types of such pins and modules
+ * live in the namespace `ns`, plain pins have no lanes.
+ */
+struct Lanes {
+    Lanes(size_t count = 0, std::string ns = "batch") : count(count), ns(ns) {}
+
+    size_t count;
+    std::string ns;
+
+    explicit operator bool() const { return count != 0; }
+    std::string prefix() const { return count ? ns + "::" : ""; }
+};
+
 struct ModuleDeclaration {
     std::string type;
     std::string name;
@@ -74,7 +98,9 @@ struct ModuleDeclaration {
         o << ">\n";
     }
 
-    std::string generateCode() const;
+    std::string generateCode(const Lanes& lanes = {}) const;
+    std::string generateType(const Lanes& lanes = {}) const;
+    std::string generateConstructorArgs() const;
 };
 
 struct NetPinCommand {
@@ -91,6 +117,7 @@ struct NetPinCommand {
     }
 
     std::string generateCode() const;
+    std::string generateDemandCode() const;
 };
 
 struct NetConstCommand {
@@ -145,6 +172,37 @@ struct GenericDeclaration {
     }
 };
 
+// Modules stepped only in every divider-th tick
+struct RateCommand {
+    int64_t divider;
+    std::vector<std::string> modules;
+    size_t line;
+
+    void dump(std::ostream& o) const {
+        o << line << ": RateCommand: " << divider;
+        for (const auto& m : modules)
+            o << " " << m;
+        o << "\n";
+    }
+};
+
+// Modules stepped only while the enable net is valid and true, the policy
+// is either "hold" (outputs keep their values) or "reset" (outputs are
+// nothing while disabled)
+struct EnableCommand {
+    std::string net;
+    std::string policy;
+    std::vector<std::string> modules;
+    size_t line;
+
+    void dump(std::ostream& o) const {
+        o << line << ": EnableCommand: " << net << " " << policy;
+        for (const auto& m : modules)
+            o << " " << m;
+        o << "\n";
+    }
+};
+
 struct ParsedFile {
     brick::types::Maybe<BlackboxCommand> blackbox_def;
     std::vector<ModuleDeclaration> declarations;
@@ -152,6 +210,8 @@ struct ParsedFile {
     std::vector<NetConstCommand> net_const;
     std::vector<IoPinDeclaration> io_pins;
     std::vector<GenericDeclaration> generics;
+    std::vector<RateCommand> rates;
+    std::vector<EnableCommand> enables;
     
     void dump(std::ostream& o) const {
         for (const auto& d : declarations)
@@ -162,8 +222,12 @@ struct ParsedFile {
             n.dump(o);
     }
 
+    // Input pins of (net, module) pairs in `rewired` are wired to the given
+    // object instead of the net
     std::string generateCode(std::map<std::string, const ModuleDeclaration*>&,
-        std::map<std::string, std::string> &) const;
+        std::map<std::string, std::string> &, const Lanes& lanes = {},
+        const std::map<std::pair<std::string, std::string>, std::string>& rewired = {},
+        bool declare = true) const;
 };
 
 struct ParseError {
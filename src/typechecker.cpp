@@ -6,6 +6,9 @@ namespace cpplink { namespace translator {
 std::map<std::string, DataType> _types{{"INT", Int},{"REAL", Real}, {"BOOL", Bool}};
 std::map<std::string, std::string> typeToStr{{"INT", "int64_t"},{"REAL", "double"}, {"BOOL", "bool"}};
 
+std::map<std::string, std::string> functionToStr{{"SQRT", "FuncSqrt"},{"LOG", "FuncLog"},
+    {"EXP", "FuncExp"},{"SIN", "FuncSin"},{"COS", "FuncCos"},{"TAN", "FuncTan"}};
+
 std::map<std::string, std::pair<DataType, std::string>> constDeclarations;
 
 std::map<std::string, PrimitiveModule> moduleInfo
@@ -13,9 +16,18 @@ std::map<std::string, PrimitiveModule> moduleInfo
     {"ModuleRand",
         PrimitiveModule(1, {{Int, Real, Bool}},
         {{"min",Pin(Template,Direction::In,1)},{"max",Pin(Template,Direction::In,1)},{"out",Pin(Template,Direction::Out,1)}})},
+    {"ModuleRandNormal",
+        PrimitiveModule(0, {},
+        {{"mean",Pin(Real,Direction::In)},{"stddev",Pin(Real,Direction::In)},{"out",Pin(Real,Direction::Out)}})},
     {"ModuleSin",
         PrimitiveModule(0, {},
         {{"amplitude",Pin(Real,Direction::In)},{"period",Pin(Real,Direction::In)},{"out",Pin(Real,Direction::Out)}})},
+    {"ModuleSinOsc",
+        PrimitiveModule(0, {},
+        {{"amplitude",Pin(Real,Direction::In)},{"period",Pin(Real,Direction::In)},{"out",Pin(Real,Direction::Out)}})},
+    {"ModuleCosOsc",
+        PrimitiveModule(0, {},
+        {{"amplitude",Pin(Real,Direction::In)},{"period",Pin(Real,Direction::In)},{"out",Pin(Real,Direction::Out)}})},
     {"ModuleSaw",
         PrimitiveModule(0, {},
         {{"amplitude",Pin(Real,Direction::In)},{"period",Pin(Real,Direction::In)},{"out",Pin(Real,Direction::Out)}})},
@@ -28,86 +40,104 @@ std::map<std::string, PrimitiveModule> moduleInfo
     {"ModuleLinear",
         PrimitiveModule(0, {},
         {{"out",Pin(Int,Direction::Out)}})},
+    {"ModuleInstance",
+        PrimitiveModule(0, {},
+        {{"out",Pin(Int,Direction::Out)}})},
     {"ModuleConvert",
         PrimitiveModule(2, {{Int,Real},{Int,Real}},
-        {{"in",Pin(Template,Direction::In,1)},{"out",Pin(Template,Direction::Out,2)}})},
+        {{"in",Pin(Template,Direction::In,1)},{"out",Pin(Template,Direction::Out,2)}}, true)},
     {"ModuleIdentity",
         PrimitiveModule(1, {{Int,Real,Bool}},
-        {{"in",Pin(Template,Direction::In,1)},{"out",Pin(Template,Direction::Out,1)}})},
+        {{"in",Pin(Template,Direction::In,1)},{"out",Pin(Template,Direction::Out,1)}}, true)},
     {"ModuleClamp",
         PrimitiveModule(1, {{Int,Real}},
-        {{"min",Pin(Template,Direction::In,1)},{"max",Pin(Template,Direction::In,1)},{"in",Pin(Template,Direction::In,1)},{"out",Pin(Template,Direction::Out,1)}})},
+        {{"min",Pin(Template,Direction::In,1)},{"max",Pin(Template,Direction::In,1)},{"in",Pin(Template,Direction::In,1)},{"out",Pin(Template,Direction::Out,1)}}, true)},
     {"ModuleSum",
         PrimitiveModule(1, {{Int,Real}},
-        {{"in1",Pin(Template,Direction::In,1)},{"in2",Pin(Template,Direction::In,1)},{"out",Pin(Template,Direction::Out,1)}})},
+        {{"in1",Pin(Template,Direction::In,1)},{"in2",Pin(Template,Direction::In,1)},{"out",Pin(Template,Direction::Out,1)}}, true)},
     {"ModuleDiff",
         PrimitiveModule(1, {{Int,Real}},
-        {{"in1",Pin(Template,Direction::In,1)},{"in2",Pin(Template,Direction::In,1)},{"out",Pin(Template,Direction::Out,1)}})},
+        {{"in1",Pin(Template,Direction::In,1)},{"in2",Pin(Template,Direction::In,1)},{"out",Pin(Template,Direction::Out,1)}}, true)},
     {"ModuleMult",
         PrimitiveModule(1, {{Int,Real}},
-        {{"in1",Pin(Template,Direction::In,1)},{"in2",Pin(Template,Direction::In,1)},{"out",Pin(Template,Direction::Out,1)}})},
+        {{"in1",Pin(Template,Direction::In,1)},{"in2",Pin(Template,Direction::In,1)},{"out",Pin(Template,Direction::Out,1)}}, true)},
     {"ModuleDiv",
         PrimitiveModule(1, {{Int,Real}},
-        {{"in1",Pin(Template,Direction::In,1)},{"in2",Pin(Template,Direction::In,1)},{"out",Pin(Template,Direction::Out,1)}})},
+        {{"in1",Pin(Template,Direction::In,1)},{"in2",Pin(Template,Direction::In,1)},{"out",Pin(Template,Direction::Out,1)}}, true)},
     {"ModuleMod",
         PrimitiveModule(1, {{Int,Real}},
-        {{"in1",Pin(Template,Direction::In,1)},{"in2",Pin(Template,Direction::In,1)},{"out",Pin(Template,Direction::Out,1)}})},
+        {{"in1",Pin(Template,Direction::In,1)},{"in2",Pin(Template,Direction::In,1)},{"out",Pin(Template,Direction::Out,1)}}, true)},
     {"ModuleLogicAnd",
         PrimitiveModule(0, {},
-        {{"in1",Pin(Bool,Direction::In)},{"in2",Pin(Bool,Direction::In)},{"out",Pin(Bool,Direction::Out)}})},
+        {{"in1",Pin(Bool,Direction::In)},{"in2",Pin(Bool,Direction::In)},{"out",Pin(Bool,Direction::Out)}}, true)},
     {"ModuleLogicOr",
         PrimitiveModule(0, {},
-        {{"in1",Pin(Bool,Direction::In)},{"in2",Pin(Bool,Direction::In)},{"out",Pin(Bool,Direction::Out)}})},
+        {{"in1",Pin(Bool,Direction::In)},{"in2",Pin(Bool,Direction::In)},{"out",Pin(Bool,Direction::Out)}}, true)},
     {"ModuleLogicXor",
         PrimitiveModule(0, {},
-        {{"in1",Pin(Bool,Direction::In)},{"in2",Pin(Bool,Direction::In)},{"out",Pin(Bool,Direction::Out)}})},
+        {{"in1",Pin(Bool,Direction::In)},{"in2",Pin(Bool,Direction::In)},{"out",Pin(Bool,Direction::Out)}}, true)},
     {"ModuleLogicImpl",
         PrimitiveModule(0, {},
-        {{"in1",Pin(Bool,Direction::In)},{"in2",Pin(Bool,Direction::In)},{"out",Pin(Bool,Direction::Out)}})},
+        {{"in1",Pin(Bool,Direction::In)},{"in2",Pin(Bool,Direction::In)},{"out",Pin(Bool,Direction::Out)}}, true)},
     {"ModuleLogicXnor",
         PrimitiveModule(0, {},
-        {{"in1",Pin(Bool,Direction::In)},{"in2",Pin(Bool,Direction::In)},{"out",Pin(Bool,Direction::Out)}})},
+        {{"in1",Pin(Bool,Direction::In)},{"in2",Pin(Bool,Direction::In)},{"out",Pin(Bool,Direction::Out)}}, true)},
     {"ModuleLogicNand",
         PrimitiveModule(0, {},
-        {{"in1",Pin(Bool,Direction::In)},{"in2",Pin(Bool,Direction::In)},{"out",Pin(Bool,Direction::Out)}})},
+        {{"in1",Pin(Bool,Direction::In)},{"in2",Pin(Bool,Direction::In)},{"out",Pin(Bool,Direction::Out)}}, true)},
     {"ModuleLogicNor",
         PrimitiveModule(0, {},
-        {{"in1",Pin(Bool,Direction::In)},{"in2",Pin(Bool,Direction::In)},{"out",Pin(Bool,Direction::Out)}})},
+        {{"in1",Pin(Bool,Direction::In)},{"in2",Pin(Bool,Direction::In)},{"out",Pin(Bool,Direction::Out)}}, true)},
     {"ModuleLess",
         PrimitiveModule(1, {{Int,Real}},
-        {{"in1",Pin(Template,Direction::In,1)},{"in2",Pin(Template,Direction::In,1)},{"out",Pin(Bool,Direction::Out)}})},
+        {{"in1",Pin(Template,Direction::In,1)},{"in2",Pin(Template,Direction::In,1)},{"out",Pin(Bool,Direction::Out)}}, true)},
     {"ModuleLessEqual",
         PrimitiveModule(1, {{Int,Real}},
-        {{"in1",Pin(Template,Direction::In,1)},{"in2",Pin(Template,Direction::In,1)},{"out",Pin(Bool,Direction::Out)}})},
+        {{"in1",Pin(Template,Direction::In,1)},{"in2",Pin(Template,Direction::In,1)},{"out",Pin(Bool,Direction::Out)}}, true)},
     {"ModuleGreater",
         PrimitiveModule(1, {{Int,Real}},
-        {{"in1",Pin(Template,Direction::In,1)},{"in2",Pin(Template,Direction::In,1)},{"out",Pin(Bool,Direction::Out)}})},
+        {{"in1",Pin(Template,Direction::In,1)},{"in2",Pin(Template,Direction::In,1)},{"out",Pin(Bool,Direction::Out)}}, true)},
     {"ModuleGreaterEqual",
         PrimitiveModule(1, {{Int,Real}},
-        {{"in1",Pin(Template,Direction::In,1)},{"in2",Pin(Template,Direction::In,1)},{"out",Pin(Bool,Direction::Out)}})},
+        {{"in1",Pin(Template,Direction::In,1)},{"in2",Pin(Template,Direction::In,1)},{"out",Pin(Bool,Direction::Out)}}, true)},
     {"ModuleEqual",
         PrimitiveModule(1, {{Int,Real}},
-        {{"in1",Pin(Template,Direction::In,1)},{"in2",Pin(Template,Direction::In,1)},{"out",Pin(Bool,Direction::Out)}})},
+        {{"in1",Pin(Template,Direction::In,1)},{"in2",Pin(Template,Direction::In,1)},{"out",Pin(Bool,Direction::Out)}}, true)},
     {"ModuleNotEqual",
         PrimitiveModule(1, {{Int,Real}},
-        {{"in1",Pin(Template,Direction::In,1)},{"in2",Pin(Template,Direction::In,1)},{"out",Pin(Bool,Direction::Out)}})},
+        {{"in1",Pin(Template,Direction::In,1)},{"in2",Pin(Template,Direction::In,1)},{"out",Pin(Bool,Direction::Out)}}, true)},
     {"ModuleInverse",
         PrimitiveModule(1, {{Int,Real}},
-        {{"in",Pin(Template,Direction::In,1)},{"out",Pin(Real,Direction::Out)}})},
+        {{"in",Pin(Template,Direction::In,1)},{"out",Pin(Real,Direction::Out)}}, true)},
     {"ModuleNegate",
         PrimitiveModule(1, {{Int,Real,Bool}},
-        {{"in",Pin(Template,Direction::In,1)},{"out",Pin(Template,Direction::Out,1)}})},
+        {{"in",Pin(Template,Direction::In,1)},{"out",Pin(Template,Direction::Out,1)}}, true)},
     {"ModuleLog",
         PrimitiveModule(0, {},
-        {{"base",Pin(Real,Direction::In)},{"in",Pin(Real,Direction::In)},{"out",Pin(Real,Direction::Out)}})},
+        {{"base",Pin(Real,Direction::In)},{"in",Pin(Real,Direction::In)},{"out",Pin(Real,Direction::Out)}}, true)},
     {"ModulePow",
         PrimitiveModule(0, {},
-        {{"base",Pin(Real,Direction::In)},{"exp",Pin(Real,Direction::In)},{"out",Pin(Real,Direction::Out)}})},
+        {{"base",Pin(Real,Direction::In)},{"exp",Pin(Real,Direction::In)},{"out",Pin(Real,Direction::Out)}}, true)},
     {"ModuleSqrt",
         PrimitiveModule(0, {},
-        {{"in",Pin(Real,Direction::In)},{"out",Pin(Real,Direction::Out)}})},
+        {{"in",Pin(Real,Direction::In)},{"out",Pin(Real,Direction::Out)}}, true)},
     {"ModuleAvg",
         PrimitiveModule(0, {},
+        {{"in",Pin(Real,Direction::In)},{"out",Pin(Real,Direction::Out)}})},
+    {"ModuleLUT",
+        PrimitiveModule(4, {{Function},{Natural,Decimal},{Natural,Decimal},{Natural}},
+        {{"in",Pin(Real,Direction::In)},{"out",Pin(Real,Direction::Out)}}, true)},
+    {"ModuleLUTCubic",
+        PrimitiveModule(4, {{Function},{Natural,Decimal},{Natural,Decimal},{Natural}},
+        {{"in",Pin(Real,Direction::In)},{"out",Pin(Real,Direction::Out)}}, true)},
+    {"ModuleMux",
+        PrimitiveModule(2, {{Int,Real,Bool},{Natural}},
+        {{"state",Pin(Int,Direction::In)},{"vals",Pin(Template,Direction::In,1,2)},{"out",Pin(Template,Direction::Out,1)}}, true)},
+    {"ModuleMuxDemand",
+        PrimitiveModule(2, {{Int,Real,Bool},{Natural}},
+        {{"state",Pin(Int,Direction::In)},{"vals",Pin(Template,Direction::In,1,2,true)},{"out",Pin(Template,Direction::Out,1)}}, true)},
+    {"ModuleMovingAvg",
+        PrimitiveModule(1, {{Natural}},
         {{"in",Pin(Real,Direction::In)},{"out",Pin(Real,Direction::Out)}})}
 };
 
@@ -115,8 +145,50 @@ std::map<std::string, Pin>& getPins(const ModuleDeclaration* mod) {
     return moduleInfo[mod->type].pins;
 }
 
+// Splits name of a pin from a pin array into the array name and index
+static bool splitPinIndex(const std::string& name, std::string& array, size_t& index) {
+    size_t digits = name.find_last_not_of("0123456789") + 1;
+    if (digits == 0 || digits == name.size() || (name[digits] == '0' && digits + 1 != name.size()))
+        return false;
+    array = name.substr(0, digits);
+    index = std::stoul(name.substr(digits));
+    return true;
+}
+
+bool findPin(const ModuleDeclaration* mod, const std::string& name, Pin& pin) {
+    auto& pins = getPins(mod);
+    auto it = pins.find(name);
+    if (it != pins.end() && !it->second.width) {
+        pin = it->second;
+        return true;
+    }
+
+    std::string array;
+    size_t index;
+    if (!splitPinIndex(name, array, index))
+        return false;
+    it = pins.find(array);
+    if (it == pins.end() || !it->second.width || mod->template_args.size() < it->second.width
+        || templateArgType(mod->template_args[it->second.width - 1]) != Natural)
+        return false;
+    if (index >= std::stoul(mod->template_args[it->second.width - 1]))
+        return false;
+    pin = it->second;
+    return true;
+}
+
+std::string pinAccess(const ModuleDeclaration* mod, const std::string& name) {
+    Pin pin;
+    std::string array;
+    size_t index;
+    if (findPin(mod, name, pin) && pin.width && splitPinIndex(name, array, index))
+        return array + "[" + std::to_string(index) + "]";
+    return name;
+}
+
 bool inferPinType(const ModuleDeclaration* mod, std::string pName, DataType& type){
-    Pin result = ((*(getPins(mod).find(pName))).second );
+    Pin result;
+    findPin(mod, pName, result);
     if (result.type != Template) {
         type = result.type;
         return true;
@@ -129,6 +201,25 @@ bool inferPinType(const ModuleDeclaration* mod, std::string pName, DataType& typ
 }
 
 
+// Kind of a template argument, Template for unknown arguments
+DataType templateArgType(const std::string& arg) {
+    auto type = _types.find(arg);
+    if (type != _types.end())
+        return type->second;
+    if (functionToStr.count(arg))
+        return Function;
+
+    auto digit = [](char c){ return c >= '0' && c <= '9'; };
+    if (!arg.empty() && std::all_of(arg.begin(), arg.end(), digit))
+        return arg[0] != '0' ? Natural : Decimal;
+    auto dot = arg.find('.');
+    if (dot != std::string::npos && dot > 0 && std::all_of(arg.begin(), arg.begin() + dot, digit)
+        && std::all_of(arg.begin() + dot + 1, arg.end(), digit))
+        return Decimal;
+    return Template;
+}
+
+
 void typeCheckModDecl(const ModuleDeclaration& d, std::vector<ParseError>& errors) {
     auto mod = moduleInfo.find(d.type);
 
@@ -147,7 +238,7 @@ void typeCheckModDecl(const ModuleDeclaration& d, std::vector<ParseError>& error
             for(size_t i = 0; i < providedTCount; i++) {
 
                 auto allowed = (*mod).second.allowed_types[i];
-                auto it = std::find( allowed.begin(), allowed.end(), _types[d.template_args[i]] );
+                auto it = std::find( allowed.begin(), allowed.end(), templateArgType(d.template_args[i]) );
 
                 if( it == allowed.end() )
                     errors.push_back(ParseError("Template parameter " + itos<int64_t>(i+1) +
@@ -216,14 +307,12 @@ std::vector<ParseError> typeCheck(ParsedFile& pf, DeclarationsMap& modules) {
                                             + itos<unsigned>((*it).second->line), n.line));
             }
 
-            auto pins = getPins((*modIt).second);
-            auto pinIt = pins.find(n.pin);
-
-            if ( pinIt == pins.end() ) {
+            Pin pin;
+            if (!findPin((*modIt).second, n.pin, pin)) {
                 errors.push_back(ParseError("Invalid pin name \"" + n.pin +
                                             "\" for module " + (*modIt).second->type, n.line));
             } else {
-                if (((*pinIt).second.dir == Direction::Out && !n.is_out) || ((*pinIt).second.dir == Direction::In && n.is_out)) {
+                if ((pin.dir == Direction::Out && !n.is_out) || (pin.dir == Direction::In && n.is_out)) {
                     errors.push_back(ParseError("Direction of the pin does not match.", n.line));
                 }
 
@@ -241,6 +330,56 @@ std::vector<ParseError> typeCheck(ParsedFile& pf, DeclarationsMap& modules) {
         }
     }
 
+    std::map<std::string, size_t> rated; // module -> line of its rate
+    for (const auto& r : pf.rates) {
+        if (r.divider < 1)
+            errors.push_back(ParseError("Rate divider has to be positive", r.line));
+        for (const auto& m : r.modules) {
+            if (modules.find(m) == modules.end()) {
+                errors.push_back(ParseError("Module with name \"" + m + "\" undeclared, cannot set its rate.", r.line));
+                continue;
+            }
+            auto it = rated.find(m);
+            if (it != rated.end())
+                errors.push_back(ParseError("Rate of module \"" + m + "\" redefined. "
+                                            "First defined: " + itos<size_t>(it->second), r.line));
+            else
+                rated.insert({ m, r.line });
+        }
+    }
+
+    std::map<std::string, size_t> grouped; // module -> line of its enable group
+    for (const auto& e : pf.enables) {
+        if (e.policy != "hold" && e.policy != "reset")
+            errors.push_back(ParseError("Unknown enable policy \"" + e.policy + "\", expected hold or reset", e.line));
+
+        bool driven = false;
+        for (const auto& n : pf.net_pin) {
+            auto modIt = modules.find(n.module);
+            DataType type;
+            if (n.net != e.net || !n.is_out || modIt == modules.end())
+                continue;
+            driven = true;
+            if (inferPinType(modIt->second, n.pin, type) && type != Bool)
+                errors.push_back(ParseError("Enable net \"" + e.net + "\" has to be of type BOOL", e.line));
+        }
+        if (!driven)
+            errors.push_back(ParseError("Enable net \"" + e.net + "\" has to be driven by a module", e.line));
+
+        for (const auto& m : e.modules) {
+            if (modules.find(m) == modules.end()) {
+                errors.push_back(ParseError("Module with name \"" + m + "\" undeclared, cannot enable it.", e.line));
+                continue;
+            }
+            auto it = grouped.find(m);
+            if (it != grouped.end())
+                errors.push_back(ParseError("Module \"" + m + "\" already in an enable group. "
+                                            "First defined: " + itos<size_t>(it->second), e.line));
+            else
+                grouped.insert({ m, e.line });
+        }
+    }
+
     return errors;
 }
 
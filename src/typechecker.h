@@ -9,7 +9,10 @@ namespace cpplink { namespace translator {
 using DeclarationsMap = std::map<std::string, const ModuleDeclaration*>;
 
 std::map<std::string, Pin>& getPins(const ModuleDeclaration* mod);
+bool findPin(const ModuleDeclaration* mod, const std::string& name, Pin& pin);
+std::string pinAccess(const ModuleDeclaration* mod, const std::string& name);
 bool inferPinType(const ModuleDeclaration* mod, std::string pName, DataType& type);
+DataType templateArgType(const std::string& arg);
 void typeCheckModDecl(const ModuleDeclaration& d, std::vector<ParseError>& errors);
 std::vector<ParseError> typeCheck(ParsedFile& pf, DeclarationsMap& modules);
 
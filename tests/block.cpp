@@ -0,0 +1,90 @@
+#include <catch.hpp>
+
+#include "tests.h"
+#include "../src/cpplink_lib/block.h"
+
+using namespace cpplink;
+
+TEST_CASE("block") {
+
+    SECTION("samples") {
+        block::Samples<double, 4> s;
+        REQUIRE_INVALID(s.slot(0));
+        REQUIRE_INVALID(s.slot(4));
+
+        block::Samples<double, 4> c(2.5);
+        REQUIRE_VALUE(c.slot(0), 2.5);
+        REQUIRE_VALUE(c.slot(4), 2.5);
+    }
+
+    SECTION("func") {
+        block::ModuleSum<int, 4> s;
+        s.in1 = 3;
+        s.in2 = 1;
+        s.stepBlock(3);
+        REQUIRE_VALUE(s.out.get(0), 4);
+        REQUIRE_VALUE(s.out.get(2), 4);
+        REQUIRE_INVALID(s.out.get(3));
+
+        block::ModuleDiff<int, 4> d;
+        d.in1 = 3;
+        d.stepBlock(4);
+        REQUIRE_INVALID(d.out.get(0));
+        REQUIRE_INVALID(d.out.get(3));
+    }
+
+    SECTION("net") {
+        block::ModuleLinear<4> l;
+        block::ModuleConvert<int64_t, double, 4> c;
+        block::Net<int64_t, 4> n;
+        n.setOutputPin(l.out);
+        n.addInputPin(c.in);
+        n.alias();
+
+        l.stepBlock(4);
+        c.stepBlock(4);
+        REQUIRE_VALUE(c.out.get(0), 0.0);
+        REQUIRE_VALUE(c.out.get(3), 3.0);
+        REQUIRE_VALUE(n.getValue(3), 3);
+
+        l.stepBlock(2);
+        c.stepBlock(2);
+        REQUIRE_VALUE(c.out.get(1), 5.0);
+    }
+
+    SECTION("delayed net") {
+        block::ModuleLinear<3> l;
+        block::ModuleIdentity<int64_t, 3> i;
+        block::Net<int64_t, 3> n;
+        n.setOutputPin(l.out);
+        n.addInputPin(i.in);
+        n.aliasLatched();
+
+        l.stepBlock(3);
+        i.stepBlock(3);
+        n.carry(3);
+        REQUIRE_INVALID(i.out.get(0));
+        REQUIRE_VALUE(i.out.get(1), 0);
+        REQUIRE_VALUE(i.out.get(2), 1);
+
+        // The last tick of the previous block is read in the first one
+        l.stepBlock(2);
+        i.stepBlock(2);
+        n.carry(2);
+        REQUIRE_VALUE(i.out.get(0), 2);
+        REQUIRE_VALUE(i.out.get(1), 3);
+
+        l.stepBlock(1);
+        i.stepBlock(1);
+        REQUIRE_VALUE(i.out.get(0), 4);
+    }
+
+    SECTION("sin") {
+        block::ModuleSin<4> s;
+        s.amplitude = 3;
+        s.period = 4;
+        s.stepBlock(4);
+        REQUIRE_VALUE(s.out.get(1), 3);
+        REQUIRE(s.out.get(3).value == Approx(-3));
+    }
+}
@@ -0,0 +1,113 @@
+#include <catch.hpp>
+#include <sstream>
+#include <stdexcept>
+
+#include "tests.h"
+#include "../src/bytecode.h"
+#include "../src/quoteunquotecompiler.h"
+#include "../src/typechecker.h"
+
+using namespace cpplink;
+using namespace translator;
+
+ParsedFile parse_netlist(const std::string& source);
+std::string interpret(const ParsedFile& file, long steps, const std::vector<std::string>& watched);
+
+static std::vector<char> lower(const ParsedFile& file, std::vector<ParseError>& errors) {
+    ParsedFile checked = file;
+    DeclarationsMap modules;
+    constDeclarations.clear();
+    REQUIRE(typeCheck(checked, modules).empty());
+    return lowerToBytecode(checked, 0, errors);
+}
+
+// Output of the lowered netlist, empty if it cannot be lowered
+static std::string execute(const ParsedFile& file, long steps, const std::vector<std::string>& watched) {
+    std::vector<ParseError> errors;
+    std::vector<char> image = lower(file, errors);
+    if (!errors.empty())
+        return {};
+    Bytecode program(image);
+    BytecodeMachine machine(program);
+    std::ostringstream out;
+    machine.run(steps, "csv", watched, out);
+    return out.str();
+}
+
+TEST_CASE("bytecode") {
+    SECTION("ticks as the interpreter") {
+        ParsedFile file = parse_netlist(
+        R"(ModuleLinear l
+           net l.out -> i
+           ModuleSum<INT> s
+           net s.in1 <- i
+           net s.in2 <- ten
+           net 10 -> ten
+           net s.out -> o
+           ModuleDiff<INT> d
+           net d.in1 <- o
+           net d.in2 <- i
+           net d.out -> sel
+           ModuleConvert<INT, REAL> c
+           net c.in <- o
+           net c.out -> slow
+           rate 3 c
+           ModuleSin sin
+           net sin.amplitude <- slow
+           net sin.period <- per
+           net 7.0 -> per
+           net sin.out -> wave
+           ModuleMod<INT> m
+           net m.in1 <- i
+           net m.in2 <- three
+           net 3 -> three
+           net m.out -> r
+           ModuleRand<BOOL> b
+           net b.out -> on
+           ModuleLogicNand n
+           net n.in1 <- on
+           net n.in2 <- on
+           net n.out -> off
+           ModuleMux<REAL, 3> x
+           net x.state <- r
+           net x.vals0 <- slow
+           net x.vals1 <- wave
+           net x.vals2 <- per
+           net x.out -> picked
+           enable on reset sin x
+        )");
+
+        std::vector<std::string> watched{ "i", "o", "sel", "slow", "wave", "r", "on", "off", "picked", "ten" };
+        std::string expected = interpret(file, 12, watched);
+        REQUIRE(!expected.empty());
+        REQUIRE(execute(file, 12, watched) == expected);
+    }
+
+    SECTION("modules without an instance are reported") {
+        ParsedFile file = parse_netlist(
+        R"(ModuleMovingAvg<1000> m
+           net m.in <- a
+           net m.out -> b
+        )");
+
+        std::vector<ParseError> errors;
+        REQUIRE(lower(file, errors).empty());
+        REQUIRE(errors.size() == 1);
+    }
+
+    SECTION("damaged images are rejected") {
+        ParsedFile file = parse_netlist(
+        R"(ModuleLinear l
+           net l.out -> i
+        )");
+
+        std::vector<ParseError> errors;
+        std::vector<char> image = lower(file, errors);
+        REQUIRE(errors.empty());
+
+        std::vector<char> truncated(image.begin(), image.end() - 1);
+        REQUIRE_THROWS_AS(Bytecode{ truncated }, const std::runtime_error&);
+        image[0] ^= 1;
+        REQUIRE_THROWS_AS(Bytecode{ image }, const std::runtime_error&);
+    }
+}
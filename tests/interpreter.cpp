@@ -0,0 +1,83 @@
+#include <catch.hpp>
+#include <sstream>
+
+#include "tests.h"
+#include "../src/interpreter.h"
+#include "../src/quoteunquotecompiler.h"
+#include "../src/typechecker.h"
+
+using namespace cpplink;
+using namespace translator;
+
+ParsedFile parse_netlist(const std::string& source);
+
+// Output of the interpreted netlist, empty if it cannot be built
+std::string interpret(const ParsedFile& file, long steps, const std::vector<std::string>& watched) {
+    ParsedFile checked = file;
+    DeclarationsMap modules;
+    constDeclarations.clear();
+    REQUIRE(typeCheck(checked, modules).empty());
+
+    std::vector<ParseError> errors;
+    Interpreter interpreter(checked, 0, errors);
+    if (!errors.empty())
+        return {};
+    std::ostringstream out;
+    interpreter.run(steps, "csv", watched, out);
+    return out.str();
+}
+
+TEST_CASE("interpreter") {
+    SECTION("ticks as in the translated code") {
+        ParsedFile file = parse_netlist(
+        R"(ModuleLinear l
+           net l.out -> i
+           ModuleSum<INT> s
+           net s.in1 <- i
+           net s.in2 <- ten
+           net 10 -> ten
+           net s.out -> o
+           ModuleConvert<INT, REAL> c
+           net c.in <- o
+           net c.out -> slow
+           rate 2 c
+        )");
+
+        REQUIRE(interpret(file, 5, { "i", "o", "slow" }) ==
+            "\"step\",\"i\",\"o\",\"slow\"\n"
+            "0,0,\"None\",\"None\"\n"
+            "1,1,10,\"None\"\n"
+            "2,2,11,10\n"
+            "3,3,12,10\n"
+            "4,4,13,12\n");
+    }
+
+    SECTION("pin arrays and stray nets") {
+        ParsedFile file = parse_netlist(
+        R"(ModuleMux<INT, 2> x
+           net x.state <- sel
+           net 1 -> sel
+           net x.vals0 <- a
+           net x.vals1 <- b
+           ModuleLinear l
+           net l.out -> b
+           net x.out -> o
+        )");
+
+        REQUIRE(interpret(file, 3, { "a", "o" }) ==
+            "\"step\",\"a\",\"o\"\n"
+            "0,\"None\",\"None\"\n"
+            "1,\"None\",0\n"
+            "2,\"None\",1\n");
+    }
+
+    SECTION("modules without an instance are reported") {
+        ParsedFile file = parse_netlist(
+        R"(ModuleMovingAvg<1000> m
+           net m.in <- a
+           net m.out -> b
+        )");
+
+        REQUIRE(interpret(file, 3, { "b" }).empty());
+    }
+}
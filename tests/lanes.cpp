@@ -0,0 +1,183 @@
+#include <catch.hpp>
+#include <sstream>
+
+#include "tests.h"
+#include "../src/cpplink_lib/lanes.h"
+
+using namespace cpplink;
+
+TEST_CASE("lanes") {
+
+    SECTION("validity mask") {
+        batch::Lanes<double, 70> l;
+        REQUIRE_INVALID(l.lane(0));
+        REQUIRE_INVALID(l.lane(69));
+
+        batch::Lanes<double, 70> c(2.5);
+        REQUIRE_VALUE(c.lane(0), 2.5);
+        REQUIRE_VALUE(c.lane(69), 2.5);
+
+        c.setValid(65, false);
+        REQUIRE_INVALID(c.lane(65));
+        REQUIRE_VALUE(c.lane(64), 2.5);
+    }
+
+    SECTION("func") {
+        batch::ModuleSum<int, 4> s;
+        s.in1 = 3;
+        s.in2.value.value = {{ 1, 2, 3, 4 }};
+        s.in2.value.setValid(0, true);
+        s.in2.value.setValid(2, true);
+        s.step();
+        REQUIRE_VALUE(s.out.value.lane(0), 4);
+        REQUIRE_INVALID(s.out.value.lane(1));
+        REQUIRE_VALUE(s.out.value.lane(2), 6);
+        REQUIRE_INVALID(s.out.value.lane(3));
+
+        batch::ModuleLess<double, 2> l;
+        l.in1 = 1.0;
+        l.in2.value.value = {{ 0.5, 1.5 }};
+        l.in2.value.valid[0] = 3;
+        l.step();
+        REQUIRE_VALUE(l.out.value.lane(0), false);
+        REQUIRE_VALUE(l.out.value.lane(1), true);
+    }
+
+    SECTION("bit-sliced logic") {
+        batch::Lanes<bool, 70> t(true);
+        REQUIRE(t.value[0] == ~uint64_t(0));
+        REQUIRE(t.value[1] == 0x3f);
+        REQUIRE(t.valid == t.value);
+
+        batch::ModuleLogicNand<70> n;
+        n.in1 = true;
+        n.in2.value.set(3, true);
+        n.in2.value.setValid(3, true);
+        n.in2.value.setValid(66, true);
+        n.step();
+        REQUIRE_VALUE(n.out.value.lane(3), false);
+        REQUIRE_VALUE(n.out.value.lane(66), true);
+        REQUIRE_INVALID(n.out.value.lane(4));
+
+        batch::ModuleNegate<bool, 70> neg;
+        neg.in.value = n.out.value;
+        neg.step();
+        REQUIRE_VALUE(neg.out.value.lane(3), true);
+        REQUIRE_VALUE(neg.out.value.lane(66), false);
+    }
+
+    SECTION("random bits") {
+        batch::ModuleRand<bool, 100> r;
+        r.seed(0, 1);
+        r.step();
+        REQUIRE(r.out.value.valid[1] == (uint64_t(1) << 36) - 1);
+        REQUIRE((r.out.value.value[1] >> 36) == 0);
+        REQUIRE(r.out.value.value[0] != r.out.value.value[1]);
+    }
+
+    SECTION("clamp") {
+        batch::ModuleClamp<int, 3> c;
+        c.min = 0;
+        c.max = 10;
+        c.in.value.value = {{ -5, 5, 15 }};
+        c.in.value.valid[0] = 7;
+        c.step();
+        REQUIRE_VALUE(c.out.value.lane(0), 0);
+        REQUIRE_VALUE(c.out.value.lane(1), 5);
+        REQUIRE_VALUE(c.out.value.lane(2), 10);
+
+        c.min.value.value = {{ 2, -3, 20 }};
+        c.in.value.valid[0] = 0;
+        c.step();
+        REQUIRE_VALUE(c.out.value.lane(0), 2);
+        REQUIRE_VALUE(c.out.value.lane(1), 0);
+        REQUIRE_VALUE(c.out.value.lane(2), 10);
+    }
+
+    SECTION("clamp like the scalar clamp") {
+        // Every combination of valid and invalid pins gives the scalar output
+        const Maybe<double> values[] = { Maybe<double>(), -2.0, 0.5, 3.0 };
+        for (const auto& min : values)
+        for (const auto& max : values)
+        for (const auto& in : values) {
+            ModuleClamp<double> s;
+            s.min = min;
+            s.max = max;
+            s.in = in;
+            s.step();
+
+            batch::ModuleClamp<double, 1> b; // all pins invalid
+            if (min.isValid())
+                b.min = min.value;
+            if (max.isValid())
+                b.max = max.value;
+            if (in.isValid())
+                b.in = in.value;
+            b.step();
+            REQUIRE(b.out.value.lane(0).isValid() == s.out.value.isValid());
+            if (s.out.value.isValid())
+                REQUIRE_VALUE(b.out.value.lane(0), s.out.value.value);
+        }
+    }
+
+    SECTION("sin") {
+        batch::ModuleSin<2> s;
+        s.amplitude.value.value = {{ 3, 5 }};
+        s.amplitude.value.valid[0] = 3;
+        s.period = 4;
+        s.step();
+        s.step();
+        REQUIRE_VALUE(s.out.value.lane(0), 3);
+        REQUIRE_VALUE(s.out.value.lane(1), 5);
+    }
+
+    SECTION("net and instance index") {
+        batch::ModuleInstance<3> i;
+        batch::ModuleConvert<int64_t, double, 3> c;
+        batch::Net<int64_t, 3> n;
+        n.setOutputPin(i.out);
+        n.addInputPin(c.in);
+
+        i.step();
+        n.step();
+        c.step();
+        REQUIRE_VALUE(c.out.value.lane(0), 0.0);
+        REQUIRE_VALUE(c.out.value.lane(2), 2.0);
+    }
+
+    SECTION("many instances") {
+        // Pins of a million instances take megabytes, they live on the heap
+        const size_t n = 1 << 20;
+        batch::ModuleInstance<n> i;
+        batch::ModuleConvert<int64_t, double, n> c;
+        batch::ModuleSum<double, n> s;
+        batch::Net<int64_t, n> in;
+        batch::Net<double, n> converted;
+        in.setOutputPin(i.out);
+        in.addInputPin(c.in);
+        converted.setOutputPin(c.out);
+        converted.addInputPin(s.in1);
+        s.in2 = 0.5;
+
+        i.step();
+        in.step();
+        c.step();
+        converted.step();
+        s.step();
+        REQUIRE_VALUE(s.out.value.lane(0), 0.5);
+        REQUIRE_VALUE(s.out.value.lane(n - 1), n - 0.5);
+    }
+
+    SECTION("table") {
+        std::ostringstream s;
+        batch::TableWriter<CsvDialect, 2, batch::Lanes<int, 2>, batch::Lanes<int, 2>>
+            table(s, {"step", "A", "B"});
+        batch::Lanes<int, 2> a(1);
+        batch::Lanes<int, 2> b;
+        b.value = { 5, 6 };
+        b.setValid(1, true);
+        table.write_line(0, a, b);
+        REQUIRE(s.str() == "\"step\",\"A[0]\",\"B[0]\",\"A[1]\",\"B[1]\"\n"
+                           "0,1,\"None\",1,6\n");
+    }
+}
@@ -2,9 +2,13 @@
 #include <string>
 #include <typeinfo>
 #include <type_traits>
+#include <limits>
+#include <cmath>
+#include <numeric>
 
 #include "tests.h"
 #include "../src/cpplink_lib/modules.h"
+#include "../src/cpplink_lib/modulesquare.h"
 
 #include <iostream>
 
@@ -113,6 +117,46 @@ TEST_CASE("maybe") {
         auto res3 = zz | fff | ff | ff | inv | ff | fff | fff;
         REQUIRE_INVALID(res3);
     }
+
+    SECTION("total apply") {
+        Maybe<int> a(3);
+        Maybe<int> b;
+        REQUIRE_VALUE(apply(a, a, std::plus<int>()), 6);
+        REQUIRE_INVALID(apply(a, b, std::plus<int>()));
+        REQUIRE_VALUE(apply(a, std::negate<int>()), -3);
+        REQUIRE_INVALID(apply(b, std::negate<int>()));
+        REQUIRE_VALUE(apply(a, a, std::less<int>()), false);
+    }
+
+    SECTION("compact representations") {
+        using Real = Maybe<double, NanBoxRepr>;
+        using Int = Maybe<int64_t, SentinelRepr>;
+        REQUIRE(sizeof(Real) == sizeof(double));
+        REQUIRE(sizeof(Int) == sizeof(int64_t));
+
+        Real r;
+        REQUIRE_INVALID(r);
+        Real nan(std::numeric_limits<double>::quiet_NaN());
+        REQUIRE(nan.isValid());
+        Real x(1.5);
+        REQUIRE_VALUE(x, 1.5);
+        Real y(std::move(x));
+        REQUIRE_VALUE(y, 1.5);
+        REQUIRE_INVALID(x);
+        REQUIRE_VALUE(apply(y, y, std::multiplies<double>()), 2.25);
+        REQUIRE_INVALID(apply(y, r, std::multiplies<double>()));
+        REQUIRE_VALUE(Real::select(true, 2.0), 2.0);
+        REQUIRE_INVALID(Real::select(false, 2.0));
+
+        Int i;
+        REQUIRE_INVALID(i);
+        Int j(int64_t(-7));
+        REQUIRE_VALUE(j, -7);
+        REQUIRE_VALUE(apply(j, std::negate<int64_t>()), 7);
+        REQUIRE_INVALID(apply(i, j, std::plus<int64_t>()));
+        REQUIRE_VALUE(apply(j, [](int64_t v) { return v * 2; }), -14);
+        REQUIRE_INVALID(Int::select(false, 5));
+    }
 }
 
 
@@ -147,6 +191,36 @@ TEST_CASE("modules basic") {
         REQUIRE_VALUE(ip.value,4)
     }
 
+    SECTION("aliased net") {
+
+        InputPin<int> ip1;
+        InputPin<int> ip2;
+        OutputPin<int> op;
+
+        Net<int> n;
+        n.addInputPin(ip1);
+        n.addInputPin(ip2);
+        n.setOutputPin(op);
+        n.alias();
+
+        op.value = 4;
+        REQUIRE(ip1.isAliased());
+        REQUIRE_VALUE(ip1.get(), 4);
+        REQUIRE_VALUE(ip2.get(), 4);
+        REQUIRE_INVALID(ip1.value); // own storage is not used
+
+        n.aliasLatched();
+        op.value = 5;
+        REQUIRE_INVALID(ip1.get());
+        n.latch();
+        op.value = 6;
+        REQUIRE_VALUE(ip1.get(), 5);
+        REQUIRE_VALUE(ip2.get(), 5);
+
+        ip1.unalias();
+        REQUIRE_INVALID(ip1.get());
+    }
+
     SECTION("module id") {
 
         ModuleIdentity<int> mi;
@@ -205,6 +279,125 @@ TEST_CASE("modules") {
 
         ModuleRand<bool> mb;
         mb.step();
+
+        for (int i = 0; i < 1000; i++) {
+            mi.step();
+            REQUIRE(mi.out.getValue() >= -10);
+            REQUIRE(mi.out.getValue() <= 10);
+            md.step();
+            REQUIRE(md.out.getValue() >= -2.5);
+            REQUIRE(md.out.getValue() < 1000.99);
+        }
+    }
+
+    SECTION("rand streams") {
+        ModuleRand<int64_t> a, b, c;
+        a.seed(42, 0);
+        b.seed(42, 0);
+        c.seed(42, 1);
+        bool differ = false;
+        for (int i = 0; i < 200; i++) {
+            a.step();
+            b.step();
+            c.step();
+            REQUIRE(a.out.getValue() == b.out.getValue());
+            differ |= a.out.getValue() != c.out.getValue();
+        }
+        REQUIRE(differ);
+
+        a.min = 5;
+        a.max = 4;
+        a.step();
+        REQUIRE_INVALID(a.out.value);
+    }
+
+    SECTION("philox") {
+        // Known answers of the reference implementation
+        auto r = Philox4x32::generate({{ 0, 0, 0, 0 }}, {{ 0, 0 }});
+        REQUIRE(r == (Philox4x32::Counter{{ 0x6627e8d5, 0xe169c58d, 0xbc57ac4c, 0x9b00dbd8 }}));
+        r = Philox4x32::generate({{ 0x243f6a88, 0x85a308d3, 0x13198a2e, 0x03707344 }},
+            {{ 0xa4093822, 0x299f31d0 }});
+        REQUIRE(r == (Philox4x32::Counter{{ 0xd16cfe09, 0x94fdcceb, 0x5001e420, 0x24126ea1 }}));
+    }
+
+    SECTION("wide multiply") {
+        std::vector<uint64_t> values{ 0, 1, 0xFFFFFFFF, 0x100000000ull, 0x9E3779B97F4A7C15ull,
+            0xFFFFFFFFFFFFFFFFull };
+        for (uint64_t a : values) {
+            for (uint64_t b : values) {
+                uint64_t hi, portableHi;
+                REQUIRE(mulhilo(a, b, hi) == a * b);
+                REQUIRE(mulhiloPortable(a, b, portableHi) == a * b);
+                REQUIRE(portableHi == hi);
+            }
+        }
+        uint64_t hi;
+        mulhiloPortable(0xFFFFFFFFFFFFFFFFull, 0xFFFFFFFFFFFFFFFFull, hi);
+        REQUIRE(hi == 0xFFFFFFFFFFFFFFFEull);
+    }
+
+    SECTION("stream seek") {
+        RandomStream<8> a(7, 3);
+        NormalStream<4> n(7, 3);
+        std::vector<uint64_t> numbers;
+        std::vector<double> normals;
+        for (int i = 0; i < 30; i++) {
+            numbers.push_back(a.next());
+            normals.push_back(n.next());
+        }
+        REQUIRE(a.position() == 30);
+        REQUIRE(n.position() == 30);
+
+        for (uint64_t i = 0; i < 30; i++) {
+            RandomStream<8> b(7, 3);
+            b.seek(i);
+            REQUIRE(b.next() == numbers[i]);
+            NormalStream<4> m(7, 3);
+            m.advance(i);
+            REQUIRE(m.position() == i);
+            REQUIRE(m.next() == normals[i]);
+        }
+    }
+
+    SECTION("advance") {
+        ModuleSin s, t;
+        ModuleSaw w, v;
+        ModuleRandNormal r, q;
+        s.amplitude = t.amplitude = w.amplitude = v.amplitude = 2.0;
+        s.period = t.period = 7.0;
+        w.period = v.period = 6.0;
+        r.seed(1, 2);
+        q.seed(1, 2);
+        for (int i = 0; i < 100; i++) {
+            s.step();
+            w.step();
+            r.step();
+        }
+        t.advance(99);
+        v.advance(99);
+        q.advance(99);
+        t.step();
+        v.step();
+        q.step();
+        REQUIRE_VALUE(t.out.value, s.out.getValue());
+        REQUIRE_VALUE(v.out.value, w.out.getValue());
+        REQUIRE_VALUE(q.out.value, r.out.getValue());
+    }
+
+    SECTION("rand normal") {
+        ModuleRandNormal n;
+        n.mean = 10;
+        n.stddev = 2;
+        double sum = 0;
+        double sq = 0;
+        for (int i = 0; i < 10000; i++) {
+            n.step();
+            sum += n.out.getValue();
+            sq += n.out.getValue() * n.out.getValue();
+        }
+        double mean = sum / 10000;
+        REQUIRE(std::abs(mean - 10) < 0.1);
+        REQUIRE(std::abs(std::sqrt(sq / 10000 - mean * mean) - 2) < 0.1);
     }
 
     SECTION("sin") {
@@ -221,6 +414,36 @@ TEST_CASE("modules") {
         REQUIRE_VALUE(s.out.value, 3)
     }
 
+    SECTION("oscillator") {
+        ModuleSinOsc s;
+        ModuleCosOsc c;
+        ModuleSin ref;
+        s.amplitude = c.amplitude = ref.amplitude = 3;
+        s.period = c.period = ref.period = 7.5;
+        for (int i = 0; i < 2000; i++) {
+            s.step();
+            c.step();
+            ref.step();
+            REQUIRE(std::abs(s.out.getValue() - ref.out.getValue()) < 1e-12);
+            double sc = s.out.getValue() * s.out.getValue() + c.out.getValue() * c.out.getValue();
+            REQUIRE(std::abs(sc - 9) < 1e-12);
+        }
+
+        // Period change keeps the phase
+        s.period = 15;
+        s.step();
+        // 2000 ticks of period 7.5 end at 2/3 of the period
+        REQUIRE(std::abs(s.out.getValue() - 3 * sin(2 * M_PI * 2 / 3)) < 1e-9);
+
+        s.period = Maybe<double>();
+        s.step();
+        REQUIRE_INVALID(s.out.value);
+        s.period = 4;
+        s.step();
+        s.step();
+        REQUIRE(doubleEqual(s.out.getValue(), 3));
+    }
+
     SECTION("tan") {
         ModuleTan tt;
         tt.period.value = 0;
@@ -250,6 +473,32 @@ TEST_CASE("modules") {
         c.in.setValue(-2);
         c.step();
         REQUIRE_VALUE(c.out.value,3);
+        // Validity of the output follows the bounds only
+        c.in.value = Maybe<int>();
+        c.step();
+        REQUIRE_VALUE(c.out.value,3);
+    }
+
+    SECTION("clamp ignores what an invalid input stores") {
+        // Compact representations store a NaN payload or a sentinel in an
+        // invalid value, the output must not depend on it
+        const double box = Maybe<double, NanBoxRepr>().value;
+        for (double stored : { 0.0, 42.0, -7.0, box }) {
+            ModuleClamp<double> c;
+            c.min.setValue(0.5);
+            c.max.setValue(9);
+            c.in.value = Maybe<double>::select(false, stored);
+            c.step();
+            REQUIRE_VALUE(c.out.value, 0.5);
+        }
+        for (int64_t stored : { int64_t(0), int64_t(11), Maybe<int64_t, SentinelRepr>().value }) {
+            ModuleClamp<int64_t> c;
+            c.min.setValue(3);
+            c.max.setValue(9);
+            c.in.value = Maybe<int64_t>::select(false, stored);
+            c.step();
+            REQUIRE_VALUE(c.out.value, 3);
+        }
     }
 
     SECTION("sum") {
@@ -326,6 +575,32 @@ TEST_CASE("modules") {
         REQUIRE_VALUE(m.out.value, -3);
     }
 
+    SECTION("mux") {
+        ModuleMux<double, 200> m;
+        m.vals[150] = 1.5;
+        m.state = 150;
+        m.step();
+        REQUIRE_VALUE(m.out.value, 1.5);
+        m.state = 200;
+        m.step();
+        REQUIRE_INVALID(m.out.value);
+        m.state = -1;
+        m.step();
+        REQUIRE_INVALID(m.out.value);
+
+        // Demand pins read the net without propagation
+        ModuleIdentity<double> src;
+        Net<double> n;
+        n.setOutputPin(src.out);
+        n.addDemandPin(m.vals[3]);
+        n.aliasDemand();
+        m.state = 3;
+        src.in = 2.5;
+        src.step();
+        m.step();
+        REQUIRE_VALUE(m.out.value, 2.5);
+    }
+
     SECTION("negate") {
         ModuleNegate<bool> b;
         b.in.value = true;
@@ -381,6 +656,109 @@ TEST_CASE("modules") {
         REQUIRE_VALUE(a.out.value, 7.5);
     }
 
+    SECTION("moving avg") {
+        ModuleMovingAvg<3> a;
+        a.in = 3;
+        a.step();
+        a.in = Maybe<double>();
+        a.step();
+        REQUIRE_INVALID(a.out.value);
+        a.in = 6;
+        a.step();
+        a.step();
+        REQUIRE_INVALID(a.out.value);
+        a.step();
+        REQUIRE_VALUE(a.out.value, 6);
+        a.in = 0;
+        a.step();
+        REQUIRE_VALUE(a.out.value, 4);
+    }
+
+    SECTION("moving avg recovers from non-finite samples") {
+        const double inf = std::numeric_limits<double>::infinity();
+        const double nan = std::numeric_limits<double>::quiet_NaN();
+        ModuleMovingAvg<3> a;
+        std::vector<double> samples{ 1, 2, inf, 1, 2, 3, nan, 4, 5, 6, -inf, inf, 1, 1, 1 };
+        std::vector<double> averages;
+        for (double v : samples) {
+            a.in = v;
+            a.step();
+            REQUIRE(a.out.value.isValid());
+            averages.push_back(a.out.value.value);
+        }
+        REQUIRE(averages[1] == 1.5);
+        REQUIRE(averages[2] == inf);
+        REQUIRE(averages[4] == inf);
+        REQUIRE(averages[5] == 2);
+        REQUIRE(std::isnan(averages[6]));
+        REQUIRE(std::isnan(averages[8]));
+        REQUIRE(averages[9] == 5);
+        REQUIRE(std::isnan(averages[11]));
+        REQUIRE(std::isnan(averages[12]));
+        REQUIRE(averages[13] == inf);
+        REQUIRE(averages[14] == 1);
+    }
+
+    SECTION("moving avg running sum") {
+        // The compensated running sum stays within 1e-9 of the sum of the
+        // window recomputed in every step for samples in [-1000, 1000]
+        ModuleMovingAvg<10> a;
+        std::vector<double> window;
+        uint64_t x = 1;
+        double error = 0;
+        for (int i = 0; i < 200000; i++) {
+            x = x * 6364136223846793005ull + 1442695040888963407ull;
+            double v = (double(x >> 11) / 9007199254740992.0 - 0.5) * 2000.0;
+            a.in = v;
+            a.step();
+            window.push_back(v);
+            if (window.size() > 10)
+                window.erase(window.begin());
+            double sum = std::accumulate(window.begin(), window.end(), 0.0);
+            error = std::max(error, std::fabs(a.out.value.value - sum / window.size()));
+        }
+        REQUIRE(a.out.value.isValid());
+        REQUIRE(error < 1e-9);
+    }
+
+    SECTION("square") {
+        ModuleSquare s;
+        s.period = 4;
+        s.ampl = 2;
+        s.mid = 1;
+        s.step();
+        REQUIRE_VALUE(s.out.value, 1); // sin(0) has no sign
+        s.step();
+        REQUIRE_VALUE(s.out.value, 3);
+        s.step();
+        s.step();
+        REQUIRE_VALUE(s.out.value, -1);
+    }
+
+    SECTION("lut") {
+        ModuleLUT<FuncSqrt, 100> l(1, 101);
+        l.in = 4;
+        l.step();
+        REQUIRE(std::abs(l.out.getValue() - 2) < 1e-3);
+        l.in = 400;
+        l.step();
+        REQUIRE_VALUE(l.out.value, 20); // out of range
+        l.in = -1;
+        l.step();
+        REQUIRE_INVALID(l.out.value);
+
+        ModuleLUTCubic<FuncSin, 64> c(0, 2 * M_PI);
+        c.in = 1;
+        c.step();
+        REQUIRE(std::abs(c.out.getValue() - sin(1)) < 1e-5);
+
+        LookupTable<FuncExp, Interpolation::Linear> linear(0, 1, 32);
+        LookupTable<FuncExp, Interpolation::Cubic> cubic(0, 1, 32);
+        REQUIRE(linear(1) == exp(1));
+        REQUIRE(linear.maxError() < 1e-3);
+        REQUIRE(cubic.maxError() < linear.maxError() / 50);
+    }
+
     SECTION("sgn") {
         ModuleSignum s;
         s.in = 0;
@@ -393,5 +771,27 @@ TEST_CASE("modules") {
         s.step();
         REQUIRE_VALUE(s.out.value, -1);
     }
-}
 
+    SECTION("changed values") {
+        REQUIRE(identical(Maybe<double>(), Maybe<double>()));
+        REQUIRE(identical(Maybe<double>(NAN), Maybe<double>(NAN)));
+        REQUIRE_FALSE(identical(Maybe<double>(0.0), Maybe<double>(-0.0)));
+        REQUIRE_FALSE(identical(Maybe<int64_t>(0), Maybe<int64_t>()));
+
+        OutputPin<double> out;
+        InputPin<double> in;
+        Net<double> net;
+        net.setOutputPin(out);
+        net.addInputPin(in);
+
+        // Initial values of pins are invalid
+        REQUIRE_FALSE(net.stepChanged());
+        out = 2.0;
+        REQUIRE(net.stepChanged());
+        REQUIRE_VALUE(in.get(), 2.0);
+        REQUIRE_FALSE(net.stepChanged());
+        out = Maybe<double>();
+        REQUIRE(net.stepChanged());
+        REQUIRE_INVALID(in.get());
+    }
+}
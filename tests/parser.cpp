@@ -52,6 +52,7 @@ TEST_CASE("parser:simple") {
         R"(TestModule a
             TestModule b
             DoubleModule<T, c> c
+            Window<1000, 2.5> w
             net a.pin1 -> nn
             net b.pin2 <- nn
             net 4 -> nn
@@ -67,10 +68,11 @@ TEST_CASE("parser:simple") {
 
 		ParsedFile& res = parsed_file.right();
 
-		REQUIRE(res.declarations.size() == 3);
+		REQUIRE(res.declarations.size() == 4);
 		match_module_declaration(res.declarations[0], { "TestModule", "a", {}});
 		match_module_declaration(res.declarations[1], { "TestModule", "b", { }});
 		match_module_declaration(res.declarations[2], { "DoubleModule", "c", { "T", "c" }});
+		match_module_declaration(res.declarations[3], { "Window", "w", { "1000", "2.5" }});
 
 		REQUIRE(res.net_pin.size() == 2);
 		match_net_command(res.net_pin[0], { "nn", "a", "pin1", true });
@@ -125,4 +127,39 @@ TEST_CASE("parser:simple") {
 		auto parsed_file = parse_file(read_file(prog));
 		REQUIRE(parsed_file.isLeft());
 	}
+
+	SECTION("Rate ok") {
+		std::istringstream prog("rate 100 slow slower");
+
+		auto parsed_file = parse_file(read_file(prog));
+		if (parsed_file.isLeft()) {
+			auto error_list = parsed_file.left();
+			CAPTURE(error_list);
+			FAIL("Parsing errors occured");
+		}
+
+		ParsedFile& res = parsed_file.right();
+
+		REQUIRE(res.rates.size() == 1);
+		REQUIRE(res.rates[0].divider == 100);
+		REQUIRE(res.rates[0].modules == (std::vector<std::string>{ "slow", "slower" }));
+	}
+
+	SECTION("Enable ok") {
+		std::istringstream prog("enable on reset first second");
+
+		auto parsed_file = parse_file(read_file(prog));
+		if (parsed_file.isLeft()) {
+			auto error_list = parsed_file.left();
+			CAPTURE(error_list);
+			FAIL("Parsing errors occured");
+		}
+
+		ParsedFile& res = parsed_file.right();
+
+		REQUIRE(res.enables.size() == 1);
+		REQUIRE(res.enables[0].net == "on");
+		REQUIRE(res.enables[0].policy == "reset");
+		REQUIRE(res.enables[0].modules == (std::vector<std::string>{ "first", "second" }));
+	}
 }
@@ -0,0 +1,100 @@
+#include <catch.hpp>
+
+#include "tests.h"
+#include "../src/cpplink_lib/modules.h"
+#include "../src/cpplink_lib/periodic.h"
+
+using namespace cpplink;
+
+TEST_CASE("periodic") {
+
+    SECTION("snapshot") {
+        StateSnapshot a, b;
+        a << Maybe<double>(1.5) << Maybe<int64_t>() << true;
+        b << Maybe<double>(1.5) << Maybe<int64_t>() << true;
+        REQUIRE(a == b);
+
+        // Payload of an invalid value does not matter
+        Maybe<int64_t> invalid = Maybe<int64_t>::select(false, 42);
+        a.clear();
+        b.clear();
+        a << invalid;
+        b << Maybe<int64_t>();
+        REQUIRE(a == b);
+
+        b.clear();
+        b << Maybe<int64_t>(int64_t(0));
+        REQUIRE(!(a == b));
+    }
+
+    SECTION("period after a transient") {
+        // 0, 1, 2, 3, 4, 5, 3, 4, 5, ...
+        auto value = [](long t) { return t < 3 ? t : 3 + t % 3; };
+        PeriodDetector<long> detector(16);
+        StateSnapshot state;
+        long t = 0;
+        for (; t < 100; t++) {
+            state.clear();
+            state << int64_t(value(t));
+            if (detector.tick(state, value(t)))
+                break;
+        }
+        REQUIRE(t < 100);
+        REQUIRE(detector.period() == 3);
+        for (long k = 0; k < 10; k++)
+            REQUIRE(detector.replay(k) == value(t + 1 + k));
+    }
+
+    SECTION("period longer than the budget") {
+        PeriodDetector<long> detector(4);
+        StateSnapshot state;
+        for (long t = 0; t < 100; t++) {
+            state.clear();
+            state << int64_t(t % 7);
+            REQUIRE(!detector.tick(state, t));
+        }
+    }
+
+    SECTION("saw") {
+        ModuleSaw saw;
+        saw.amplitude = 1.0;
+        saw.period = 4.0;
+        PeriodDetector<double> detector(8);
+        StateSnapshot state;
+        bool found = false;
+        for (long t = 0; t < 20 && !found; t++) {
+            saw.step();
+            state.clear();
+            state << saw.out.value;
+            saw.state(state);
+            found = detector.tick(state, saw.out.getValue());
+        }
+        REQUIRE(found);
+        REQUIRE(detector.period() == 4);
+    }
+
+    SECTION("oscillator") {
+        // The state repeats with the period, not only after the resync interval
+        ModuleSinOsc osc;
+        osc.amplitude = 1.0;
+        osc.period = 12.0;
+        PeriodDetector<double> detector(100);
+        StateSnapshot state;
+        bool found = false;
+        for (long t = 0; t < 1000 && !found; t++) {
+            osc.step();
+            state.clear();
+            state << osc.out.value;
+            osc.state(state);
+            found = detector.tick(state, osc.out.getValue());
+        }
+        REQUIRE(found);
+        REQUIRE(detector.period() == 12);
+
+        // The replay is identical to stepping on
+        for (size_t k = 0; k < 600; k++) {
+            osc.step();
+            REQUIRE(osc.out.getValue() == detector.replay(k));
+        }
+    }
+}
@@ -0,0 +1,50 @@
+#include <catch.hpp>
+
+#include "tests.h"
+#include "../src/cpplink_lib/modules.h"
+#include "../src/cpplink_lib/pool.h"
+
+using namespace cpplink;
+
+TEST_CASE("pool") {
+
+    SECTION("modules step in place") {
+        ModulePool<ModuleLinear, 3> p;
+        auto&& second = p[1];
+        p.step();
+        p.step();
+        REQUIRE_VALUE(second.out.value, 1);
+        REQUIRE_VALUE(p[2].out.value, 1);
+    }
+
+    SECTION("modules keep constructor arguments") {
+        ModulePool<ModuleLUT<FuncSqrt, 2>, 2> p{{{ {0.0, 4.0}, {0.0, 16.0} }}};
+        p[0].in = 4.0;
+        p[1].in = 16.0;
+        p.step();
+        REQUIRE_VALUE(p[0].out.value, 2.0);
+        REQUIRE_VALUE(p[1].out.value, 4.0);
+    }
+
+    SECTION("functions in parallel arrays") {
+        ModulePool<ModuleSum<int64_t>, 2> p;
+        auto&& a = p[0];
+        auto&& b = p[1];
+        a.in1 = 1;
+        a.in2 = 2;
+        b.in1 = 5;
+        p.step();
+        REQUIRE_VALUE(a.out.value, 3);
+        REQUIRE_INVALID(b.out.value);
+
+        // Pins of an element are wired as those of a single module
+        OutputPin<int64_t> source;
+        Net<int64_t> n;
+        n.setOutputPin(source);
+        n.addInputPin(b.in2);
+        source = 10;
+        n.step();
+        p.step();
+        REQUIRE_VALUE(p.out[1].value, 15);
+    }
+}
@@ -0,0 +1,42 @@
+#include <catch.hpp>
+
+#include "tests.h"
+#include "../src/cpplink_lib/processes.h"
+
+using namespace cpplink;
+
+TEST_CASE("processes") {
+
+    SECTION("mailboxes pass values between processes") {
+        const size_t processes = 3;
+        const long ticks = 1000;
+        ProcessGroup group(processes, processes);
+        std::vector<Mailbox<int64_t>> boxes;
+        for (size_t p = 0; p < processes; p++)
+            boxes.emplace_back(group);
+
+        // Every process publishes its counter and adds the one of the previous process
+        size_t p = group.spawn();
+        int64_t own = 0;
+        bool consistent = true;
+        for (long i = 0; i < ticks; i++) {
+            boxes[p].publish(own, i);
+            group.wait();
+            Maybe<int64_t> previous = boxes[(p + processes - 1) % processes].read(i);
+            consistent = consistent && previous.isValid() && previous.value == own;
+            own += 1;
+        }
+        if (!consistent)
+            _exit(1);
+        REQUIRE(group.finish(p));
+        REQUIRE(p == 0);
+    }
+
+    SECTION("failure of a process is reported") {
+        ProcessGroup group(2, 0);
+        size_t p = group.spawn();
+        if (p == 1)
+            _exit(3);
+        REQUIRE(!group.finish(p));
+    }
+}
@@ -0,0 +1,406 @@
+#include <catch.hpp>
+#include <algorithm>
+#include <cmath>
+#include <sstream>
+
+#include "tests.h"
+#include "../src/schedule.h"
+
+using namespace cpplink;
+using namespace translator;
+
+ParsedFile parse_netlist(const std::string& source) {
+    std::istringstream prog(source);
+    auto parsed_file = parse_file(read_file(prog));
+    REQUIRE(parsed_file.isRight());
+    return parsed_file.right();
+}
+
+std::vector<std::string> module_names(const Dataflow& graph, const std::vector<size_t>& order) {
+    std::vector<std::string> res;
+    for (size_t m : order)
+        res.push_back(graph.modules[m]->name);
+    return res;
+}
+
+TEST_CASE("schedule") {
+    SECTION("dataflow graph") {
+        ParsedFile file = parse_netlist(
+        R"(ModuleSum<REAL> sum
+           ModuleSin sin
+           net sin.out -> a
+           net sum.in1 <- a
+           net sum.in2 <- a
+           net 10.0 -> amp
+           net sin.amplitude <- amp
+        )");
+
+        Dataflow graph(file);
+        REQUIRE(graph.nets == std::vector<std::string>{ "a" });
+        REQUIRE(graph.driver["a"] == graph.index["sin"]);
+        REQUIRE(graph.inputs[graph.index["sum"]] == std::vector<std::string>{ "a" });
+        REQUIRE(graph.inputs[graph.index["sin"]].empty());
+        REQUIRE(graph.successors[graph.index["sin"]] == std::set<size_t>{ graph.index["sum"] });
+    }
+
+    SECTION("chain is ordered by dataflow") {
+        ParsedFile file = parse_netlist(
+        R"(ModuleIdentity<REAL> c
+           ModuleIdentity<REAL> b
+           ModuleIdentity<REAL> a
+           ModuleIdentity<REAL> free
+           net a.out -> ab
+           net b.in <- ab
+           net b.out -> bc
+           net c.in <- bc
+        )");
+
+        Dataflow graph(file);
+        std::vector<std::string> expected{ "a", "b", "c", "free" };
+        REQUIRE(module_names(graph, topologicalOrder(graph)) == expected);
+    }
+
+    SECTION("feedback loop is collapsed") {
+        ParsedFile file = parse_netlist(
+        R"(ModuleIdentity<REAL> out
+           ModuleSum<REAL> acc
+           ModuleIdentity<REAL> delay
+           net acc.out -> sum
+           net delay.in <- sum
+           net delay.out -> back
+           net acc.in1 <- back
+           net out.in <- sum
+        )");
+
+        Dataflow graph(file);
+        auto components = stronglyConnectedComponents(graph);
+        REQUIRE(components.size() == 2);
+        std::vector<std::string> loop{ "acc", "delay" };
+        std::vector<std::string> tail{ "out" };
+        REQUIRE(module_names(graph, components[0]) == loop);
+        REQUIRE(module_names(graph, components[1]) == tail);
+    }
+
+    SECTION("dataflow levels") {
+        ParsedFile file = parse_netlist(
+        R"(ModuleLinear l
+           ModuleIdentity<REAL> a
+           ModuleIdentity<REAL> b
+           ModuleSum<REAL> acc
+           ModuleIdentity<REAL> delay
+           ModuleIdentity<REAL> tail
+           net l.out -> x
+           net a.in <- x
+           net b.in <- x
+           net a.out -> y
+           net acc.in1 <- y
+           net acc.out -> sum
+           net delay.in <- sum
+           net delay.out -> back
+           net acc.in2 <- back
+           net tail.in <- sum
+        )");
+
+        Dataflow graph(file);
+        // a and b read the same net, the loop of acc and delay shares a level
+        std::vector<size_t> levels{ 0, 1, 1, 2, 2, 3 };
+        REQUIRE(dataflowLevels(graph) == levels);
+    }
+
+    SECTION("latched nets") {
+        ParsedFile file = parse_netlist(
+        R"(ModuleIdentity<REAL> b
+           ModuleIdentity<REAL> a
+           ModuleIdentity<REAL> c
+           net a.out -> ab
+           net b.in <- ab
+           net b.out -> bc
+           net c.in <- bc
+           net c.out -> ca
+           net a.in <- ca
+        )");
+
+        Dataflow graph(file);
+        // Declaration order b, a, c - only c reads its net after the driver steps
+        std::set<std::string> latched{ "bc" };
+        REQUIRE(latchedNets(graph, Schedule::TwoPhase) == latched);
+        // Every net is propagated right before its only reader
+        REQUIRE(latchedNets(graph, Schedule::Topological).empty());
+        // Concurrently stepped modules may run in any order
+        latched = { "ab", "bc", "ca" };
+        REQUIRE(latchedNets(graph, Schedule::TwoPhase, true) == latched);
+    }
+
+    SECTION("feedback nets") {
+        ParsedFile file = parse_netlist(
+        R"(ModuleIdentity<REAL> b
+           ModuleIdentity<REAL> a
+           ModuleIdentity<REAL> c
+           ModuleIdentity<REAL> tail
+           net a.out -> ab
+           net b.in <- ab
+           net b.out -> bc
+           net c.in <- bc
+           net c.out -> ca
+           net a.in <- ca
+           net tail.in <- ca
+        )");
+
+        Dataflow graph(file);
+        // The loop is stepped in declaration order b, a, c
+        std::set<std::string> feedback{ "ab", "ca" };
+        REQUIRE(feedbackNets(graph) == feedback);
+    }
+
+    SECTION("longest chain") {
+        ParsedFile file = parse_netlist(
+        R"(ModuleLinear l
+           ModuleConvert<INT, REAL> c
+           ModuleIdentity<REAL> a
+           ModuleIdentity<REAL> b
+           net l.out -> lc
+           net c.in <- lc
+           net c.out -> ca
+           net a.in <- ca
+           net b.in <- ca
+           net a.out -> ab
+        )");
+        REQUIRE(longestChain(Dataflow(file)) == 3);
+
+        file = parse_netlist(
+        R"(ModuleIdentity<REAL> a
+           net a.out -> aa
+           net a.in <- aa
+        )");
+        REQUIRE(longestChain(Dataflow(file)) == 0);
+    }
+
+    SECTION("process partition") {
+        // Two independent chains, interleaved in the topological order
+        ParsedFile file = parse_netlist(
+        R"(ModuleIdentity<REAL> a1
+           ModuleIdentity<REAL> b1
+           ModuleIdentity<REAL> a2
+           ModuleIdentity<REAL> b2
+           ModuleIdentity<REAL> a3
+           ModuleIdentity<REAL> b3
+           net a1.out -> x1
+           net a2.in <- x1
+           net a2.out -> x2
+           net a3.in <- x2
+           net b1.out -> y1
+           net b2.in <- y1
+           net b2.out -> y2
+           net b3.in <- y2
+        )");
+
+        Dataflow graph(file);
+        REQUIRE(partitionCut(graph, pipelineThreads(graph, 2)) == 2);
+
+        std::vector<size_t> part = processPartition(graph, 2);
+        REQUIRE(partitionCut(graph, part) == 0);
+        REQUIRE(part[graph.index["a1"]] == part[graph.index["a3"]]);
+        REQUIRE(part[graph.index["b1"]] == part[graph.index["b3"]]);
+        REQUIRE(part[graph.index["a1"]] != part[graph.index["b1"]]);
+    }
+
+    SECTION("process partition sizes") {
+        // A feedback loop of three modules feeding a chain
+        ParsedFile file = parse_netlist(
+        R"(ModuleSum<REAL> acc
+           ModuleMult<REAL> decay
+           ModuleIdentity<REAL> delay
+           ModuleIdentity<REAL> c1
+           ModuleIdentity<REAL> c2
+           ModuleIdentity<REAL> c3
+           ModuleIdentity<REAL> c4
+           ModuleIdentity<REAL> c5
+           net acc.out -> total
+           net decay.in1 <- total
+           net decay.out -> decayed
+           net delay.in <- decayed
+           net delay.out -> back
+           net acc.in1 <- back
+           net c1.in <- total
+           net c1.out -> x1
+           net c2.in <- x1
+           net c2.out -> x2
+           net c3.in <- x2
+           net c3.out -> x3
+           net c4.in <- x3
+           net c4.out -> x4
+           net c5.in <- x4
+        )");
+
+        Dataflow graph(file);
+        double total = 0, largest = 0;
+        for (auto m : graph.modules) {
+            total += stepCost(*m);
+            largest = std::max(largest, stepCost(*m));
+        }
+        for (size_t parts : { 2, 3, 4, 8 }) {
+            std::vector<size_t> part = processPartition(graph, parts);
+            std::vector<size_t> size(parts, 0);
+            std::vector<double> cost(parts, 0);
+            for (size_t m = 0; m < part.size(); m++) {
+                size[part[m]]++;
+                cost[part[m]] += stepCost(*graph.modules[m]);
+            }
+            double average = total / parts;
+            for (size_t p = 0; p < parts; p++) {
+                REQUIRE(size[p] > 0);
+                REQUIRE(std::fabs(cost[p] - average) <= std::max(0.1 * average, largest));
+            }
+        }
+
+        // Only the last partitions stay empty
+        std::vector<size_t> part = processPartition(graph, 12);
+        std::vector<size_t> size(12, 0);
+        for (size_t p : part)
+            size[p]++;
+        REQUIRE(size == (std::vector<size_t>{ 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0 }));
+    }
+
+    SECTION("demand pins") {
+        ParsedFile file = parse_netlist(
+        R"(ModuleIdentity<REAL> a
+           ModuleIdentity<REAL> b
+           ModuleMuxDemand<REAL, 2> mux
+           net a.out -> x
+           net b.out -> y
+           net mux.vals0 <- x
+           net mux.vals1 <- y
+        )");
+
+        Dataflow graph(file);
+        REQUIRE(graph.demandNets == (std::set<std::string>{ "x", "y" }));
+        // The mux reads its values before the drivers step, no latch is needed
+        std::vector<std::string> expected{ "mux", "a", "b" };
+        REQUIRE(module_names(graph, stepOrder(graph, Schedule::TwoPhase)) == expected);
+        REQUIRE(latchedNets(graph, Schedule::TwoPhase).empty());
+    }
+
+    SECTION("rates") {
+        ParsedFile file = parse_netlist(
+        R"(ModuleIdentity<REAL> slow
+           ModuleIdentity<REAL> fast
+           ModuleSum<REAL> slower
+           ModuleMuxDemand<REAL, 1> mux
+           net fast.out -> a
+           net slow.in <- a
+           net slower.in1 <- a
+           net slow.out -> b
+           net slower.in2 <- b
+           net mux.vals0 <- b
+           rate 4 slow mux
+           rate 6 slower
+        )");
+
+        Dataflow graph(file);
+        REQUIRE(graph.rate[graph.index["fast"]] == 1);
+        REQUIRE(graph.rate[graph.index["slower"]] == 6);
+        // Nets are propagated as often as their most frequent reader needs
+        REQUIRE(graph.netRate["a"] == 2);
+        REQUIRE(graph.netRate["b"] == 2);
+        std::vector<std::string> expected{ "fast", "mux", "slow", "slower" };
+        REQUIRE(module_names(graph, stepOrder(graph, Schedule::TwoPhase)) == expected);
+    }
+
+    SECTION("enable groups") {
+        ParsedFile file = parse_netlist(
+        R"(ModuleIdentity<REAL> gated
+           ModuleIdentity<REAL> free
+           ModuleIdentity<BOOL> control
+           ModuleIdentity<REAL> inner
+           net control.out -> on
+           net free.out -> a
+           net gated.in <- a
+           net inner.in <- a
+           net gated.out -> b
+           net inner.in <- b
+           net free.in <- b
+           enable on hold gated inner
+        )");
+
+        Dataflow graph(file);
+        REQUIRE(graph.group[graph.index["free"]] == 0);
+        REQUIRE(graph.group[graph.index["inner"]] == 1);
+        // Nets read only inside the group are propagated only while it is on
+        REQUIRE(graph.netGroup["a"] == 1);
+        REQUIRE(graph.netGroup["b"] == 0);
+        std::vector<std::string> expected{ "free", "control", "gated", "inner" };
+        REQUIRE(module_names(graph, stepOrder(graph, Schedule::TwoPhase)) == expected);
+        // The enable net is read by the whole group
+        std::set<size_t> cone{ graph.index["gated"], graph.index["free"], graph.index["control"] };
+        REQUIRE(coneOfInfluence(graph, { "b" }) == cone);
+    }
+
+    SECTION("balanced partition") {
+        std::vector<double> costs{ 1, 1, 1, 1, 1, 1 };
+        REQUIRE(balancedPartition(costs, 3) == (std::vector<size_t>{ 0, 2, 4, 6 }));
+        REQUIRE(balancedPartition(costs, 1) == (std::vector<size_t>{ 0, 6 }));
+
+        // Expensive module gets a thread of its own
+        costs = { 10, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1 };
+        REQUIRE(balancedPartition(costs, 2) == (std::vector<size_t>{ 0, 1, 11 }));
+
+        // More threads than modules leaves some of them idle
+        costs = { 1, 1 };
+        auto ranges = balancedPartition(costs, 4);
+        REQUIRE(ranges.size() == 5);
+        REQUIRE(ranges.front() == 0);
+        REQUIRE(ranges.back() == 2);
+        REQUIRE(std::is_sorted(ranges.begin(), ranges.end()));
+
+        REQUIRE(balancedPartition({}, 2) == (std::vector<size_t>{ 0, 0, 0 }));
+    }
+
+    SECTION("pipeline threads") {
+        ParsedFile file = parse_netlist(
+        R"(ModuleIdentity<REAL> c
+           ModuleIdentity<REAL> b
+           ModuleIdentity<REAL> a
+           ModuleIdentity<REAL> d
+           net a.out -> ab
+           net b.in <- ab
+           net b.out -> bc
+           net c.in <- bc
+           net c.out -> cd
+           net d.in <- cd
+        )");
+
+        Dataflow graph(file);
+        // The chain is split in its dataflow order, not the declaration order
+        auto threads = pipelineThreads(graph, 2);
+        REQUIRE(threads[graph.index["a"]] == 0);
+        REQUIRE(threads[graph.index["b"]] == 0);
+        REQUIRE(threads[graph.index["c"]] == 1);
+        REQUIRE(threads[graph.index["d"]] == 1);
+    }
+
+    SECTION("cone of influence") {
+        ParsedFile file = parse_netlist(
+        R"(ModuleIdentity<REAL> a
+           ModuleIdentity<REAL> b
+           ModuleIdentity<REAL> c
+           ModuleIdentity<REAL> unrelated
+           ModuleIdentity<REAL> reader
+           net a.out -> ab
+           net b.in <- ab
+           net b.out -> bc
+           net c.in <- bc
+           net c.out -> ca
+           net a.in <- ca
+           net unrelated.out -> u
+           net reader.in <- stray
+        )");
+
+        Dataflow graph(file);
+        // Feedback loop keeps all of its modules
+        std::set<size_t> loop{ graph.index["a"], graph.index["b"], graph.index["c"] };
+        REQUIRE(coneOfInfluence(graph, { "bc" }) == loop);
+        REQUIRE(coneOfInfluence(graph, { "u" }) == std::set<size_t>{ graph.index["unrelated"] });
+        // Net without a driver is represented by its readers
+        REQUIRE(coneOfInfluence(graph, { "stray" }) == std::set<size_t>{ graph.index["reader"] });
+    }
+}
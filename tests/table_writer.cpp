@@ -15,3 +15,20 @@ TEST_CASE("simple_table") {
 		REQUIRE(s.str() == "\"A\",\"B\"\n10,21\n");
 	}
 }
+
+TEST_CASE("runtime_table") {
+	SECTION("Same as compile-time columns") {
+		std::ostringstream a, b;
+		TableWriter<CsvDialect, int, Maybe<double>> table(a, {"step", "x"});
+		table.write_line(0, Maybe<double>(1.5));
+		table.write_line(1, Maybe<double>());
+
+		RuntimeTableWriter<CsvDialect> runtime(b, {"step", "x"});
+		runtime << 0 << Maybe<double>(1.5);
+		runtime.end_line();
+		runtime << 1 << Maybe<double>();
+		runtime.end_line();
+		REQUIRE(a.str() == b.str());
+		REQUIRE(b.str() == "\"step\",\"x\"\n0,1.5\n1,\"None\"\n");
+	}
+}
@@ -0,0 +1,89 @@
+#include <catch.hpp>
+
+#include "tests.h"
+#include "../src/cpplink_lib/threads.h"
+
+using namespace cpplink;
+
+TEST_CASE("threads") {
+
+    SECTION("team runs every thread in every tick") {
+        const size_t threads = 4;
+        SpinBarrier barrier(threads);
+        std::vector<long> counts(threads, 0);
+        auto work = [&](size_t t) { counts[t]++; };
+        ThreadTeam<decltype(work)> team(barrier, work);
+
+        for (int i = 0; i < 1000; i++)
+            team.run();
+        REQUIRE(counts == std::vector<long>(threads, 1000));
+    }
+
+    SECTION("phases are separated by the barrier") {
+        const size_t threads = 3;
+        SpinBarrier barrier(threads);
+        // Every thread reads values of all threads written in the first phase
+        std::vector<long> written(threads, 0), sums(threads, 0);
+        bool consistent = true;
+        long tick = 0;
+        auto work = [&](size_t t) {
+            written[t] = tick;
+            barrier.wait();
+            long sum = 0;
+            for (long w : written)
+                sum += w;
+            sums[t] = sum;
+        };
+        ThreadTeam<decltype(work)> team(barrier, work);
+
+        for (tick = 1; tick <= 1000; tick++) {
+            team.run();
+            for (long s : sums)
+                consistent = consistent && s == long(threads) * tick;
+        }
+        REQUIRE(consistent);
+    }
+
+    SECTION("single thread team") {
+        SpinBarrier barrier(1);
+        int runs = 0;
+        auto work = [&](size_t) { runs++; };
+        ThreadTeam<decltype(work)> team(barrier, work);
+        team.run();
+        team.run();
+        REQUIRE(runs == 2);
+    }
+
+    SECTION("channel keeps order of values") {
+        Channel<int64_t> channel(3);
+        const long count = 10000;
+        std::thread producer([&] {
+            for (long i = 0; i < count; i++)
+                channel.push(i % 7 ? Maybe<int64_t>(i) : Maybe<int64_t>());
+        });
+
+        bool ordered = true;
+        for (long i = 0; i < count; i++) {
+            Maybe<int64_t> m = channel.pop();
+            if (i % 7)
+                ordered = ordered && m.isValid() && m.value == i;
+            else
+                ordered = ordered && !m.isValid();
+        }
+        producer.join();
+        REQUIRE(ordered);
+    }
+
+    SECTION("channel feeds input pins") {
+        Channel<double> channel(2);
+        InputPin<double> in;
+        channel.addInputPin(in);
+        channel.push(1.5);
+        channel.push(Maybe<double>());
+
+        channel.pull();
+        REQUIRE_VALUE(in.get(), 1.5);
+        channel.pull();
+        REQUIRE_INVALID(in.get());
+    }
+}